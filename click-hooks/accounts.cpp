@@ -22,6 +22,7 @@
 #include <Accounts/Manager>
 #include <Accounts/Service>
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
@@ -29,18 +30,27 @@
 #include <QDomElement>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
 #include <QStandardPaths>
 #include <QStringList>
+#include <QThreadPool>
+#include <QXmlStreamReader>
+#include <QtConcurrent>
 #include <click.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <utime.h>
 #include "acl-updater.h"
 
+/* Stored in the hooks directory; see loadState() */
+#define STATE_FILE QStringLiteral(".processed-hooks.json")
+#define STATE_FILE_VERSION 1
+
 static QString findPackageDir(const QString &appId)
 {
     /* For testing */
@@ -93,7 +103,8 @@ static QString stripVersion(const QString &appId)
 class ManifestFile {
 public:
     ManifestFile(const QFileInfo &hookFileInfo,
-                 const QString &appId, const QString &shortAppId);
+                 const QString &appId, const QString &shortAppId,
+                 const QString &packageDir);
 
     bool writeFiles(const QDir &accountsDir);
     bool writeServiceFile(const QDir &accountsDir, const QString &id,
@@ -116,6 +127,8 @@ public:
     void addDesktopFile(QDomDocument &doc);
     bool writeXmlFile(const QDomDocument &doc, const QString &fileName) const;
     bool isValid() const { return m_isValid; }
+    /* The files written, relative to the accounts directory */
+    QStringList outputFiles() const { return m_outputFiles; }
 
 private:
     QFileInfo m_hookFileInfo;
@@ -127,12 +140,15 @@ private:
     QString m_trDomain;
     bool m_isScope;
     bool m_isValid;
+    QStringList m_outputFiles;
 };
 
 ManifestFile::ManifestFile(const QFileInfo &hookFileInfo,
                            const QString &appId,
-                           const QString &shortAppId):
+                           const QString &shortAppId,
+                           const QString &packageDir):
     m_hookFileInfo(hookFileInfo),
+    m_packageDir(packageDir),
     m_appId(appId),
     m_shortAppId(shortAppId),
     m_isScope(false),
@@ -149,8 +165,6 @@ ManifestFile::ManifestFile(const QFileInfo &hookFileInfo,
         m_plugin = mainObject.value("plugin").toObject();
         m_isScope = mainObject.value("scope").toBool();
         m_isValid = !m_services.isEmpty() || !m_plugin.isEmpty();
-
-        m_packageDir = findPackageDir(appId);
     }
 }
 
@@ -197,7 +211,9 @@ bool ManifestFile::writeFiles(const QDir &accountsDir)
     if (ok && !m_services.isEmpty()) {
         QString applicationFile =
             QString("applications/%1.application").arg(m_shortAppId);
-        if (!writeXmlFile(doc, accountsDir.filePath(applicationFile))) {
+        if (writeXmlFile(doc, accountsDir.filePath(applicationFile))) {
+            m_outputFiles.append(applicationFile);
+        } else {
             qWarning() << "Writing application file failed" << applicationFile;
             ok = false;
         }
@@ -238,7 +254,10 @@ bool ManifestFile::writeServiceFile(const QDir &accountsDir, const QString &id,
     addTranslations(doc);
     addTemplate(doc, json);
 
-    return writeXmlFile(doc, accountsDir.filePath(QString("services/%1.service").arg(id)));
+    QString serviceFile = QString("services/%1.service").arg(id);
+    if (!writeXmlFile(doc, accountsDir.filePath(serviceFile))) return false;
+    m_outputFiles.append(serviceFile);
+    return true;
 }
 
 bool ManifestFile::writePlugins(const QDir &accountsDir)
@@ -266,6 +285,7 @@ bool ManifestFile::writePlugins(const QDir &accountsDir)
         qWarning() << "Cannot symlink QML files" << qmlPlugin;
         return false;
     }
+    m_outputFiles.append(qmlDestination);
 
     if (!writeProviderFile(accountsDir, m_shortAppId, m_plugin)) {
         qWarning() << "Writing provider file failed" << m_shortAppId;
@@ -314,7 +334,10 @@ bool ManifestFile::writeProviderFile(const QDir &accountsDir,
     addTemplate(doc, json);
     addPackageDir(doc);
 
-    return writeXmlFile(doc, accountsDir.filePath(QString("providers/%1.provider").arg(id)));
+    QString providerFile = QString("providers/%1.provider").arg(id);
+    if (!writeXmlFile(doc, accountsDir.filePath(providerFile))) return false;
+    m_outputFiles.append(providerFile);
+    return true;
 }
 
 QDomDocument ManifestFile::createDocument() const
@@ -490,58 +513,72 @@ bool ManifestFile::writeXmlFile(const QDomDocument &doc, const QString &fileName
     }
 }
 
-class LibAccountsFile: public QDomDocument {
-public:
-    LibAccountsFile(const QFileInfo &fileInfo);
-
-    QString profile() const;
-    bool createdByUs() const;
-    bool isValid() const { return m_isValid; }
-
-private:
-    QFileInfo m_fileInfo;
-    bool m_isValid;
-};
-
-LibAccountsFile::LibAccountsFile(const QFileInfo &fileInfo):
-    QDomDocument(),
-    m_fileInfo(fileInfo),
-    m_isValid(false)
+/* Reads the creator mark and the profile of a libaccounts file, without
+ * building the whole DOM tree: our files start with the creator comment and
+ * have the <profile> element among the first children of the root element.
+ * Returns true if the file was created by us. */
+static bool readFileHeader(const QString &filePath, QString &profile)
 {
-    QFile file(fileInfo.filePath());
-    if (file.open(QIODevice::ReadOnly)) {
-        if (setContent(&file)) {
-            m_isValid = true;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QString creatorMark = QCoreApplication::applicationName() + ";";
+    bool createdByUs = false;
+    int depth = 0;
+    QXmlStreamReader reader(&file);
+    while (!reader.atEnd()) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::Comment:
+            if (depth == 0 &&
+                reader.text().toString().contains(creatorMark)) {
+                createdByUs = true;
+            }
+            break;
+        case QXmlStreamReader::StartElement:
+            depth++;
+            /* The creator mark always precedes the root element */
+            if (depth == 1 && !createdByUs) return false;
+            if (depth == 2 && reader.name() == QLatin1String("profile")) {
+                profile = reader.readElementText();
+                return true;
+            }
+            break;
+        case QXmlStreamReader::EndElement:
+            depth--;
+            break;
+        default:
+            break;
         }
-        file.close();
     }
+    return createdByUs && !reader.hasError();
 }
 
-QString LibAccountsFile::profile() const
-{
-    QDomElement root = documentElement();
-    return root.firstChildElement("profile").text();
-}
-
-bool LibAccountsFile::createdByUs() const
+/* Builds the set of the names which, followed by "_", prefix the name of a
+ * hook file with the given suffix; that is, the set of $prefix for which
+ * a "$prefix_*.$suffix" file exists. */
+static QSet<QString> hookPrefixes(const QDir &hooksDirIn, const QString &suffix)
 {
-    QString creatorMark = QCoreApplication::applicationName() + ";";
-    for (QDomNode n = firstChild(); !n.isNull(); n = n.nextSibling()) {
-        if (n.isComment() && n.nodeValue().contains(creatorMark)) {
-            return true;
+    QSet<QString> prefixes;
+    QStringList nameFilters = QStringList() << "*." + suffix;
+    Q_FOREACH(const QString &fileName, hooksDirIn.entryList(nameFilters)) {
+        QString baseName =
+            fileName.left(fileName.length() - suffix.length() - 1);
+        for (int i = baseName.indexOf('_'); i >= 0;
+             i = baseName.indexOf('_', i + 1)) {
+            prefixes.insert(baseName.left(i));
         }
     }
-    return false;
+    return prefixes;
 }
 
 static void disableService(Accounts::Manager *manager,
+                           AclUpdater *aclUpdater,
                            const QString &serviceId,
                            const QString &profile)
 {
     Accounts::Service service = manager->service(serviceId);
     if (Q_UNLIKELY(!service.isValid())) return;
 
-    AclUpdater aclUpdater;
     Q_FOREACH(Accounts::AccountId accountId, manager->accountListEnabled()) {
         Accounts::Account *account = manager->account(accountId);
         if (Q_UNLIKELY(!account)) continue;
@@ -553,7 +590,7 @@ static void disableService(Accounts::Manager *manager,
         if (account->isEnabled()) {
             account->setEnabled(false);
             account->sync();
-            aclUpdater.removeApp(stripVersion(profile), credentialsId);
+            aclUpdater->removeApp(stripVersion(profile), credentialsId);
         }
     }
 }
@@ -571,6 +608,7 @@ static void removeStaleAccounts(Accounts::Manager *manager,
 }
 
 static void removeStaleFiles(Accounts::Manager *manager,
+                             AclUpdater *aclUpdater,
                              const QStringList &fileTypes,
                              const QDir &accountsDir,
                              const QDir &hooksDirIn)
@@ -579,6 +617,7 @@ static void removeStaleFiles(Accounts::Manager *manager,
      * ~/.local/share/accounts/{providers,services,applications}/
      * and remove files which are no longer present in hooksDirIn.
      */
+    QSet<QString> installedPrefixes = hookPrefixes(hooksDirIn, "accounts");
     Q_FOREACH(const QString &fileType, fileTypes) {
         QDir dir(accountsDir.filePath(fileType + "s"));
         dir.setFilter(QDir::Files | QDir::Readable);
@@ -587,24 +626,20 @@ static void removeStaleFiles(Accounts::Manager *manager,
         dir.setNameFilters(fileTypeFilter);
 
         Q_FOREACH(const QFileInfo &fileInfo, dir.entryInfoList()) {
-            LibAccountsFile file(fileInfo.filePath());
-
             /* If this file was not created by our hook let's ignore it. */
-            if (!file.createdByUs()) continue;
-
-            QString profile = file.profile();
+            QString profile;
+            if (!readFileHeader(fileInfo.filePath(), profile)) continue;
 
             /* Check that the hook file is still there; if it isn't, then it
              * means that the click package was removed, and we must remove our
              * copy as well. */
-            QString hookFileName = stripVersion(profile) + "_*.accounts";
-            QStringList nameFilters = QStringList() << hookFileName;
-            if (!hooksDirIn.entryList(nameFilters).isEmpty()) continue;
+            if (installedPrefixes.contains(stripVersion(profile))) continue;
 
             if (fileType == "service") {
                 /* Make sure services get disabled. See also:
                  * https://bugs.launchpad.net/bugs/1417261 */
-                disableService(manager, fileInfo.completeBaseName(), profile);
+                disableService(manager, aclUpdater,
+                               fileInfo.completeBaseName(), profile);
             } else if (fileType == "provider") {
                 /* If this is a provider, we must also remove any accounts
                  * associated with it */
@@ -615,18 +650,96 @@ static void removeStaleFiles(Accounts::Manager *manager,
     }
 }
 
-static void removeStaleTimestampFiles(const QDir &hooksDirIn)
+static void removeStaleOutputFile(Accounts::Manager *manager,
+                                  AclUpdater *aclUpdater,
+                                  const QDir &accountsDir,
+                                  const QString &fileName,
+                                  const QString &profile)
 {
-    Q_FOREACH(const QFileInfo &fileInfo, hooksDirIn.entryInfoList()) {
-        if (fileInfo.suffix() != "processed") continue;
+    QFileInfo fileInfo(accountsDir.filePath(fileName));
+    if (fileName.startsWith("services/")) {
+        disableService(manager, aclUpdater,
+                       fileInfo.completeBaseName(), profile);
+    } else if (fileName.startsWith("providers/")) {
+        removeStaleAccounts(manager, fileInfo.completeBaseName());
+    }
+    QFile::remove(fileInfo.filePath());
+}
 
-        /* Find the corresponding hook file */
-        QFileInfo hookInfo(fileInfo.absolutePath() + "/" + fileInfo.completeBaseName());
+/* The state of the processed hook files is kept in a single JSON file, in
+ * the hooks directory:
+ *   { "version": 1,
+ *     "hooks": { "<hook file name>": { "mtime": <seconds since the epoch>,
+ *                                      "hash": "<SHA-1 of the contents>",
+ *                                      "outputFiles": [ ... ] } } }
+ * where the output files are relative to the accounts directory.
+ */
+struct ProcessedHook {
+    ProcessedHook(): mtime(0) {}
+    qint64 mtime;
+    QByteArray hash;
+    QStringList outputFiles;
+};
+typedef QHash<QString,ProcessedHook> HookStates;
 
-        if (!hookInfo.exists()) {
-            QFile::remove(fileInfo.filePath());
+static bool loadState(const QString &fileName, HookStates &states)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QJsonObject mainObject = QJsonDocument::fromJson(file.readAll()).object();
+    if (mainObject.value("version").toInt() != STATE_FILE_VERSION) {
+        qWarning() << "Ignoring state file" << fileName;
+        return false;
+    }
+
+    QJsonObject hooks = mainObject.value("hooks").toObject();
+    for (QJsonObject::const_iterator i = hooks.constBegin();
+         i != hooks.constEnd(); i++) {
+        QJsonObject o = i.value().toObject();
+        ProcessedHook &hook = states[i.key()];
+        hook.mtime = qint64(o.value("mtime").toDouble());
+        hook.hash = o.value("hash").toString().toLatin1();
+        Q_FOREACH(const QJsonValue &v, o.value("outputFiles").toArray()) {
+            hook.outputFiles.append(v.toString());
         }
     }
+    return true;
+}
+
+static bool saveState(const QString &fileName, const HookStates &states)
+{
+    QJsonObject hooks;
+    for (HookStates::const_iterator i = states.constBegin();
+         i != states.constEnd(); i++) {
+        QJsonObject o;
+        o.insert("mtime", double(i.value().mtime));
+        o.insert("hash", QString::fromLatin1(i.value().hash));
+        o.insert("outputFiles",
+                 QJsonArray::fromStringList(i.value().outputFiles));
+        hooks.insert(i.key(), o);
+    }
+    QJsonObject mainObject;
+    mainObject.insert("version", STATE_FILE_VERSION);
+    mainObject.insert("hooks", hooks);
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write state file" << fileName;
+        return false;
+    }
+    file.write(QJsonDocument(mainObject).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+static QByteArray contentHash(const QFileInfo &fileInfo)
+{
+    QFile file(fileInfo.filePath());
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result().toHex();
 }
 
 /* Get the modification time of a file; this differs from
@@ -641,6 +754,50 @@ static QDateTime lastModified(const QFileInfo &fileInfo)
     return QDateTime::fromTime_t(data.st_mtime);
 }
 
+struct HookFile {
+    QFileInfo fileInfo;
+    QString appId;
+    QString packageDir;
+    /* Filled in by the HookProcessor */
+    bool processed;
+    QStringList outputFiles;
+};
+
+/* Hook files for different versions of the same application write the same
+ * output files: they are processed in order, in the same job */
+typedef QList<HookFile> HookJob;
+
+class HookProcessor
+{
+public:
+    typedef void result_type;
+
+    HookProcessor(const QDir &accountsDir): m_accountsDir(accountsDir) {}
+
+    void operator()(HookJob &job) const;
+
+private:
+    QDir m_accountsDir;
+};
+
+void HookProcessor::operator()(HookJob &job) const
+{
+    for (HookJob::iterator i = job.begin(); i != job.end(); i++) {
+        HookFile &hookFile = *i;
+        const QFileInfo &fileInfo = hookFile.fileInfo;
+        ManifestFile manifest(fileInfo, hookFile.appId,
+                              stripVersion(hookFile.appId),
+                              hookFile.packageDir);
+        if (!manifest.isValid()) {
+            qWarning() << "Invalid file" << fileInfo.filePath();
+            continue;
+        }
+
+        hookFile.processed = manifest.writeFiles(m_accountsDir);
+        hookFile.outputFiles = manifest.outputFiles();
+    }
+}
+
 int main(int argc, char **argv)
 {
     QCoreApplication app(argc, argv);
@@ -651,6 +808,10 @@ int main(int argc, char **argv)
     }
     Accounts::Manager *manager = new Accounts::Manager(managerOptions);
 
+    /* The ACLs of the credentials used by removed applications are updated
+     * in the background, and waited for before exiting */
+    AclUpdater aclUpdater;
+
     /* Go through the hook files in ~/.local/share/online-accounts-hooks2/ and
      * check if they have already been processed into a file under
      * ~/.local/share/accounts/{services,applications}/;
@@ -676,9 +837,24 @@ int main(int argc, char **argv)
     accountsDir.mkpath("providers");
     accountsDir.mkpath("qml-plugins");
 
-    removeStaleFiles(manager, fileTypes, accountsDir, hooksDirIn);
-    removeStaleTimestampFiles(hooksDirIn);
+    QString stateFileName = hooksDirIn.filePath(STATE_FILE);
+    HookStates previousStates;
+    if (!loadState(stateFileName, previousStates)) {
+        /* We don't know which files were written by previous runs: check
+         * their contents. This also takes care of updating from the versions
+         * which used to create a ".processed" file for each hook file. */
+        removeStaleFiles(manager, &aclUpdater,
+                         fileTypes, accountsDir, hooksDirIn);
+        QStringList nameFilters = QStringList() << "*.accounts.processed";
+        Q_FOREACH(const QString &fileName, hooksDirIn.entryList(nameFilters)) {
+            hooksDirIn.remove(fileName);
+        }
+    }
 
+    HookStates states;
+    bool stateChanged = false;
+    QList<HookJob> jobs;
+    QHash<QString,int> jobIndexes;
     Q_FOREACH(const QFileInfo &fileInfo, hooksDirIn.entryInfoList()) {
         if (fileInfo.suffix() != "accounts") continue;
 
@@ -689,42 +865,108 @@ int main(int argc, char **argv)
          * the version number out. */
         QString shortAppId = stripVersion(appId);
 
-        /* We create an empty file whenever we succesfully process a hook file.
-         * The name of this file is the same as the hook file, with the
-         * .processed suffix appended.
-         */
-        QFileInfo processedInfo(fileInfo.filePath() + ".processed");
-        if (processedInfo.exists() &&
-            processedInfo.lastModified() == lastModified(fileInfo)) {
-            continue;
+        /* Skip the hook files which have already been processed; the
+         * contents are checked only if the modification time has changed. */
+        qint64 mtime = lastModified(fileInfo).toTime_t();
+        HookStates::const_iterator previous =
+            previousStates.constFind(fileInfo.fileName());
+        if (previous != previousStates.constEnd()) {
+            if (previous.value().mtime == mtime) {
+                states.insert(fileInfo.fileName(), previous.value());
+                continue;
+            }
+            stateChanged = true;
+            if (previous.value().hash == contentHash(fileInfo)) {
+                ProcessedHook &state = states[fileInfo.fileName()];
+                state = previous.value();
+                state.mtime = mtime;
+                continue;
+            }
         }
 
-        ManifestFile manifest = ManifestFile(fileInfo, appId, shortAppId);
-        if (!manifest.isValid()) {
-            qWarning() << "Invalid file" << fileInfo.filePath();
-            continue;
+        /* The Click database is only accessed from this thread */
+        HookFile hookFile;
+        hookFile.fileInfo = fileInfo;
+        hookFile.appId = appId;
+        hookFile.packageDir = findPackageDir(appId);
+        hookFile.processed = false;
+
+        QHash<QString,int>::const_iterator i = jobIndexes.constFind(shortAppId);
+        if (i == jobIndexes.constEnd()) {
+            jobIndexes.insert(shortAppId, jobs.count());
+            jobs.append(HookJob() << hookFile);
+        } else {
+            jobs[i.value()].append(hookFile);
         }
+    }
 
-        if (manifest.writeFiles(accountsDir)) {
-            QFile file(processedInfo.filePath());
-            if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-                file.close();
-                struct utimbuf sourceTime;
-                sourceTime.actime = sourceTime.modtime =
-                    lastModified(fileInfo).toTime_t();
-                utime(processedInfo.filePath().toUtf8().constData(),
-                      &sourceTime);
-            } else {
-                qWarning() << "Could not create timestamp file" <<
-                    processedInfo.filePath();
+    /* Parsing the manifests and writing the libaccounts files only involves
+     * the file system, so it can be done in parallel; the worker threads can
+     * be limited for testing. */
+    QByteArray maxThreads = qgetenv("OAH_WORKER_THREADS");
+    if (!maxThreads.isEmpty()) {
+        QThreadPool::globalInstance()->setMaxThreadCount(
+            qMax(maxThreads.toInt(), 1));
+    }
+    QtConcurrent::blockingMap(jobs, HookProcessor(accountsDir));
+
+    Q_FOREACH(const HookJob &job, jobs) {
+        Q_FOREACH(const HookFile &hookFile, job) {
+            QString fileName = hookFile.fileInfo.fileName();
+            if (hookFile.processed) {
+                ProcessedHook &state = states[fileName];
+                state.mtime = lastModified(hookFile.fileInfo).toTime_t();
+                state.hash = contentHash(hookFile.fileInfo);
+                state.outputFiles = hookFile.outputFiles;
+                stateChanged = true;
+            } else if (previousStates.contains(fileName) ||
+                       !hookFile.outputFiles.isEmpty()) {
+                /* Keep track of the files written so far, but make sure that
+                 * the hook file is processed again on the next run */
+                ProcessedHook &state = states[fileName];
+                state = previousStates.value(fileName);
+                state.mtime = 0;
+                state.hash.clear();
+                state.outputFiles += hookFile.outputFiles;
+                state.outputFiles.removeDuplicates();
+                stateChanged = true;
             }
         }
     }
 
+    /* Remove the files which were written for hook files which have been
+     * removed, or which are no longer generated. */
+    QSet<QString> outputFiles;
+    Q_FOREACH(const ProcessedHook &state, states) {
+        outputFiles += state.outputFiles.toSet();
+    }
+    for (HookStates::const_iterator i = previousStates.constBegin();
+         i != previousStates.constEnd(); i++) {
+        if (!states.contains(i.key())) stateChanged = true;
+        QString profile = QFileInfo(i.key()).completeBaseName();
+        Q_FOREACH(const QString &fileName, i.value().outputFiles) {
+            if (outputFiles.contains(fileName)) continue;
+            removeStaleOutputFile(manager, &aclUpdater,
+                                  accountsDir, fileName, profile);
+            outputFiles.insert(fileName);
+        }
+    }
+
+    if (stateChanged) {
+        saveState(stateFileName, states);
+    }
+
     /* To ensure that all the installed services are parsed into
      * libaccounts' DB, we enumerate them now.
      */
     manager->serviceList();
+
+    if (!aclUpdater.isIdle()) {
+        QObject::connect(&aclUpdater, SIGNAL(finished()),
+                         &app, SLOT(quit()));
+        app.exec();
+    }
+
     delete manager;
 
     return EXIT_SUCCESS;
@@ -22,41 +22,157 @@
 
 #include <QCoreApplication>
 #include <QDebug>
-#include <QEventLoop>
-#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QStringList>
 #include <SignOn/Identity>
 #include <SignOn/IdentityInfo>
 
+#define ACL_UPDATER_MAX_PENDING 4
+
+struct AclUpdate {
+    uint credentialsId;
+    QStringList shortAppIds;
+};
+
 class AclUpdaterPrivate: public QObject
 {
     Q_OBJECT
+    Q_DECLARE_PUBLIC(AclUpdater)
 
 public:
-    AclUpdaterPrivate();
+    AclUpdaterPrivate(AclUpdater *q);
+
+    void enqueue(const QString &shortAppId, uint credentialsId);
+    void complete(SignOn::Identity *identity, bool ok);
 
 public Q_SLOTS:
+    void processQueue();
     void onInfo(const SignOn::IdentityInfo &info);
     void onStored(const quint32 id);
     void onError(const SignOn::Error &error);
 
 private:
-    friend class AclUpdater;
-    QEventLoop m_loop;
+    /* Updates waiting to be started; there's at most one update per
+     * credentials ID which has not been started yet */
+    QList<AclUpdate> m_queue;
+    /* Identities being updated, by credentials ID */
+    QHash<uint,SignOn::Identity*> m_pending;
+    int m_maxPending;
+    bool m_processingScheduled;
+    bool m_isRunning;
+    mutable AclUpdater *q_ptr;
 };
 
-AclUpdaterPrivate::AclUpdaterPrivate():
-    QObject()
+AclUpdaterPrivate::AclUpdaterPrivate(AclUpdater *q):
+    QObject(),
+    m_maxPending(ACL_UPDATER_MAX_PENDING),
+    m_processingScheduled(false),
+    m_isRunning(false),
+    q_ptr(q)
+{
+}
+
+void AclUpdaterPrivate::enqueue(const QString &shortAppId, uint credentialsId)
+{
+    /* Updates of the same credentials which have not been started yet are
+     * merged into one */
+    bool merged = false;
+    for (QList<AclUpdate>::iterator i = m_queue.begin();
+         i != m_queue.end(); i++) {
+        if (i->credentialsId != credentialsId) continue;
+        if (!i->shortAppIds.contains(shortAppId)) {
+            i->shortAppIds.append(shortAppId);
+        }
+        merged = true;
+        break;
+    }
+
+    if (!merged) {
+        AclUpdate update;
+        update.credentialsId = credentialsId;
+        update.shortAppIds.append(shortAppId);
+        m_queue.append(update);
+    }
+
+    m_isRunning = true;
+    if (!m_processingScheduled) {
+        m_processingScheduled = true;
+        QMetaObject::invokeMethod(this, "processQueue", Qt::QueuedConnection);
+    }
+}
+
+void AclUpdaterPrivate::processQueue()
+{
+    Q_Q(AclUpdater);
+
+    m_processingScheduled = false;
+
+    QList<AclUpdate>::iterator i = m_queue.begin();
+    while (i != m_queue.end() && m_pending.count() < m_maxPending) {
+        /* The same identity is never updated concurrently, or some of the
+         * changes to its ACL would be lost */
+        if (m_pending.contains(i->credentialsId)) {
+            i++;
+            continue;
+        }
+
+        AclUpdate update = *i;
+        i = m_queue.erase(i);
+
+        SignOn::Identity *identity =
+            SignOn::Identity::existingIdentity(update.credentialsId, this);
+        if (Q_UNLIKELY(!identity)) {
+            Q_EMIT q->credentialsUpdated(update.credentialsId, false);
+            continue;
+        }
+
+        m_pending.insert(update.credentialsId, identity);
+        identity->setProperty("appsToBeRemoved", update.shortAppIds);
+        QObject::connect(identity, SIGNAL(info(const SignOn::IdentityInfo&)),
+                         this, SLOT(onInfo(const SignOn::IdentityInfo&)));
+        QObject::connect(identity, SIGNAL(credentialsStored(const quint32)),
+                         this, SLOT(onStored(const quint32)));
+        QObject::connect(identity, SIGNAL(error(const SignOn::Error &)),
+                         this, SLOT(onError(const SignOn::Error &)));
+        identity->queryInfo();
+    }
+
+    if (m_isRunning && m_queue.isEmpty() && m_pending.isEmpty()) {
+        m_isRunning = false;
+        Q_EMIT q->finished();
+    }
+}
+
+void AclUpdaterPrivate::complete(SignOn::Identity *identity, bool ok)
 {
+    Q_Q(AclUpdater);
+
+    uint credentialsId = m_pending.key(identity);
+    m_pending.remove(credentialsId);
+    identity->disconnect(this);
+    identity->deleteLater();
+
+    Q_EMIT q->credentialsUpdated(credentialsId, ok);
+    processQueue();
 }
 
 void AclUpdaterPrivate::onInfo(const SignOn::IdentityInfo &info)
 {
     SignOn::Identity *identity = qobject_cast<SignOn::Identity*>(sender());
 
-    QString shortAppId = identity->property("appToBeRemoved").toString();
+    QStringList shortAppIds =
+        identity->property("appsToBeRemoved").toStringList();
     QStringList acl;
     Q_FOREACH(const QString &token, info.accessControlList()) {
-        if (!token.startsWith(shortAppId)) {
+        bool toBeRemoved = false;
+        Q_FOREACH(const QString &shortAppId, shortAppIds) {
+            if (token.startsWith(shortAppId)) {
+                toBeRemoved = true;
+                break;
+            }
+        }
+        if (!toBeRemoved) {
             acl.append(token);
         }
     }
@@ -66,25 +182,26 @@ void AclUpdaterPrivate::onInfo(const SignOn::IdentityInfo &info)
         newInfo.setAccessControlList(acl);
         identity->storeCredentials(newInfo);
     } else {
-        qDebug() << shortAppId << "was not in ACL of" << info.id();
-        m_loop.exit(0);
+        qDebug() << shortAppIds << "not in ACL of" << info.id();
+        complete(identity, true);
     }
 }
 
 void AclUpdaterPrivate::onStored(const quint32 id)
 {
     Q_UNUSED(id);
-    m_loop.exit(0);
+    complete(qobject_cast<SignOn::Identity*>(sender()), true);
 }
 
 void AclUpdaterPrivate::onError(const SignOn::Error &err)
 {
     qWarning() << "Error occurred updating ACL" << err.message();
-    m_loop.exit(1);
+    complete(qobject_cast<SignOn::Identity*>(sender()), false);
 }
 
-AclUpdater::AclUpdater():
-    d_ptr(new AclUpdaterPrivate)
+AclUpdater::AclUpdater(QObject *parent):
+    QObject(parent),
+    d_ptr(new AclUpdaterPrivate(this))
 {
 }
 
@@ -93,6 +210,18 @@ AclUpdater::~AclUpdater()
     delete d_ptr;
 }
 
+void AclUpdater::setMaxPendingRequests(int count)
+{
+    Q_D(AclUpdater);
+    d->m_maxPending = qMax(count, 1);
+}
+
+int AclUpdater::maxPendingRequests() const
+{
+    Q_D(const AclUpdater);
+    return d->m_maxPending;
+}
+
 bool AclUpdater::removeApp(const QString &shortAppId, uint credentialsId)
 {
     Q_D(AclUpdater);
@@ -100,22 +229,14 @@ bool AclUpdater::removeApp(const QString &shortAppId, uint credentialsId)
     if (credentialsId == 0 ||
         !shortAppId.contains('_')) return false;
 
-    SignOn::Identity *identity =
-        SignOn::Identity::existingIdentity(credentialsId, d);
-    if (Q_UNLIKELY(!identity)) return false;
-
-    identity->setProperty("appToBeRemoved", shortAppId);
-    QObject::connect(identity, SIGNAL(info(const SignOn::IdentityInfo&)),
-                     d, SLOT(onInfo(const SignOn::IdentityInfo&)));
-    QObject::connect(identity, SIGNAL(credentialsStored(const quint32)),
-                     d, SLOT(onStored(const quint32)));
-    QObject::connect(identity, SIGNAL(error(const SignOn::Error &)),
-                     d, SLOT(onError(const SignOn::Error &)));
-    identity->queryInfo();
-
-    bool ok = (d->m_loop.exec() == 0);
-    delete identity;
-    return ok;
+    d->enqueue(shortAppId, credentialsId);
+    return true;
+}
+
+bool AclUpdater::isIdle() const
+{
+    Q_D(const AclUpdater);
+    return d->m_queue.isEmpty() && d->m_pending.isEmpty();
 }
 
 #include "acl-updater.moc"
@@ -21,19 +21,36 @@
 #ifndef ACCOUNTS_HOOK_ACL_UPDATER
 #define ACCOUNTS_HOOK_ACL_UPDATER
 
+#include <QObject>
 #include <QString>
 
 class AclUpdaterPrivate;
-class AclUpdater
+class AclUpdater: public QObject
 {
+    Q_OBJECT
+
 public:
-    AclUpdater();
+    AclUpdater(QObject *parent = 0);
     virtual ~AclUpdater();
 
+    /* Maximum number of credentials being updated at the same time */
+    void setMaxPendingRequests(int count);
+    int maxPendingRequests() const;
+
+    /* Queues the removal of the application from the ACL of the given
+     * credentials; requests are started once the event loop runs, and
+     * credentialsUpdated() is emitted for each credentials ID. Returns false
+     * if the request is invalid. */
     bool removeApp(const QString &shortAppId, uint credentialsId);
 
+    bool isIdle() const;
+
+Q_SIGNALS:
+    void credentialsUpdated(uint credentialsId, bool ok);
+    void finished();
+
 private:
-    Q_DECLARE_PRIVATE(AclUpdater);
+    Q_DECLARE_PRIVATE(AclUpdater)
     AclUpdaterPrivate *d_ptr;
 };
 
@@ -27,8 +27,10 @@
 #include <QDomElement>
 #include <QFile>
 #include <QFileInfo>
+#include <QSet>
 #include <QStandardPaths>
 #include <QStringList>
+#include <QXmlStreamReader>
 #include <click.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -109,7 +111,6 @@ public:
     void checkIconPath(const QString &appId);
     bool writeTo(const QString &fileName) const;
     void addCreatorMark();
-    bool createdByUs() const;
     bool isValid() const { return m_isValid; }
 
 private:
@@ -250,15 +251,63 @@ void LibAccountsFile::addCreatorMark()
     appendChild(createComment(comment));
 }
 
-bool LibAccountsFile::createdByUs() const
+/* Reads the creator mark and the profile of a libaccounts file, without
+ * building the whole DOM tree; since the creator mark is appended after the
+ * root element, the file is streamed until both have been found.
+ * Returns true if the file was created by us. */
+static bool readFileHeader(const QString &filePath, QString &profile)
 {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
     QString creatorMark = QCoreApplication::applicationName() + ";";
-    for (QDomNode n = firstChild(); !n.isNull(); n = n.nextSibling()) {
-        if (n.isComment() && n.nodeValue().contains(creatorMark)) {
-            return true;
+    bool createdByUs = false;
+    bool hasProfile = false;
+    int depth = 0;
+    QXmlStreamReader reader(&file);
+    while (!reader.atEnd() && !(createdByUs && hasProfile)) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::Comment:
+            if (depth == 0 &&
+                reader.text().toString().contains(creatorMark)) {
+                createdByUs = true;
+            }
+            break;
+        case QXmlStreamReader::StartElement:
+            if (depth == 1 && !hasProfile &&
+                reader.name() == QLatin1String("profile")) {
+                profile = reader.readElementText();
+                hasProfile = true;
+            } else {
+                depth++;
+            }
+            break;
+        case QXmlStreamReader::EndElement:
+            depth--;
+            break;
+        default:
+            break;
+        }
+    }
+    return createdByUs && !reader.hasError();
+}
+
+/* Builds the set of the names which, followed by "_", prefix the name of a
+ * hook file with the given suffix; that is, the set of $prefix for which
+ * a "$prefix_*.$suffix" file exists. */
+static QSet<QString> hookPrefixes(const QDir &hooksDirIn, const QString &suffix)
+{
+    QSet<QString> prefixes;
+    QStringList nameFilters = QStringList() << "*." + suffix;
+    Q_FOREACH(const QString &fileName, hooksDirIn.entryList(nameFilters)) {
+        QString baseName =
+            fileName.left(fileName.length() - suffix.length() - 1);
+        for (int i = baseName.indexOf('_'); i >= 0;
+             i = baseName.indexOf('_', i + 1)) {
+            prefixes.insert(baseName.left(i));
         }
     }
-    return false;
+    return prefixes;
 }
 
 static void removeStaleAccounts(Accounts::Manager *manager,
@@ -289,20 +338,16 @@ static void removeStaleFiles(Accounts::Manager *manager,
         fileTypeFilter << "*." + fileType;
         dir.setNameFilters(fileTypeFilter);
 
+        QSet<QString> installedPrefixes = hookPrefixes(hooksDirIn, fileType);
         Q_FOREACH(const QFileInfo &fileInfo, dir.entryInfoList()) {
-            LibAccountsFile file(fileInfo.filePath());
-
             /* If this file was not created by our hook let's ignore it. */
-            if (!file.createdByUs()) continue;
-
-            QString profile = file.profile();
+            QString profile;
+            if (!readFileHeader(fileInfo.filePath(), profile)) continue;
 
             /* Check that the hook file is still there; if it isn't, then it
              * means that the click package was removed, and we must remove our
              * copy as well. */
-            QString hookFileName = stripVersion(profile) + "_*." + fileType;
-            QStringList nameFilters = QStringList() << hookFileName;
-            if (!hooksDirIn.entryList(nameFilters).isEmpty()) continue;
+            if (installedPrefixes.contains(stripVersion(profile))) continue;
 
             QFile::remove(fileInfo.filePath());
             /* If this is a provider, we must also remove any accounts
@@ -8,6 +8,7 @@ CONFIG += \
     qt
 
 QT += \
+    concurrent \
     xml
 
 PKGCONFIG += \
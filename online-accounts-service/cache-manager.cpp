@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2014 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cache-manager.h"
+
+#include "cookie-jar.h"
+#include "data-remover.h"
+#include "debug.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+using namespace SignOnUi;
+
+#define DEFAULT_BUDGET (100 * 1024 * 1024)
+/* Shorter than the daemon's inactivity timeout, which is anyway postponed
+ * while a collection is scheduled */
+#define COLLECTION_DELAY 3000
+/* Data used more recently than this (in seconds) is never evicted, since a
+ * UI process might still be using it */
+#define EVICTION_GRACE_PERIOD 600
+
+namespace SignOnUi {
+
+struct CacheEntry {
+    QString path;
+    quint32 identity;
+    qint64 size;
+    /* Size of the files which are preserved on eviction */
+    qint64 keptSize;
+    QDateTime lastUsed;
+};
+
+typedef QList<CacheEntry> CacheEntries;
+
+} // namespace
+
+Q_DECLARE_METATYPE(SignOnUi::CacheEntries)
+
+namespace SignOnUi {
+
+static QStringList keptFiles()
+{
+    /* Without the cookies the user would have to login again */
+    return QStringList() << OAU_COOKIE_JAR_FILE << OAU_COOKIE_JSON_FILE;
+}
+
+static bool lessRecentlyUsed(const CacheEntry &e1, const CacheEntry &e2)
+{
+    return e1.lastUsed < e2.lastUsed;
+}
+
+class CacheScanner: public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void scan(const QString &cachePath);
+
+Q_SIGNALS:
+    void scanned(const CacheEntries &entries);
+};
+
+class CacheManagerPrivate: public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PUBLIC(CacheManager)
+
+public:
+    CacheManagerPrivate(CacheManager *q, DataRemover *remover);
+    ~CacheManagerPrivate();
+
+    void scheduleCollection();
+    bool isIdle() const { return !m_timer.isActive() && !m_isScanning; }
+    void updateIdle();
+
+public Q_SLOTS:
+    void collect();
+
+private Q_SLOTS:
+    void onScanned(const CacheEntries &entries);
+
+private:
+    DataRemover *m_remover;
+    QThread m_thread;
+    CacheScanner *m_scanner;
+    QTimer m_timer;
+    qint64 m_budget;
+    qint64 m_usage;
+    bool m_isScanning;
+    bool m_rescanNeeded;
+    bool m_wasIdle;
+    mutable CacheManager *q_ptr;
+};
+
+} // namespace
+
+void CacheScanner::scan(const QString &cachePath)
+{
+    CacheEntries entries;
+    QStringList kept = keptFiles();
+
+    QDir cacheDir(cachePath);
+    QStringList names = cacheDir.entryList(QStringList() << "id-*",
+                                           QDir::Dirs | QDir::NoDotAndDotDot);
+    Q_FOREACH(const QString &name, names) {
+        CacheEntry entry;
+        if (!CacheManager::identityFromDirName(name, entry.identity)) continue;
+
+        entry.path = cacheDir.filePath(name);
+        entry.size = 0;
+        entry.keptSize = 0;
+
+        QDirIterator it(entry.path,
+                        QDir::Files | QDir::Hidden | QDir::System,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            QFileInfo fileInfo = it.fileInfo();
+            entry.size += fileInfo.size();
+            if (fileInfo.path() == entry.path &&
+                kept.contains(fileInfo.fileName())) {
+                entry.keptSize += fileInfo.size();
+            }
+            QDateTime lastModified = fileInfo.lastModified();
+            if (!entry.lastUsed.isValid() || lastModified > entry.lastUsed) {
+                entry.lastUsed = lastModified;
+            }
+        }
+        /* The time of the directory itself is only used if it's empty: it
+         * changes when the directory is evicted, too */
+        if (!entry.lastUsed.isValid()) {
+            entry.lastUsed = QFileInfo(entry.path).lastModified();
+        }
+        entries.append(entry);
+    }
+
+    Q_EMIT scanned(entries);
+}
+
+CacheManagerPrivate::CacheManagerPrivate(CacheManager *q,
+                                         DataRemover *remover):
+    QObject(q),
+    m_remover(remover),
+    m_scanner(0),
+    m_budget(DEFAULT_BUDGET),
+    m_usage(0),
+    m_isScanning(false),
+    m_rescanNeeded(false),
+    m_wasIdle(true),
+    q_ptr(q)
+{
+    qRegisterMetaType<CacheEntries>("CacheEntries");
+
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(COLLECTION_DELAY);
+    QObject::connect(&m_timer, SIGNAL(timeout()),
+                     this, SLOT(collect()));
+}
+
+CacheManagerPrivate::~CacheManagerPrivate()
+{
+    if (m_scanner) {
+        m_thread.quit();
+        m_thread.wait();
+        delete m_scanner;
+    }
+}
+
+void CacheManagerPrivate::scheduleCollection()
+{
+    if (!m_timer.isActive()) {
+        m_timer.start();
+        updateIdle();
+    }
+}
+
+void CacheManagerPrivate::updateIdle()
+{
+    Q_Q(CacheManager);
+
+    bool idle = isIdle();
+    if (idle != m_wasIdle) {
+        m_wasIdle = idle;
+        Q_EMIT q->isIdleChanged();
+    }
+}
+
+void CacheManagerPrivate::collect()
+{
+    m_timer.stop();
+
+    if (m_isScanning) {
+        m_rescanNeeded = true;
+        return;
+    }
+
+    if (!m_scanner) {
+        m_scanner = new CacheScanner;
+        m_scanner->moveToThread(&m_thread);
+        QObject::connect(m_scanner, SIGNAL(scanned(const CacheEntries&)),
+                         this, SLOT(onScanned(const CacheEntries&)));
+        m_thread.start(QThread::LowPriority);
+    }
+
+    m_isScanning = true;
+    QMetaObject::invokeMethod(m_scanner, "scan", Qt::QueuedConnection,
+                              Q_ARG(QString, CacheManager::cachePath()));
+    updateIdle();
+}
+
+void CacheManagerPrivate::onScanned(const CacheEntries &entries)
+{
+    Q_Q(CacheManager);
+
+    m_isScanning = false;
+
+    /* Only the most recently used directory of each identity is ever used
+     * (see ServicePrivate::rootDirForIdentity()); the others are leftovers
+     * from older versions, which didn't append the provider ID to the
+     * directory name. */
+    QHash<quint32,int> newest;
+    qint64 usage = 0;
+    for (int i = 0; i < entries.count(); i++) {
+        const CacheEntry &entry = entries.at(i);
+        usage += entry.size;
+        QHash<quint32,int>::iterator j = newest.find(entry.identity);
+        if (j == newest.end()) {
+            newest.insert(entry.identity, i);
+        } else if (entries.at(j.value()).lastUsed < entry.lastUsed) {
+            j.value() = i;
+        }
+    }
+
+    /* Directories used recently might still be in use by a UI process which
+     * has not terminated yet */
+    QDateTime graceLimit =
+        QDateTime::currentDateTime().addSecs(-EVICTION_GRACE_PERIOD);
+
+    CacheEntries candidates;
+    for (int i = 0; i < entries.count(); i++) {
+        const CacheEntry &entry = entries.at(i);
+        if (newest.value(entry.identity) == i) {
+            candidates.append(entry);
+        } else if (entry.lastUsed > graceLimit) {
+            DEBUG() << "Keeping recently used directory" << entry.path;
+        } else {
+            DEBUG() << "Removing stale directory" << entry.path;
+            if (m_remover->removeDirectory(entry.path)) {
+                usage -= entry.size;
+            }
+        }
+    }
+
+    if (m_budget > 0 && usage > m_budget) {
+        std::sort(candidates.begin(), candidates.end(), lessRecentlyUsed);
+
+        Q_FOREACH(const CacheEntry &entry, candidates) {
+            if (usage <= m_budget || entry.lastUsed > graceLimit) break;
+
+            qint64 evictable = entry.size - entry.keptSize;
+            if (evictable <= 0) continue;
+
+            DEBUG() << "Evicting" << entry.path << evictable;
+            if (m_remover->removeDirectory(entry.path, keptFiles())) {
+                usage -= evictable;
+            }
+        }
+    }
+
+    DEBUG() << "Cache usage:" << usage << "budget:" << m_budget;
+    m_usage = usage;
+    Q_EMIT q->collected();
+
+    if (m_rescanNeeded) {
+        m_rescanNeeded = false;
+        m_timer.start();
+    }
+    updateIdle();
+}
+
+CacheManager::CacheManager(DataRemover *remover, QObject *parent):
+    QObject(parent),
+    d_ptr(new CacheManagerPrivate(this, remover))
+{
+}
+
+CacheManager::~CacheManager()
+{
+}
+
+QString CacheManager::cachePath()
+{
+    return QStandardPaths::writableLocation(
+        QStandardPaths::GenericCacheLocation) +
+        QStringLiteral("/online-accounts-ui");
+}
+
+bool CacheManager::identityFromDirName(const QString &name, quint32 &id)
+{
+    if (!name.startsWith("id-")) return false;
+
+    int end = name.indexOf('-', 3);
+    bool ok;
+    id = name.mid(3, end < 0 ? -1 : end - 3).toUInt(&ok);
+    return ok;
+}
+
+void CacheManager::setBudget(qint64 budget)
+{
+    Q_D(CacheManager);
+    d->m_budget = budget;
+}
+
+qint64 CacheManager::budget() const
+{
+    Q_D(const CacheManager);
+    return d->m_budget;
+}
+
+qint64 CacheManager::usage() const
+{
+    Q_D(const CacheManager);
+    return d->m_usage;
+}
+
+void CacheManager::scheduleCollection()
+{
+    Q_D(CacheManager);
+    d->scheduleCollection();
+}
+
+void CacheManager::collect()
+{
+    Q_D(CacheManager);
+    d->collect();
+}
+
+void CacheManager::setCollectionDelay(int msec)
+{
+    Q_D(CacheManager);
+    d->m_timer.setInterval(msec);
+}
+
+int CacheManager::collectionDelay() const
+{
+    Q_D(const CacheManager);
+    return d->m_timer.interval();
+}
+
+bool CacheManager::isIdle() const
+{
+    Q_D(const CacheManager);
+    return d->isIdle();
+}
+
+#include "cache-manager.moc"
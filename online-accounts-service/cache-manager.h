@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2014 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIGNON_UI_CACHE_MANAGER_H
+#define SIGNON_UI_CACHE_MANAGER_H
+
+#include <QObject>
+#include <QString>
+
+namespace SignOnUi {
+
+class DataRemover;
+
+class CacheManagerPrivate;
+class CacheManager: public QObject
+{
+    Q_OBJECT
+    /* Busy while a collection is scheduled or running */
+    Q_PROPERTY(bool isIdle READ isIdle NOTIFY isIdleChanged)
+
+public:
+    explicit CacheManager(DataRemover *remover, QObject *parent = 0);
+    ~CacheManager();
+
+    static QString cachePath();
+
+    /* Parses the name of an identity data directory: it's either
+     * "id-<signon-id>" or "id-<signon-id>-<provider-id>" */
+    static bool identityFromDirName(const QString &name, quint32 &id);
+
+    /* Maximum size of the cache, in bytes; 0 means unlimited */
+    void setBudget(qint64 budget);
+    qint64 budget() const;
+
+    /* Size of the cache, as of the last collection */
+    qint64 usage() const;
+
+    /* How long scheduleCollection() waits before collecting */
+    void setCollectionDelay(int msec);
+    int collectionDelay() const;
+
+    /* Runs a collection after a while; multiple calls are coalesced */
+    void scheduleCollection();
+    void collect();
+
+    bool isIdle() const;
+
+Q_SIGNALS:
+    void collected();
+    void isIdleChanged();
+
+private:
+    CacheManagerPrivate *d_ptr;
+    Q_DECLARE_PRIVATE(CacheManager)
+};
+
+} // namespace
+
+#endif // SIGNON_UI_CACHE_MANAGER_H
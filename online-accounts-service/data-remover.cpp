@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2014 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "data-remover.h"
+
+#include "debug.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QThread>
+
+using namespace SignOnUi;
+
+/* Tombstones are hidden files, so that they don't match the "id-*" pattern
+ * used to find the identity data directories */
+#define TOMBSTONE_PREFIX QStringLiteral(".removed-")
+
+namespace SignOnUi {
+
+class RemovalWorker: public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void removeRecursively(const QString &path) {
+        if (!QDir(path).removeRecursively()) {
+            qWarning() << "Could not completely remove" << path;
+        }
+        Q_EMIT removed(path);
+    }
+
+Q_SIGNALS:
+    void removed(const QString &path);
+};
+
+class DataRemoverPrivate: public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PUBLIC(DataRemover)
+
+public:
+    DataRemoverPrivate(DataRemover *q);
+    ~DataRemoverPrivate();
+
+    void queueRemoval(const QString &path);
+
+private Q_SLOTS:
+    void onRemoved(const QString &path);
+
+private:
+    QThread m_thread;
+    RemovalWorker *m_worker;
+    QSet<QString> m_pendingRemovals;
+    mutable DataRemover *q_ptr;
+};
+
+} // namespace
+
+DataRemoverPrivate::DataRemoverPrivate(DataRemover *q):
+    QObject(q),
+    m_worker(0),
+    q_ptr(q)
+{
+}
+
+DataRemoverPrivate::~DataRemoverPrivate()
+{
+    if (m_worker) {
+        /* Any unfinished removal will be completed by the sweep at the next
+         * startup */
+        m_thread.quit();
+        m_thread.wait();
+        delete m_worker;
+    }
+}
+
+void DataRemoverPrivate::queueRemoval(const QString &path)
+{
+    Q_Q(DataRemover);
+
+    if (m_pendingRemovals.contains(path)) return;
+
+    if (!m_worker) {
+        m_worker = new RemovalWorker;
+        m_worker->moveToThread(&m_thread);
+        QObject::connect(m_worker, SIGNAL(removed(const QString&)),
+                         this, SLOT(onRemoved(const QString&)));
+        m_thread.start(QThread::LowPriority);
+    }
+
+    bool wasIdle = m_pendingRemovals.isEmpty();
+    m_pendingRemovals.insert(path);
+    QMetaObject::invokeMethod(m_worker, "removeRecursively",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, path));
+    if (wasIdle) {
+        Q_EMIT q->isIdleChanged();
+    }
+}
+
+void DataRemoverPrivate::onRemoved(const QString &path)
+{
+    Q_Q(DataRemover);
+
+    DEBUG() << "Removed" << path;
+    m_pendingRemovals.remove(path);
+    if (m_pendingRemovals.isEmpty()) {
+        Q_EMIT q->isIdleChanged();
+    }
+}
+
+DataRemover::DataRemover(QObject *parent):
+    QObject(parent),
+    d_ptr(new DataRemoverPrivate(this))
+{
+}
+
+DataRemover::~DataRemover()
+{
+}
+
+bool DataRemover::removeDirectory(const QString &path,
+                                  const QStringList &keptFiles)
+{
+    Q_D(DataRemover);
+
+    QFileInfo fileInfo(path);
+    QString tombstone = fileInfo.absolutePath() + '/' + TOMBSTONE_PREFIX +
+        fileInfo.fileName() + '-' +
+        QString::number(QDateTime::currentMSecsSinceEpoch());
+
+    if (keptFiles.isEmpty()) {
+        /* The rename is atomic: from now on, the directory is no longer
+         * visible under its original name */
+        if (Q_UNLIKELY(!QDir().rename(path, tombstone))) {
+            qWarning() << "Could not rename" << path;
+            return false;
+        }
+    } else {
+        if (Q_UNLIKELY(!QDir().mkdir(tombstone))) {
+            qWarning() << "Could not create" << tombstone;
+            return false;
+        }
+        QDir dir(path);
+        QStringList names =
+            dir.entryList(QDir::AllEntries | QDir::Hidden | QDir::System |
+                          QDir::NoDotAndDotDot);
+        Q_FOREACH(const QString &name, names) {
+            if (keptFiles.contains(name)) continue;
+            if (Q_UNLIKELY(!dir.rename(name, tombstone + '/' + name))) {
+                qWarning() << "Could not move" << dir.filePath(name);
+            }
+        }
+    }
+
+    d->queueRemoval(tombstone);
+    return true;
+}
+
+void DataRemover::sweep(const QString &parentPath)
+{
+    Q_D(DataRemover);
+
+    QDir parentDir(parentPath);
+    QStringList names =
+        parentDir.entryList(QStringList() << TOMBSTONE_PREFIX + '*',
+                            QDir::Dirs | QDir::Hidden |
+                            QDir::NoDotAndDotDot);
+    Q_FOREACH(const QString &name, names) {
+        DEBUG() << "Found leftover tombstone" << name;
+        d->queueRemoval(parentDir.filePath(name));
+    }
+}
+
+bool DataRemover::isIdle() const
+{
+    Q_D(const DataRemover);
+    return d->m_pendingRemovals.isEmpty();
+}
+
+#include "data-remover.moc"
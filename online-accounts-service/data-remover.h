@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIGNON_UI_DATA_REMOVER_H
+#define SIGNON_UI_DATA_REMOVER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+namespace SignOnUi {
+
+class DataRemoverPrivate;
+class DataRemover: public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool isIdle READ isIdle NOTIFY isIdleChanged)
+
+public:
+    explicit DataRemover(QObject *parent = 0);
+    ~DataRemover();
+
+    /* Renames the directory into a tombstone, and deletes it in a
+     * background thread. If keptFiles is given, the directory itself is
+     * preserved and only the other entries are moved into the tombstone. */
+    bool removeDirectory(const QString &path,
+                         const QStringList &keptFiles = QStringList());
+
+    /* Deletes the tombstones found in the given directory */
+    void sweep(const QString &parentPath);
+
+    bool isIdle() const;
+
+Q_SIGNALS:
+    void isIdleChanged();
+
+private:
+    DataRemoverPrivate *d_ptr;
+    Q_DECLARE_PRIVATE(DataRemover)
+};
+
+} // namespace
+
+#endif // SIGNON_UI_DATA_REMOVER_H
@@ -28,10 +28,28 @@
 
 #include <QByteArray>
 #include <QDBusContext>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QQueue>
+#include <QSaveFile>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStandardPaths>
+#include <QTimer>
 
 using namespace OnlineAccountsUi;
 using namespace SignOnUi;
 
+#define FAILURE_JOURNAL_MAGIC 0x4f414a46 // "OAJF"
+/* Version 1 also stored the authentication data of the failures, after the
+ * fields which are still read */
+#define FAILURE_JOURNAL_VERSION 2
+
+/* How many accounts can be reauthenticated at the same time */
+#define MAX_CONCURRENT_REAUTHENTICATIONS 3
+
 QDBusArgument &operator<<(QDBusArgument &argument, const QSet<uint> &set)
 {
     argument.beginArray(qMetaTypeId<uint>());
@@ -59,6 +77,27 @@ namespace SignOnUi {
 
 static IndicatorService *m_instance = 0;
 
+/* A call to ReauthenticateAccount() or ReauthenticateAccounts(), waiting
+ * for all of its accounts to be processed. */
+struct ReauthenticationCall {
+    ReauthenticationCall(const QDBusMessage &m, bool b, int count):
+        message(m), isBatch(b), remaining(count) {}
+
+    void setResult(uint accountId, bool success);
+
+    QDBusMessage message;
+    bool isBatch;
+    int remaining;
+    QSet<uint> reauthenticated;
+};
+typedef QSharedPointer<ReauthenticationCall> ReauthenticationCallP;
+
+struct PendingReauthentication {
+    uint accountId;
+    QVariantMap extraParameters;
+    ReauthenticationCallP call;
+};
+
 class IndicatorServicePrivate: public QObject, QDBusContext
 {
     Q_OBJECT
@@ -69,7 +108,7 @@ public:
     Q_PROPERTY(bool ErrorStatus READ errorStatus)
 
     IndicatorServicePrivate(IndicatorService *service);
-    ~IndicatorServicePrivate() {};
+    ~IndicatorServicePrivate();
 
     QSet<uint> failures() const { return m_failures; }
     bool errorStatus() const { return m_errorStatus; }
@@ -80,26 +119,57 @@ public Q_SLOTS:
     void ReportFailure(uint accountId, const QVariantMap &notification);
     bool ReauthenticateAccount(uint accountId,
                                const QVariantMap &extraParameters);
+    QSet<uint> ReauthenticateAccounts(const QSet<uint> &accountIds,
+                                      const QVariantMap &extraParameters);
 
 private:
     void showNotification(const QVariantMap &parameters);
     void notifyPropertyChanged(const char *propertyName);
+    bool canReauthenticate(uint accountId) const;
+    void enqueueReauthentication(uint accountId,
+                                 const QVariantMap &extraParameters,
+                                 const ReauthenticationCallP &call);
+    void runReauthenticationQueue();
+    static QString journalPath();
+    void loadJournal();
+    void scheduleJournalSave() { m_journalTimer.start(); }
 
 private Q_SLOTS:
     void onReauthenticatorFinished(bool success);
+    void saveJournal();
+    void emitPropertiesChanged();
 
 private:
     mutable IndicatorService *q_ptr;
     WebcredentialsAdaptor *m_adaptor;
     QSet<uint> m_failures;
+    /* Failures loaded from the journal, which have not been reported again
+     * since: their authentication data is not known, so they cannot be
+     * replayed */
+    QSet<uint> m_restoredFailures;
     QMap<uint, QList<AuthData> > m_failureClientData;
     QMap<uint, Reauthenticator*> m_reauthenticators;
-    QDBusMessage m_clientMessage;
+    QMap<uint, ReauthenticationCallP> m_reauthenticationCalls;
+    QQueue<PendingReauthentication> m_reauthenticationQueue;
+    QTimer m_journalTimer;
+    QSet<QString> m_changedProperties;
+    QTimer m_propertiesChangedTimer;
     bool m_errorStatus;
 };
 
 } // namespace
 
+void ReauthenticationCall::setResult(uint accountId, bool success)
+{
+    if (success) reauthenticated.insert(accountId);
+    if (--remaining > 0) return;
+
+    QDBusMessage reply = isBatch ?
+        message.createReply(QVariant::fromValue(reauthenticated)) :
+        message.createReply(success);
+    QDBusConnection::sessionBus().send(reply);
+}
+
 IndicatorServicePrivate::IndicatorServicePrivate(IndicatorService *service):
     QObject(service),
     q_ptr(service),
@@ -107,6 +177,110 @@ IndicatorServicePrivate::IndicatorServicePrivate(IndicatorService *service):
     m_errorStatus(false)
 {
     qDBusRegisterMetaType< QSet<uint> >();
+
+    /* Writes to the journal are done once per main loop iteration at most */
+    m_journalTimer.setSingleShot(true);
+    m_journalTimer.setInterval(0);
+    QObject::connect(&m_journalTimer, SIGNAL(timeout()),
+                     this, SLOT(saveJournal()));
+
+    /* Property changes are notified all at once */
+    m_propertiesChangedTimer.setSingleShot(true);
+    m_propertiesChangedTimer.setInterval(0);
+    QObject::connect(&m_propertiesChangedTimer, SIGNAL(timeout()),
+                     this, SLOT(emitPropertiesChanged()));
+
+    loadJournal();
+}
+
+IndicatorServicePrivate::~IndicatorServicePrivate()
+{
+    if (m_propertiesChangedTimer.isActive()) {
+        emitPropertiesChanged();
+    }
+    if (m_journalTimer.isActive()) {
+        saveJournal();
+    }
+}
+
+QString IndicatorServicePrivate::journalPath()
+{
+    return QStandardPaths::writableLocation(
+        QStandardPaths::GenericDataLocation) +
+        QStringLiteral("/online-accounts-service/failures");
+}
+
+void IndicatorServicePrivate::loadJournal()
+{
+    QFile file(journalPath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (Q_UNLIKELY(magic != FAILURE_JOURNAL_MAGIC ||
+                   version < 1 || version > FAILURE_JOURNAL_VERSION)) {
+        qWarning() << "Ignoring invalid failure journal" << file.fileName();
+        return;
+    }
+
+    bool errorStatus;
+    QList<uint> failures;
+    stream >> errorStatus >> failures;
+    if (Q_UNLIKELY(stream.status() != QDataStream::Ok)) {
+        qWarning() << "Corrupted failure journal" << file.fileName();
+        return;
+    }
+
+    DEBUG() << "Restored failures:" << failures;
+    m_errorStatus = errorStatus;
+    m_failures = failures.toSet();
+    m_restoredFailures = m_failures;
+
+    /* Rewrite older journals, which contain authentication data */
+    if (version < FAILURE_JOURNAL_VERSION) scheduleJournalSave();
+}
+
+void IndicatorServicePrivate::saveJournal()
+{
+    m_journalTimer.stop();
+
+    QString path = journalPath();
+    if (m_failures.isEmpty() && !m_errorStatus) {
+        QFile::remove(path);
+        return;
+    }
+
+    /* Only the account IDs are stored: the authentication data contains
+     * secrets, and the parameters needed to replay it are not enough without
+     * them. Still, make the journal accessible to the user only. */
+    QDir dir = QFileInfo(path).dir();
+    if (!dir.exists()) {
+        dir.mkpath(".");
+        QFile::setPermissions(dir.path(), QFileDevice::ReadOwner |
+                              QFileDevice::WriteOwner |
+                              QFileDevice::ExeOwner);
+    }
+
+    QSaveFile file(path);
+    if (Q_UNLIKELY(!file.open(QIODevice::WriteOnly))) {
+        qWarning() << "Cannot write failure journal" << path;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << quint32(FAILURE_JOURNAL_MAGIC) <<
+        quint32(FAILURE_JOURNAL_VERSION);
+    stream << m_errorStatus << m_failures.toList();
+
+    /* The directory might have been created with looser permissions */
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    if (Q_UNLIKELY(!file.commit())) {
+        qWarning() << "Cannot write failure journal" << path;
+    }
 }
 
 void IndicatorServicePrivate::ClearErrorStatus()
@@ -114,6 +288,7 @@ void IndicatorServicePrivate::ClearErrorStatus()
     if (m_errorStatus) {
         m_errorStatus = false;
         notifyPropertyChanged("ErrorStatus");
+        scheduleJournalSave();
     }
 }
 
@@ -121,7 +296,12 @@ void IndicatorServicePrivate::RemoveFailures(const QSet<uint> &accountIds)
 {
     Q_Q(IndicatorService);
     m_failures.subtract(accountIds);
+    m_restoredFailures.subtract(accountIds);
+    Q_FOREACH(uint accountId, accountIds) {
+        m_failureClientData.remove(accountId);
+    }
     notifyPropertyChanged("Failures");
+    scheduleJournalSave();
     if (q->isIdle()) {
         Q_EMIT q->isIdleChanged();
     }
@@ -133,6 +313,7 @@ void IndicatorServicePrivate::ReportFailure(uint accountId,
     Q_Q(IndicatorService);
     bool wasIdle = q->isIdle();
     m_failures.insert(accountId);
+    m_restoredFailures.remove(accountId);
     if (wasIdle) {
         Q_EMIT q->isIdleChanged();
     }
@@ -154,16 +335,20 @@ void IndicatorServicePrivate::ReportFailure(uint accountId,
         authData.identity = quint32(notification["Identity"].toUInt());
         authData.method = notification["Method"].toString();
         authData.mechanism = notification["Mechanism"].toString();
-        failedAuthentications.append(authData);
+        /* The same authentication might fail several times, but there's no
+         * point in replaying it more than once. */
+        if (!failedAuthentications.contains(authData)) {
+            failedAuthentications.append(authData);
+        }
     }
 
     notifyPropertyChanged("Failures");
+    scheduleJournalSave();
 
     showNotification(notification);
 }
 
-bool IndicatorServicePrivate::ReauthenticateAccount(uint accountId,
-                                   const QVariantMap &extraParameters)
+bool IndicatorServicePrivate::canReauthenticate(uint accountId) const
 {
     if (!m_failureClientData.contains(accountId)) {
         /* Nothing we can do about this account */
@@ -171,33 +356,100 @@ bool IndicatorServicePrivate::ReauthenticateAccount(uint accountId,
         return false;
     }
 
-    if (m_reauthenticators.contains(accountId)) {
+    bool isQueued = false;
+    Q_FOREACH(const PendingReauthentication &p, m_reauthenticationQueue) {
+        if (p.accountId == accountId) { isQueued = true; break; }
+    }
+
+    if (isQueued || m_reauthenticators.contains(accountId)) {
         /* A reauthenticator for this account is already at work. This
          * shouldn't happen in a real world scenario. */
         qWarning() << "Reauthenticator already active on" << accountId;
         return false;
     }
 
+    return true;
+}
+
+void IndicatorServicePrivate::enqueueReauthentication(uint accountId,
+                                    const QVariantMap &extraParameters,
+                                    const ReauthenticationCallP &call)
+{
     DEBUG() << "Reauthenticating account" << accountId;
 
+    PendingReauthentication pending;
+    pending.accountId = accountId;
+    pending.extraParameters = extraParameters;
+    pending.call = call;
+    m_reauthenticationQueue.enqueue(pending);
+}
+
+void IndicatorServicePrivate::runReauthenticationQueue()
+{
+    while (m_reauthenticators.count() < MAX_CONCURRENT_REAUTHENTICATIONS &&
+           !m_reauthenticationQueue.isEmpty()) {
+        PendingReauthentication pending = m_reauthenticationQueue.dequeue();
+        uint accountId = pending.accountId;
+
+        /* The failure might have been removed while this was queued */
+        if (!m_failureClientData.contains(accountId)) {
+            pending.call->setResult(accountId, false);
+            continue;
+        }
+
+        QList<AuthData> &failedAuthentications =
+            m_failureClientData[accountId];
+
+        Reauthenticator *reauthenticator =
+            new Reauthenticator(failedAuthentications,
+                                pending.extraParameters, this);
+        m_reauthenticators[accountId] = reauthenticator;
+        m_reauthenticationCalls[accountId] = pending.call;
+
+        QObject::connect(reauthenticator, SIGNAL(finished(bool)),
+                         this, SLOT(onReauthenticatorFinished(bool)),
+                         Qt::QueuedConnection);
+        reauthenticator->start();
+    }
+}
+
+bool IndicatorServicePrivate::ReauthenticateAccount(uint accountId,
+                                   const QVariantMap &extraParameters)
+{
+    if (!canReauthenticate(accountId)) return false;
+
     /* If we need to reauthenticate, we are delivering the result
      * after iterating the event loop, so we must inform QtDBus that
      * it shouldn't use this method's return value as a result.
      */
     setDelayedReply(true);
-    m_clientMessage = message();
-    QList<AuthData> &failedAuthentications = m_failureClientData[accountId];
+    ReauthenticationCallP call(new ReauthenticationCall(message(), false, 1));
+    enqueueReauthentication(accountId, extraParameters, call);
+    runReauthenticationQueue();
 
-    Reauthenticator *reauthenticator =
-        new Reauthenticator(failedAuthentications, extraParameters, this);
-    m_reauthenticators[accountId] = reauthenticator;
+    return true; // ignored, see setDelayedReply() above.
+}
+
+QSet<uint> IndicatorServicePrivate::ReauthenticateAccounts(
+                                   const QSet<uint> &accountIds,
+                                   const QVariantMap &extraParameters)
+{
+    QList<uint> validIds;
+    Q_FOREACH(uint accountId, accountIds) {
+        if (canReauthenticate(accountId)) validIds.append(accountId);
+    }
 
-    QObject::connect(reauthenticator, SIGNAL(finished(bool)),
-                     this, SLOT(onReauthenticatorFinished(bool)),
-                     Qt::QueuedConnection);
-    reauthenticator->start();
+    if (validIds.isEmpty()) return QSet<uint>();
 
-    return true; // ignored, see setDelayedReply() above.
+    setDelayedReply(true);
+    ReauthenticationCallP call(new ReauthenticationCall(message(), true,
+                                                        validIds.count()));
+    Q_FOREACH(uint accountId, validIds) {
+        enqueueReauthentication(accountId, extraParameters, call);
+    }
+    runReauthenticationQueue();
+
+    return QSet<uint>(); // ignored, see setDelayedReply() above.
 }
 
 void IndicatorServicePrivate::showNotification(const QVariantMap &parameters)
@@ -232,14 +484,28 @@ void IndicatorServicePrivate::showNotification(const QVariantMap &parameters)
 
 void IndicatorServicePrivate::notifyPropertyChanged(const char *propertyName)
 {
+    m_changedProperties.insert(QString::fromLatin1(propertyName));
+    if (!m_propertiesChangedTimer.isActive()) {
+        m_propertiesChangedTimer.start();
+    }
+}
+
+void IndicatorServicePrivate::emitPropertiesChanged()
+{
+    m_propertiesChangedTimer.stop();
+    if (m_changedProperties.isEmpty()) return;
+
     QDBusMessage signal =
         QDBusMessage::createSignal(WEBCREDENTIALS_OBJECT_PATH,
                                    "org.freedesktop.DBus.Properties",
                                    "PropertiesChanged");
     signal << WEBCREDENTIALS_INTERFACE;
     QVariantMap changedProps;
-    changedProps.insert(QString::fromLatin1(propertyName),
-                        property(propertyName));
+    Q_FOREACH(const QString &propertyName, m_changedProperties) {
+        changedProps.insert(propertyName,
+                            property(propertyName.toLatin1().constData()));
+    }
+    m_changedProperties.clear();
     signal << changedProps;
     signal << QStringList();
     QDBusConnection::sessionBus().send(signal);
@@ -253,8 +519,8 @@ void IndicatorServicePrivate::onReauthenticatorFinished(bool success)
         qobject_cast<Reauthenticator*>(sender());
 
     /* Find the account; searching a map by value is inefficient, but
-     * in this case it's extremely likely that the map contains just
-     * one element. :-) */
+     * in this case the map contains at most
+     * MAX_CONCURRENT_REAUTHENTICATIONS elements. :-) */
     uint accountId = 0;
     QMap<uint,Reauthenticator*>::const_iterator i;
     for (i = m_reauthenticators.constBegin();
@@ -267,22 +533,29 @@ void IndicatorServicePrivate::onReauthenticatorFinished(bool success)
     }
     Q_ASSERT (accountId != 0);
 
-    QDBusMessage reply = m_clientMessage.createReply(success);
-    QDBusConnection::sessionBus().send(reply);
-
     if (success) {
         m_failureClientData.remove(accountId);
         m_failures.remove(accountId);
         notifyPropertyChanged("Failures");
+        scheduleJournalSave();
 
         if (m_failures.isEmpty()) {
             ClearErrorStatus();
+        }
+        if (q->isIdle()) {
             Q_EMIT q->isIdleChanged();
         }
     }
 
     m_reauthenticators.remove(accountId);
     reauthenticator->deleteLater();
+
+    ReauthenticationCallP call = m_reauthenticationCalls.take(accountId);
+    if (Q_LIKELY(call)) {
+        call->setResult(accountId, success);
+    }
+
+    runReauthenticationQueue();
 }
 
 IndicatorService::IndicatorService(QObject *parent):
@@ -312,6 +585,18 @@ QObject *IndicatorService::serviceObject() const
     return d_ptr;
 }
 
+void IndicatorService::setPropertiesChangedDelay(int msec)
+{
+    Q_D(IndicatorService);
+    d->m_propertiesChangedTimer.setInterval(msec);
+}
+
+int IndicatorService::propertiesChangedDelay() const
+{
+    Q_D(const IndicatorService);
+    return d->m_propertiesChangedTimer.interval();
+}
+
 void IndicatorService::clearErrorStatus()
 {
     Q_D(IndicatorService);
@@ -346,7 +631,9 @@ bool IndicatorService::errorStatus() const
 bool IndicatorService::isIdle() const
 {
     Q_D(const IndicatorService);
-    return d->m_failures.isEmpty();
+    /* The restored failures are in the journal already, and cannot be
+     * replayed: there's no reason to stay alive for them */
+    return d->m_failures.count() == d->m_restoredFailures.count();
 }
 
 #include "indicator-service.moc"
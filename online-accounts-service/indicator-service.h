@@ -49,6 +49,12 @@ public:
 
     QObject *serviceObject() const;
 
+    /* Property changes occurring within this interval are notified with a
+     * single D-Bus signal; the default is 0, meaning that changes are
+     * notified at the next main loop iteration. */
+    void setPropertiesChangedDelay(int msec);
+    int propertiesChangedDelay() const;
+
     void clearErrorStatus();
     void removeFailures(const QSet<uint> &accountIds);
     void reportFailure(uint accountId, const QVariantMap &notification);
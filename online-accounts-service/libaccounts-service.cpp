@@ -27,6 +27,10 @@
 #include <Accounts/Service>
 #include <QDBusArgument>
 #include <QDBusConnection>
+#include <QDBusMetaType>
+#include <QPair>
+#include <QSharedPointer>
+#include <QTimer>
 #include <QVariantMap>
 
 using namespace OnlineAccountsUi;
@@ -64,13 +68,73 @@ struct AccountChanges {
     QList<ServiceChanges> serviceChanges;
 };
 
+struct StoreResult {
+    StoreResult(): accountId(0) {}
+    quint32 accountId;
+    QString error;
+};
+
+/* Replies to a storeBatch() call, once all of its entries have been
+ * written (or have failed). */
+struct PendingBatch {
+    PendingBatch(const QDBusConnection &c, const QDBusMessage &m,
+                 int count):
+        message(m), connection(c), remaining(count), replied(false) {
+        for (int i = 0; i < count; i++) results.append(StoreResult());
+    }
+
+    void setResult(int index, quint32 accountId, const QString &error);
+    void replyIfDone();
+
+    QDBusMessage message;
+    QDBusConnection connection;
+    QList<StoreResult> results;
+    int remaining;
+    bool replied;
+};
+
 struct PendingWrite {
     PendingWrite(const QDBusConnection &c, const QDBusMessage &m):
-        message(m), connection(c) {}
+        message(m), connection(c), batchIndex(-1) {}
+    PendingWrite(const QSharedPointer<PendingBatch> &b, int index):
+        message(b->message), connection(b->connection),
+        batch(b), batchIndex(index) {}
+
+    void sendReply(quint32 accountId) const;
+    void sendError(const QString &errorMessage) const;
+
     QDBusMessage message;
     QDBusConnection connection;
+    QSharedPointer<PendingBatch> batch;
+    int batchIndex;
 };
 
+typedef QPair<AccountChanges,PendingWrite> WaitingChange;
+
+} // namespace
+
+Q_DECLARE_METATYPE(OnlineAccountsUi::StoreResult)
+
+QDBusArgument &operator<<(QDBusArgument &argument,
+                          const OnlineAccountsUi::StoreResult &result)
+{
+    argument.beginStructure();
+    argument << result.accountId << result.error;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument,
+                                OnlineAccountsUi::StoreResult &result)
+{
+    argument.beginStructure();
+    argument >> result.accountId >> result.error;
+    argument.endStructure();
+    return argument;
+}
+
+namespace OnlineAccountsUi {
+
 class LibaccountsServicePrivate: public QObject
 {
     Q_OBJECT
@@ -78,47 +142,171 @@ class LibaccountsServicePrivate: public QObject
 
 public:
     LibaccountsServicePrivate(LibaccountsService *q);
-    ~LibaccountsServicePrivate() {};
+    ~LibaccountsServicePrivate();
+
+    void writeChanges(const AccountChanges &changes,
+                      const PendingWrite &pendingWrite);
 
-    void writeChanges(const AccountChanges &changes);
+private:
+    void applyChanges(Accounts::Account *account,
+                      const AccountChanges &changes);
+    void syncAccount(Accounts::Account *account);
 
 private Q_SLOTS:
+    void onCoalescingTimeout();
     void onAccountSynced();
     void onAccountError(Accounts::Error error);
+    void onAccountDestroyed(QObject *object);
+    void writeWaitingChanges(quint32 accountId);
 
 private:
     Accounts::Manager m_manager;
-    QHash<Accounts::Account *,PendingWrite> m_pendingWrites;
+    QHash<Accounts::Account *,QList<PendingWrite> > m_pendingWrites;
+    /* Existing accounts whose changes are being collected, and which
+     * haven't been synced yet */
+    QHash<quint32,Accounts::Account *> m_coalescingAccounts;
+    /* Existing accounts being synced, until their object is destroyed */
+    QHash<quint32,Accounts::Account *> m_syncingAccounts;
+    /* Changes received while the account was being synced */
+    QHash<quint32,QList<WaitingChange> > m_waitingChanges;
+    int m_coalescingInterval;
     mutable LibaccountsService *q_ptr;
 };
 
 } // namespace
 
+static void readServiceChanges(const QDBusArgument &argument,
+                               QList<ServiceChanges> &serviceChanges)
+{
+    // signature: "a(ssua{sv}as)"
+    argument.beginArray();
+    while (!argument.atEnd()) {
+        ServiceChanges sc;
+        argument.beginStructure();
+        argument >> sc.service;
+        argument >> sc.serviceType;
+        argument >> sc.serviceId;
+        argument >> sc.settings;
+        argument >> sc.removedKeys;
+        argument.endStructure();
+
+        serviceChanges.append(sc);
+    }
+    argument.endArray();
+}
+
+void PendingBatch::setResult(int index, quint32 accountId,
+                             const QString &error)
+{
+    StoreResult &result = results[index];
+    result.accountId = accountId;
+    result.error = error;
+    remaining--;
+    replyIfDone();
+}
+
+void PendingBatch::replyIfDone()
+{
+    if (remaining > 0 || replied) return;
+    connection.send(message.createReply(QVariant::fromValue(results)));
+    replied = true;
+}
+
+void PendingWrite::sendReply(quint32 accountId) const
+{
+    if (batch) {
+        batch->setResult(batchIndex, accountId, QString());
+    } else {
+        connection.send(message.createReply(accountId));
+    }
+}
+
+void PendingWrite::sendError(const QString &errorMessage) const
+{
+    if (batch) {
+        batch->setResult(batchIndex, 0, errorMessage);
+    } else {
+        QDBusMessage reply =
+            message.createErrorReply(QDBusError::InternalError, errorMessage);
+        connection.send(reply);
+    }
+}
+
 LibaccountsServicePrivate::LibaccountsServicePrivate(LibaccountsService *q):
     QObject(q),
     m_manager(new Accounts::Manager(this)),
+    m_coalescingInterval(100),
     q_ptr(q)
 {
+    qDBusRegisterMetaType<StoreResult>();
+    qDBusRegisterMetaType<QList<StoreResult> >();
 }
 
-void LibaccountsServicePrivate::writeChanges(const AccountChanges &changes)
+LibaccountsServicePrivate::~LibaccountsServicePrivate()
 {
-    Q_Q(LibaccountsService);
+    /* The accounts are destroyed along with the manager, after our
+     * members */
+    Q_FOREACH(Accounts::Account *account, m_syncingAccounts) {
+        account->disconnect(this);
+    }
+}
 
+void LibaccountsServicePrivate::writeChanges(const AccountChanges &changes,
+                                             const PendingWrite &pendingWrite)
+{
     Accounts::Account *account;
 
     if (changes.created) {
         account = m_manager.createAccount(changes.provider);
+    } else if (m_syncingAccounts.contains(changes.accountId) ||
+               m_waitingChanges.contains(changes.accountId)) {
+        /* The Manager would return the same object which is being synced:
+         * wait until it's gone and apply these changes to a new one, after
+         * those which were already waiting */
+        m_waitingChanges[changes.accountId].append(
+            qMakePair(changes, pendingWrite));
+        return;
     } else {
-        account = m_manager.account(changes.accountId);
-        if (Q_UNLIKELY(!account)) {
-            qWarning() << "Couldn't load account" << changes.accountId;
-            return;
+        /* Changes to an existing account are not written right away: they
+         * are applied to the same Account object until the coalescing
+         * interval expires, and then written with a single sync(). Since
+         * they are applied in the order they were received, the last writer
+         * wins. */
+        account = m_coalescingAccounts.value(changes.accountId, 0);
+        if (!account) {
+            account = m_manager.account(changes.accountId);
+            if (Q_UNLIKELY(!account)) {
+                qWarning() << "Couldn't load account" << changes.accountId;
+                pendingWrite.sendError(QStringLiteral("Couldn't load account"));
+                return;
+            }
+
+            m_coalescingAccounts.insert(changes.accountId, account);
+            QTimer *timer = new QTimer(account);
+            timer->setSingleShot(true);
+            QObject::connect(timer, SIGNAL(timeout()),
+                             this, SLOT(onCoalescingTimeout()));
+            timer->start(m_coalescingInterval);
         }
     }
 
     Q_ASSERT(account);
 
+    applyChanges(account, changes);
+    m_pendingWrites[account].append(pendingWrite);
+
+    if (changes.created) {
+        syncAccount(account);
+    } else if (changes.deleted) {
+        /* Nothing can be added to a deleted account: write it now */
+        m_coalescingAccounts.remove(changes.accountId);
+        syncAccount(account);
+    }
+}
+
+void LibaccountsServicePrivate::applyChanges(Accounts::Account *account,
+                                             const AccountChanges &changes)
+{
     if (changes.deleted) {
         account->remove();
     } else {
@@ -146,9 +334,21 @@ void LibaccountsServicePrivate::writeChanges(const AccountChanges &changes)
             }
         }
     }
+}
+
+void LibaccountsServicePrivate::syncAccount(Accounts::Account *account)
+{
+    /* Stop the coalescing timer, if any */
+    Q_FOREACH(QTimer *timer, account->findChildren<QTimer*>()) {
+        timer->stop();
+    }
+
+    if (account->id() != 0) {
+        m_syncingAccounts.insert(account->id(), account);
+        QObject::connect(account, SIGNAL(destroyed(QObject*)),
+                         this, SLOT(onAccountDestroyed(QObject*)));
+    }
 
-    m_pendingWrites.insert(account,
-                           PendingWrite(q->connection(), q->message()));
     QObject::connect(account, SIGNAL(synced()),
                      this, SLOT(onAccountSynced()));
     QObject::connect(account, SIGNAL(error(Accounts::Error)),
@@ -156,17 +356,35 @@ void LibaccountsServicePrivate::writeChanges(const AccountChanges &changes)
     account->sync();
 }
 
+void LibaccountsServicePrivate::onCoalescingTimeout()
+{
+    Accounts::Account *account =
+        qobject_cast<Accounts::Account*>(sender()->parent());
+    Q_ASSERT(account);
+
+    quint32 accountId = m_coalescingAccounts.key(account, 0);
+    if (Q_UNLIKELY(accountId == 0)) return;
+
+    DEBUG() << "Writing" << m_pendingWrites.value(account).count() <<
+        "changes to account" << accountId;
+    m_coalescingAccounts.remove(accountId);
+    syncAccount(account);
+}
+
 void LibaccountsServicePrivate::onAccountSynced()
 {
     Accounts::Account *account = qobject_cast<Accounts::Account*>(sender());
     uint accountId = account->id();
+    /* Changes arriving now are queued until the object is destroyed */
+    Q_ASSERT(!m_coalescingAccounts.values().contains(account));
     account->deleteLater();
 
-    QHash<Accounts::Account*,PendingWrite>::iterator i =
+    QHash<Accounts::Account*,QList<PendingWrite> >::iterator i =
         m_pendingWrites.find(account);
     if (Q_LIKELY(i != m_pendingWrites.end())) {
-        PendingWrite &w = i.value();
-        w.connection.send(w.message.createReply(accountId));
+        Q_FOREACH(const PendingWrite &w, i.value()) {
+            w.sendReply(accountId);
+        }
         m_pendingWrites.erase(i);
     }
 }
@@ -174,20 +392,45 @@ void LibaccountsServicePrivate::onAccountSynced()
 void LibaccountsServicePrivate::onAccountError(Accounts::Error error)
 {
     Accounts::Account *account = qobject_cast<Accounts::Account*>(sender());
+    Q_ASSERT(!m_coalescingAccounts.values().contains(account));
     account->deleteLater();
 
-    QHash<Accounts::Account*,PendingWrite>::iterator i =
+    QHash<Accounts::Account*,QList<PendingWrite> >::iterator i =
         m_pendingWrites.find(account);
     if (Q_LIKELY(i != m_pendingWrites.end())) {
-        PendingWrite &w = i.value();
-        QDBusMessage reply =
-            w.message.createErrorReply(QDBusError::InternalError,
-                                       error.message());
-        w.connection.send(reply);
+        Q_FOREACH(const PendingWrite &w, i.value()) {
+            w.sendError(error.message());
+        }
         m_pendingWrites.erase(i);
     }
 }
 
+void LibaccountsServicePrivate::onAccountDestroyed(QObject *object)
+{
+    /* Only the address is used: the object is being destroyed */
+    quint32 accountId =
+        m_syncingAccounts.key(static_cast<Accounts::Account*>(object), 0);
+    if (Q_UNLIKELY(accountId == 0)) return;
+
+    m_syncingAccounts.remove(accountId);
+    if (m_waitingChanges.contains(accountId)) {
+        QMetaObject::invokeMethod(this, "writeWaitingChanges",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(quint32, accountId));
+    }
+}
+
+void LibaccountsServicePrivate::writeWaitingChanges(quint32 accountId)
+{
+    QList<WaitingChange> waiting = m_waitingChanges.take(accountId);
+    DEBUG() << "Writing" << waiting.count() <<
+        "changes received while syncing account" << accountId;
+
+    Q_FOREACH(const WaitingChange &change, waiting) {
+        writeChanges(change.first, change.second);
+    }
+}
+
 LibaccountsService::LibaccountsService(QObject *parent):
     QObject(parent),
     d_ptr(new LibaccountsServicePrivate(this))
@@ -199,6 +442,18 @@ LibaccountsService::~LibaccountsService()
     delete d_ptr;
 }
 
+void LibaccountsService::setCoalescingInterval(int msec)
+{
+    Q_D(LibaccountsService);
+    d->m_coalescingInterval = msec;
+}
+
+int LibaccountsService::coalescingInterval() const
+{
+    Q_D(const LibaccountsService);
+    return d->m_coalescingInterval;
+}
+
 void LibaccountsService::store(const QDBusMessage &msg)
 {
     Q_D(LibaccountsService);
@@ -232,22 +487,61 @@ void LibaccountsService::store(const QDBusMessage &msg)
     }
 
     const QDBusArgument dbusChanges = args.value(n++).value<QDBusArgument>();
-    dbusChanges.beginArray();
-    while (!dbusChanges.atEnd()) {
-        ServiceChanges sc;
-        dbusChanges.beginStructure();
-        dbusChanges >> sc.service;
-        dbusChanges >> sc.serviceType;
-        dbusChanges >> sc.serviceId;
-        dbusChanges >> sc.settings;
-        dbusChanges >> sc.removedKeys;
-        dbusChanges.endStructure();
+    readServiceChanges(dbusChanges, changes.serviceChanges);
+
+    d->writeChanges(changes, PendingWrite(connection(), msg));
+}
+
+void LibaccountsService::storeBatch(const QDBusMessage &msg)
+{
+    Q_D(LibaccountsService);
+
+    DEBUG() << "Got batch request:" << msg;
+
+    /* The following line tells QtDBus not to generate a reply now */
+    setDelayedReply(true);
+
+    QString provider = stripVersion(apparmorProfileOfPeer(msg));
+
+    // signature: "a(ubbsa(ssua{sv}as))"
+    QList<AccountChanges> batch;
+    const QDBusArgument dbusBatch =
+        msg.arguments().value(0).value<QDBusArgument>();
+    dbusBatch.beginArray();
+    while (!dbusBatch.atEnd()) {
+        AccountChanges changes;
+        dbusBatch.beginStructure();
+        dbusBatch >> changes.accountId;
+        dbusBatch >> changes.created;
+        dbusBatch >> changes.deleted;
+        dbusBatch >> changes.provider;
+        readServiceChanges(dbusBatch, changes.serviceChanges);
+        dbusBatch.endStructure();
+
+        batch.append(changes);
+    }
+    dbusBatch.endArray();
+
+    QSharedPointer<PendingBatch> pendingBatch(
+        new PendingBatch(connection(), msg, batch.count()));
+
+    /* Apply the same provider check as store() on each entry; entries
+     * failing it are reported in the reply and not written. */
+    for (int i = 0; i < batch.count(); i++) {
+        const AccountChanges &changes = batch.at(i);
+        if (changes.provider != provider) {
+            DEBUG() << "Declining AccountManager batch entry to" <<
+                provider << "for provider" << changes.provider;
+            pendingBatch->setResult(i, changes.accountId,
+                                    QStringLiteral("Profile/provider mismatch"));
+            continue;
+        }
 
-        changes.serviceChanges.append(sc);
+        d->writeChanges(changes, PendingWrite(pendingBatch, i));
     }
-    dbusChanges.endArray();
 
-    d->writeChanges(changes);
+    /* Needed if the batch is empty */
+    pendingBatch->replyIfDone();
 }
 
 #include "libaccounts-service.moc"
@@ -49,6 +49,10 @@ class LibaccountsService: public QObject, protected QDBusContext
 "      <arg direction=\"in\" type=\"a(ssua{sv}as)\"/>\n"
 "      <arg direction=\"out\" type=\"u\" name=\"account_id\"/>\n"
 "    </method>\n"
+"    <method name=\"storeBatch\">\n"
+"      <arg direction=\"in\" type=\"a(ubbsa(ssua{sv}as))\"/>\n"
+"      <arg direction=\"out\" type=\"a(us)\" name=\"results\"/>\n"
+"    </method>\n"
 "  </interface>\n"
         "")
 
@@ -56,8 +60,14 @@ public:
     explicit LibaccountsService(QObject *parent = 0);
     ~LibaccountsService();
 
+    /* Changes to an existing account received within this interval are
+     * written together. */
+    void setCoalescingInterval(int msec);
+    int coalescingInterval() const;
+
 public Q_SLOTS:
     void store(const QDBusMessage &msg);
+    void storeBatch(const QDBusMessage &msg);
 
 private:
     LibaccountsServicePrivate *d_ptr;
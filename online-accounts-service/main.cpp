@@ -18,6 +18,8 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "cache-manager.h"
+#include "data-remover.h"
 #include "debug.h"
 #include "globals.h"
 #include "inactivity-timer.h"
@@ -82,17 +84,29 @@ int main(int argc, char **argv)
     connection.registerService(OAU_SERVICE_NAME);
 
     SignOnUi::Service *signonuiService = new SignOnUi::Service();
+    /* size limit of the webview data, in megabytes; 0 means unlimited */
+    SignOnUi::CacheManager *cacheManager = signonuiService->cacheManager();
+    cacheManager->setBudget(
+        settings.value("CacheSizeLimit",
+                       cacheManager->budget() / (1024 * 1024)).toLongLong() *
+        1024 * 1024);
     connection.registerObject(SIGNONUI_OBJECT_PATH, signonuiService,
                               QDBusConnection::ExportAllContents);
     connection.registerService(SIGNONUI_SERVICE_NAME);
 
     SignOnUi::IndicatorService *indicatorService =
         new SignOnUi::IndicatorService();
+    indicatorService->setPropertiesChangedDelay(
+        settings.value("PropertiesChangedDelay",
+                       indicatorService->propertiesChangedDelay()).toInt());
     connection.registerObject(WEBCREDENTIALS_OBJECT_PATH,
                               indicatorService->serviceObject());
     connection.registerService(WEBCREDENTIALS_BUS_NAME);
 
     LibaccountsService *libaccountsService = new LibaccountsService();
+    libaccountsService->setCoalescingInterval(
+        settings.value("WriteCoalescingInterval",
+                       libaccountsService->coalescingInterval()).toInt());
     connection.registerObject(LIBACCOUNTS_OBJECT_PATH, libaccountsService,
                               QDBusConnection::ExportAllContents);
     connection.registerService(LIBACCOUNTS_BUS_NAME);
@@ -120,6 +134,8 @@ int main(int argc, char **argv)
         inactivityTimer->watchObject(v2api);
         inactivityTimer->watchObject(requestManager);
         inactivityTimer->watchObject(indicatorService);
+        inactivityTimer->watchObject(signonuiService->dataRemover());
+        inactivityTimer->watchObject(signonuiService->cacheManager());
         QObject::connect(inactivityTimer, SIGNAL(timeout()),
                          &app, SLOT(quit()));
     }
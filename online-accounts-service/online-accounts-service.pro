@@ -42,15 +42,19 @@ INCLUDEPATH += \
     $${COMMON_SRC}
 
 SOURCES += \
+    $${COMMON_SRC}/cookie-jar.cpp \
     $${COMMON_SRC}/debug.cpp \
     $${COMMON_SRC}/i18n.cpp \
     $${COMMON_SRC}/ipc.cpp \
     $${COMMON_SRC}/notification.cpp \
+    cache-manager.cpp \
+    data-remover.cpp \
     inactivity-timer.cpp \
     indicator-service.cpp \
     libaccounts-service.cpp \
     main.cpp \
     reauthenticator.cpp \
+    render-stats.cpp \
     request.cpp \
     request-manager.cpp \
     service.cpp \
@@ -59,15 +63,19 @@ SOURCES += \
     utils.cpp
 
 HEADERS += \
+    $${COMMON_SRC}/cookie-jar.h \
     $${COMMON_SRC}/debug.h \
     $${COMMON_SRC}/i18n.h \
     $${COMMON_SRC}/ipc.h \
     $${COMMON_SRC}/notification.h \
+    cache-manager.h \
+    data-remover.h \
     inactivity-timer.h \
     indicator-service.h \
     libaccounts-service.h \
     mir-helper.h \
     reauthenticator.h \
+    render-stats.h \
     request.h \
     request-manager.h \
     service.h \
@@ -22,14 +22,36 @@
 
 #include "debug.h"
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+#include <QQueue>
+#include <QTimer>
 #include <SignOn/AuthSession>
 #include <SignOn/Identity>
 
 using namespace SignOnUi;
 using namespace SignOn;
 
+/* How many authentication sessions can be running at the same time */
+#define MAX_CONCURRENT_SESSIONS 2
+
+/* Transient errors are retried up to MAX_RETRIES times, waiting
+ * RETRY_BASE_DELAY ms before the first retry and doubling the delay at each
+ * subsequent one. */
+#define MAX_RETRIES 3
+#ifndef RETRY_BASE_DELAY
+#define RETRY_BASE_DELAY 1000
+#endif
+
 namespace SignOnUi {
 
+struct Attempt {
+    int index;
+    int retries;
+    QElapsedTimer timer;
+};
+
 class ReauthenticatorPrivate: public QObject
 {
     Q_OBJECT
@@ -44,16 +66,24 @@ public:
     void start();
 
 private:
+    void startNext();
+    bool startSession(int index, int retries);
+    Attempt takeAttempt(QObject *authSession);
     void checkFinished();
 
 private Q_SLOTS:
     void onError(const SignOn::Error &error);
     void onResponse(const SignOn::SessionData &response);
+    void onRetryTimeout();
 
 private:
     mutable Reauthenticator *q_ptr;
     QList<AuthData> m_clientData;
     QVariantMap m_extraParameters;
+    QHash<QObject*,Attempt> m_activeAttempts;
+    /* Attempts whose backoff delay has expired, as (index, retries) */
+    QQueue<QPair<int,int> > m_retryQueue;
+    int m_nextIndex;
     int m_errorCount;
     int m_responseCount;
 };
@@ -66,11 +96,17 @@ ReauthenticatorPrivate::ReauthenticatorPrivate(
     Reauthenticator *request):
     QObject(request),
     q_ptr(request),
-    m_clientData(clientData),
     m_extraParameters(extraParameters),
+    m_nextIndex(0),
     m_errorCount(0),
     m_responseCount(0)
 {
+    /* There's no point in replaying the same authentication twice */
+    Q_FOREACH(const AuthData &authData, clientData) {
+        if (!m_clientData.contains(authData)) {
+            m_clientData.append(authData);
+        }
+    }
 }
 
 ReauthenticatorPrivate::~ReauthenticatorPrivate()
@@ -79,37 +115,75 @@ ReauthenticatorPrivate::~ReauthenticatorPrivate()
 
 void ReauthenticatorPrivate::start()
 {
-    Q_FOREACH(const AuthData &authData, m_clientData) {
-        Identity *identity =
-            Identity::existingIdentity(authData.identity, this);
-        if (identity == 0) { m_errorCount++; continue; }
-
-        AuthSession *authSession = identity->createSession(authData.method);
-        if (authSession == 0) { m_errorCount++; continue; }
-
-        QObject::connect(authSession,
-                         SIGNAL(error(const SignOn::Error &)),
-                         this,
-                         SLOT(onError(const SignOn::Error &)));
-        QObject::connect(authSession,
-                         SIGNAL(response(const SignOn::SessionData &)),
-                         this,
-                         SLOT(onResponse(const SignOn::SessionData &)));
-
-        /* Prepare the session data, adding the extra parameters. */
-        QVariantMap sessionData = authData.sessionData;
-        QVariantMap::const_iterator i;
-        for (i = m_extraParameters.constBegin();
-             i != m_extraParameters.constEnd();
-             i++) {
-            sessionData[i.key()] = i.value();
+    startNext();
+    checkFinished();
+}
+
+void ReauthenticatorPrivate::startNext()
+{
+    /* Don't start all the sessions at once: that would flood signond and
+     * the signon-ui queue, starving any interactive requests. */
+    while (m_activeAttempts.count() < MAX_CONCURRENT_SESSIONS) {
+        /* Retries go first, since they have been waiting longer */
+        if (!m_retryQueue.isEmpty()) {
+            QPair<int,int> retry = m_retryQueue.dequeue();
+            if (!startSession(retry.first, retry.second)) m_errorCount++;
+        } else if (m_nextIndex < m_clientData.count()) {
+            if (!startSession(m_nextIndex++, 0)) m_errorCount++;
+        } else {
+            break;
         }
+    }
+}
 
-        /* Start the session right now; signon-ui is queueing them anyway. */
-        authSession->process(sessionData, authData.mechanism);
+bool ReauthenticatorPrivate::startSession(int index, int retries)
+{
+    const AuthData &authData = m_clientData.at(index);
+
+    Identity *identity =
+        Identity::existingIdentity(authData.identity, this);
+    if (identity == 0) return false;
+
+    AuthSession *authSession = identity->createSession(authData.method);
+    if (authSession == 0) {
+        identity->deleteLater();
+        return false;
     }
 
-    checkFinished();
+    QObject::connect(authSession,
+                     SIGNAL(error(const SignOn::Error &)),
+                     this,
+                     SLOT(onError(const SignOn::Error &)));
+    QObject::connect(authSession,
+                     SIGNAL(response(const SignOn::SessionData &)),
+                     this,
+                     SLOT(onResponse(const SignOn::SessionData &)));
+
+    /* Prepare the session data, adding the extra parameters. */
+    QVariantMap sessionData = authData.sessionData;
+    QVariantMap::const_iterator i;
+    for (i = m_extraParameters.constBegin();
+         i != m_extraParameters.constEnd();
+         i++) {
+        sessionData[i.key()] = i.value();
+    }
+
+    Attempt &attempt = m_activeAttempts[authSession];
+    attempt.index = index;
+    attempt.retries = retries;
+    attempt.timer.start();
+
+    authSession->process(sessionData, authData.mechanism);
+    return true;
+}
+
+Attempt ReauthenticatorPrivate::takeAttempt(QObject *authSession)
+{
+    Attempt attempt = m_activeAttempts.take(authSession);
+
+    /* The session is owned by the identity */
+    authSession->parent()->deleteLater();
+    return attempt;
 }
 
 void ReauthenticatorPrivate::checkFinished()
@@ -122,18 +196,54 @@ void ReauthenticatorPrivate::checkFinished()
 
 void ReauthenticatorPrivate::onError(const SignOn::Error &error)
 {
-    DEBUG() << "Got error:" << error.message();
+    Attempt attempt = takeAttempt(sender());
+    DEBUG() << "Got error:" << error.message() << "for identity" <<
+        m_clientData.at(attempt.index).identity << "after" <<
+        attempt.timer.elapsed() << "ms, attempt" << attempt.retries + 1;
 
-    m_errorCount++;
+    bool isTransient = error.type() == SignOn::Error::Network ||
+        error.type() == SignOn::Error::NoConnection ||
+        error.type() == SignOn::Error::TimedOut;
+    if (isTransient && attempt.retries < MAX_RETRIES) {
+        int delay = RETRY_BASE_DELAY << attempt.retries;
+        DEBUG() << "Retrying in" << delay << "ms";
+        QTimer *timer = new QTimer(this);
+        timer->setSingleShot(true);
+        timer->setProperty("index", attempt.index);
+        timer->setProperty("retries", attempt.retries + 1);
+        QObject::connect(timer, SIGNAL(timeout()),
+                         this, SLOT(onRetryTimeout()));
+        timer->start(delay);
+    } else {
+        m_errorCount++;
+    }
+
+    startNext();
     checkFinished();
 }
 
 void ReauthenticatorPrivate::onResponse(
                                     const SignOn::SessionData &response)
 {
-    DEBUG() << "Got response:" << response.toMap();
+    Attempt attempt = takeAttempt(sender());
+    DEBUG() << "Got response:" << response.toMap() << "for identity" <<
+        m_clientData.at(attempt.index).identity << "after" <<
+        attempt.timer.elapsed() << "ms, attempt" << attempt.retries + 1;
 
     m_responseCount++;
+    startNext();
+    checkFinished();
+}
+
+void ReauthenticatorPrivate::onRetryTimeout()
+{
+    QTimer *timer = qobject_cast<QTimer*>(sender());
+    int index = timer->property("index").toInt();
+    int retries = timer->property("retries").toInt();
+    timer->deleteLater();
+
+    m_retryQueue.enqueue(qMakePair(index, retries));
+    startNext();
     checkFinished();
 }
 
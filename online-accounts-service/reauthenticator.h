@@ -32,6 +32,13 @@ struct AuthData {
     QString method;
     QString mechanism;
     QVariantMap sessionData;
+
+    bool operator==(const AuthData &other) const {
+        return identity == other.identity &&
+            method == other.method &&
+            mechanism == other.mechanism &&
+            sessionData == other.sessionData;
+    }
 };
 
 class ReauthenticatorPrivate;
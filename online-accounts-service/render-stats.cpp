@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "render-stats.h"
+
+#include "debug.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+using namespace OnlineAccountsUi;
+
+#define RENDER_STATS_MAGIC 0x4f415253 // "OARS"
+#define RENDER_STATS_VERSION 1
+
+namespace OnlineAccountsUi {
+
+struct TimingStats {
+    TimingStats(): count(0), total(0), max(0) {}
+    quint32 count;
+    qint64 total;
+    qint64 max;
+};
+
+typedef QHash<QString,TimingStats> RequestTimings;
+
+QDataStream &operator<<(QDataStream &stream, const TimingStats &stats)
+{
+    stream << stats.count << stats.total << stats.max;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, TimingStats &stats)
+{
+    stream >> stats.count >> stats.total >> stats.max;
+    return stream;
+}
+
+class RenderStatsPrivate
+{
+    Q_DECLARE_PUBLIC(RenderStats)
+
+public:
+    RenderStatsPrivate(RenderStats *q);
+
+    /* The service is started on demand and exits when idle: the statistics
+     * are stored on disk, not to lose them at every restart. */
+    static QString storePath();
+    void load();
+    void save() const;
+
+private:
+    mutable RenderStats *q_ptr;
+    /* provider ID -> request type -> timing name -> statistics */
+    QMap<QString,QMap<QString,RequestTimings> > m_timings;
+};
+
+} // namespace
+
+RenderStatsPrivate::RenderStatsPrivate(RenderStats *q):
+    q_ptr(q)
+{
+    load();
+}
+
+QString RenderStatsPrivate::storePath()
+{
+    return QStandardPaths::writableLocation(
+        QStandardPaths::GenericDataLocation) +
+        QStringLiteral("/online-accounts-service/render-stats");
+}
+
+void RenderStatsPrivate::load()
+{
+    QFile file(storePath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (Q_UNLIKELY(magic != RENDER_STATS_MAGIC ||
+                   version != RENDER_STATS_VERSION)) {
+        qWarning() << "Ignoring invalid render statistics" << file.fileName();
+        return;
+    }
+
+    QMap<QString,QMap<QString,RequestTimings> > timings;
+    stream >> timings;
+    if (Q_UNLIKELY(stream.status() != QDataStream::Ok)) {
+        qWarning() << "Corrupted render statistics" << file.fileName();
+        return;
+    }
+
+    m_timings = timings;
+}
+
+void RenderStatsPrivate::save() const
+{
+    QString path = storePath();
+
+    if (m_timings.isEmpty()) {
+        QFile::remove(path);
+        return;
+    }
+
+    QDir dir = QFileInfo(path).dir();
+    if (!dir.exists()) dir.mkpath(".");
+
+    QSaveFile file(path);
+    if (Q_UNLIKELY(!file.open(QIODevice::WriteOnly))) {
+        qWarning() << "Cannot write render statistics" << path;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << quint32(RENDER_STATS_MAGIC) << quint32(RENDER_STATS_VERSION);
+    stream << m_timings;
+
+    if (Q_UNLIKELY(!file.commit())) {
+        qWarning() << "Cannot save render statistics" << path;
+    }
+}
+
+RenderStats *RenderStats::m_instance = 0;
+
+RenderStats *RenderStats::instance()
+{
+    if (!m_instance) {
+        m_instance = new RenderStats;
+    }
+
+    return m_instance;
+}
+
+RenderStats::RenderStats(QObject *parent):
+    QObject(parent),
+    d_ptr(new RenderStatsPrivate(this))
+{
+}
+
+RenderStats::~RenderStats()
+{
+    delete d_ptr;
+}
+
+void RenderStats::addTimings(const QString &providerId,
+                             const QString &requestType,
+                             const QVariantMap &timings)
+{
+    Q_D(RenderStats);
+
+    DEBUG() << providerId << requestType << timings;
+
+    RequestTimings &requestTimings = d->m_timings[providerId][requestType];
+    QMapIterator<QString, QVariant> it(timings);
+    while (it.hasNext()) {
+        it.next();
+        bool ok;
+        qint64 elapsed = it.value().toLongLong(&ok);
+        if (Q_UNLIKELY(!ok || elapsed < 0)) continue;
+
+        TimingStats &stats = requestTimings[it.key()];
+        stats.count++;
+        stats.total += elapsed;
+        if (elapsed > stats.max) stats.max = elapsed;
+    }
+
+    d->save();
+}
+
+QVariantMap RenderStats::timings() const
+{
+    Q_D(const RenderStats);
+
+    QVariantMap providers;
+    QMapIterator<QString,QMap<QString,RequestTimings> > i(d->m_timings);
+    while (i.hasNext()) {
+        i.next();
+        QVariantMap requestTypes;
+        QMapIterator<QString,RequestTimings> j(i.value());
+        while (j.hasNext()) {
+            j.next();
+            QVariantMap timings;
+            QHashIterator<QString,TimingStats> k(j.value());
+            while (k.hasNext()) {
+                k.next();
+                const TimingStats &stats = k.value();
+                QVariantMap entry;
+                entry.insert("count", stats.count);
+                entry.insert("mean", stats.total / stats.count);
+                entry.insert("max", stats.max);
+                timings.insert(k.key(), entry);
+            }
+            requestTypes.insert(j.key(), timings);
+        }
+        providers.insert(i.key(), requestTypes);
+    }
+    return providers;
+}
+
+void RenderStats::clear()
+{
+    Q_D(RenderStats);
+    d->m_timings.clear();
+    d->save();
+}
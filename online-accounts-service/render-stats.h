@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAU_RENDER_STATS_H
+#define OAU_RENDER_STATS_H
+
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+namespace OnlineAccountsUi {
+
+/* Collects the UI timings reported by the online-accounts-ui processes,
+ * aggregated per provider and request type. The aggregates are kept across
+ * restarts of the service. */
+class RenderStatsPrivate;
+class RenderStats: public QObject
+{
+    Q_OBJECT
+
+public:
+    static RenderStats *instance();
+
+    void addTimings(const QString &providerId, const QString &requestType,
+                    const QVariantMap &timings);
+
+    /* Returns a dictionary keyed by provider ID, whose values are
+     * dictionaries keyed by request type; for each of these, every timing
+     * is described by a dictionary holding "count", "mean" and "max". */
+    QVariantMap timings() const;
+
+    void clear();
+
+protected:
+    explicit RenderStats(QObject *parent = 0);
+    ~RenderStats();
+
+private:
+    static RenderStats *m_instance;
+    RenderStatsPrivate *d_ptr;
+    Q_DECLARE_PRIVATE(RenderStats)
+};
+
+} // namespace
+
+#endif // OAU_RENDER_STATS_H
@@ -64,6 +64,7 @@ private:
     mutable Request *q_ptr;
     QDBusConnection m_connection;
     QDBusMessage m_message;
+    QList<QDBusMessage> m_refreshMessages;
     QVariantMap m_parameters;
     QString m_clientApparmorProfile;
     bool m_inProgress;
@@ -204,6 +205,21 @@ int Request::delay() const
     return d->m_delay;
 }
 
+void Request::refresh(const QDBusMessage &message,
+                      const QVariantMap &parameters)
+{
+    Q_D(Request);
+
+    QMapIterator<QString, QVariant> it(parameters);
+    while (it.hasNext()) {
+        it.next();
+        d->m_parameters.insert(it.key(), it.value());
+    }
+    d->m_refreshMessages.append(message);
+
+    Q_EMIT refreshed(parameters);
+}
+
 void Request::cancel()
 {
     setCanceled();
@@ -214,6 +230,10 @@ void Request::fail(const QString &name, const QString &message)
     Q_D(Request);
     QDBusMessage reply = d->m_message.createErrorReply(name, message);
     d->m_connection.send(reply);
+    Q_FOREACH(const QDBusMessage &refreshMessage, d->m_refreshMessages) {
+        d->m_connection.send(refreshMessage.createErrorReply(name, message));
+    }
+    d->m_refreshMessages.clear();
 
     Q_EMIT completed();
 }
@@ -233,6 +253,11 @@ void Request::setResult(const QVariantMap &result)
     if (d->m_inProgress) {
         QDBusMessage reply = d->m_message.createReply(result);
         d->m_connection.send(reply);
+        Q_FOREACH(const QDBusMessage &refreshMessage,
+                  d->m_refreshMessages) {
+            d->m_connection.send(refreshMessage.createReply(result));
+        }
+        d->m_refreshMessages.clear();
 
         Q_EMIT completed();
         d->m_inProgress = false;
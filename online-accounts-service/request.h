@@ -54,11 +54,16 @@ public:
     void setDelay(int delay);
     int delay() const;
 
+    /* Updates the parameters of the request; the reply to "message" will be
+     * sent when the request completes. */
+    void refresh(const QDBusMessage &message, const QVariantMap &parameters);
+
 public Q_SLOTS:
     void cancel();
 
 Q_SIGNALS:
     void completed();
+    void refreshed(const QVariantMap &parameters);
 
 public Q_SLOTS:
     void fail(const QString &name, const QString &message);
@@ -21,6 +21,7 @@
 #include "debug.h"
 #include "globals.h"
 #include "onlineaccountsui_adaptor.h"
+#include "render-stats.h"
 #include "request.h"
 #include "request-manager.h"
 #include "service.h"
@@ -50,3 +51,8 @@ QVariantMap Service::requestAccess(const QVariantMap &options)
 
     return QVariantMap();
 }
+
+QVariantMap Service::renderTimings() const
+{
+    return RenderStats::instance()->timings();
+}
@@ -32,11 +32,14 @@ class ServicePrivate;
 class Service: public QObject, protected QDBusContext
 {
     Q_OBJECT
+    Q_PROPERTY(QVariantMap RenderTimings READ renderTimings)
 
 public:
     explicit Service(QObject *parent = 0);
     ~Service();
 
+    QVariantMap renderTimings() const;
+
 public Q_SLOTS:
     QVariantMap requestAccess(const QVariantMap &options);
 
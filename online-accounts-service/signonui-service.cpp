@@ -18,96 +18,37 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "cache-manager.h"
+#include "cookie-jar.h"
+#include "data-remover.h"
 #include "debug.h"
 #include "request.h"
 #include "request-manager.h"
 #include "signonui-service.h"
+#include "utils.h"
 
-#include <QDBusArgument>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QJsonArray>
-#include <QJsonDocument>
+#include <QFileSystemWatcher>
+#include <QHash>
 #include <QList>
-#include <QNetworkCookie>
-#include <QStandardPaths>
+#include <QSet>
 #include <QVariant>
+#include <SignOn/uisessiondata.h>
 #include <SignOn/uisessiondata_priv.h>
 
+using namespace OnlineAccountsUi;
 using namespace SignOnUi;
 
 namespace SignOnUi {
 
-static QList<QByteArray> cookiesFromVariant(const QVariantList &cl)
-{
-    QList<QByteArray> cookies;
-    Q_FOREACH(QVariant cookie, cl) {
-        if (!cookie.canConvert(QVariant::Map)) {
-            continue;
-        }
-
-        QNetworkCookie nc;
-        QVariantMap vm = cookie.toMap();
-        if (!vm.contains("name") || !vm.contains("value")) {
-            continue;
-        }
-
-        nc.setName(vm.value("name").toByteArray());
-        nc.setValue(vm.value("value").toByteArray());
-        nc.setDomain(vm.value("domain").toString());
-        nc.setPath(vm.value("path").toString());
-        if (vm.contains("httponly") &&
-            vm.value("httponly").canConvert(QVariant::Bool)) {
-            nc.setHttpOnly(vm.value("httponly").toBool());
-        }
-
-        if (vm.contains("issecure") &&
-            vm.value("issecure").canConvert(QVariant::Bool)) {
-            nc.setSecure(vm.value("issecure").toBool());
-        }
-
-        if (vm.contains("expirationdate") &&
-            vm.value("expirationdate").canConvert(QMetaType::QDateTime)) {
-            nc.setExpirationDate(vm.value("expirationdate").toDateTime());
-        }
-
-        cookies.append(nc.toRawForm());
-    }
-    return cookies;
-}
-
-static QVariant dbusValueToVariant(const QDBusArgument &argument)
-{
-    QVariant ret;
-
-    /* Note: this function should operate recursively, but it doesn't. */
-    if (argument.currentType() == QDBusArgument::MapType) {
-        /* Assume that all maps are a{sv} */
-        ret = qdbus_cast<QVariantMap>(argument);
-    } else {
-        /* We don't know how to handle other types */
-        ret = argument.asVariant();
-    }
-    return ret;
-}
-
-static QVariantMap expandDBusArguments(const QVariantMap &dbusMap)
-{
-    QVariantMap map;
-    QMapIterator<QString, QVariant> it(dbusMap);
-    while (it.hasNext()) {
-        it.next();
-        if (qstrcmp(it.value().typeName(), "QDBusArgument") == 0) {
-            QDBusArgument dbusValue = it.value().value<QDBusArgument>();
-            map.insert(it.key(), dbusValueToVariant(dbusValue));
-        } else {
-            map.insert(it.key(), it.value());
-        }
-    }
-    return map;
-}
+struct CachedCookies {
+    QDateTime lastModified;
+    qint64 size;
+    RawCookies cookies;
+};
 
 class ServicePrivate: public QObject
 {
@@ -120,21 +61,50 @@ public:
 
     void cancelUiRequest(const QString &requestId);
     void removeIdentityData(quint32 id);
-    RawCookies cookiesForIdentity(quint32 id, qint64 &timestamp) const;
+    RawCookies cookiesForIdentity(quint32 id, qint64 &timestamp);
 
-    static QString rootDirForIdentity(quint32 id);
+    QString rootDirForIdentity(quint32 id);
+
+private:
+    void buildIdentityIndex(const QString &cachePath);
+
+private Q_SLOTS:
+    void onCacheDirChanged();
 
 private:
     mutable Service *q_ptr;
+    /* Maps a signon identity to its data directories; see
+     * rootDirForIdentity() */
+    QHash<quint32,QStringList> m_identityDirs;
+    /* Identities which were not found in the index even after rebuilding
+     * it; they are not looked for again until the cache directory changes */
+    QSet<quint32> m_missingIdentities;
+    QString m_indexedCachePath;
+    bool m_identityIndexIsValid;
+    QFileSystemWatcher m_cacheDirWatcher;
+    /* Parsed cookies, by file name */
+    QHash<QString,CachedCookies> m_cookieCache;
+    DataRemover m_dataRemover;
+    CacheManager m_cacheManager;
 };
 
 } // namespace
 
 ServicePrivate::ServicePrivate(Service *service):
     QObject(service),
-    q_ptr(service)
+    q_ptr(service),
+    m_identityIndexIsValid(false),
+    m_cacheManager(&m_dataRemover)
 {
     qRegisterMetaType<RawCookies>("RawCookies");
+
+    QObject::connect(&m_cacheDirWatcher, SIGNAL(directoryChanged(QString)),
+                     this, SLOT(onCacheDirChanged()));
+
+    /* Complete any removal which was interrupted */
+    m_dataRemover.sweep(CacheManager::cachePath());
+
+    m_cacheManager.scheduleCollection();
 }
 
 ServicePrivate::~ServicePrivate()
@@ -154,6 +124,44 @@ void ServicePrivate::cancelUiRequest(const QString &requestId)
     }
 }
 
+void ServicePrivate::buildIdentityIndex(const QString &cachePath)
+{
+    m_identityDirs.clear();
+    m_missingIdentities.clear();
+
+    QDir cacheDir(cachePath);
+    QStringList names = cacheDir.entryList(QStringList() << "id-*",
+                                           QDir::Dirs | QDir::NoDotAndDotDot);
+    Q_FOREACH(const QString &name, names) {
+        quint32 id;
+        if (Q_UNLIKELY(!CacheManager::identityFromDirName(name, id))) continue;
+        m_identityDirs[id].append(cacheDir.filePath(name));
+    }
+
+    if (cachePath != m_indexedCachePath) {
+        if (!m_cacheDirWatcher.directories().isEmpty()) {
+            m_cacheDirWatcher.removePaths(m_cacheDirWatcher.directories());
+        }
+        m_indexedCachePath = cachePath;
+    }
+    if (m_cacheDirWatcher.directories().isEmpty() && cacheDir.exists()) {
+        m_cacheDirWatcher.addPath(cachePath);
+    }
+    /* Unless the directory is being watched, we won't know when the index
+     * becomes stale */
+    m_identityIndexIsValid = !m_cacheDirWatcher.directories().isEmpty();
+}
+
+void ServicePrivate::onCacheDirChanged()
+{
+    /* Directories have been added or removed: the index will be rebuilt on
+     * the next lookup */
+    m_identityIndexIsValid = false;
+
+    /* New data might have been written: check the cache size */
+    m_cacheManager.scheduleCollection();
+}
+
 QString ServicePrivate::rootDirForIdentity(quint32 id)
 {
     /* the BrowserRequest class instructs the webview to store its cookies and
@@ -164,16 +172,46 @@ QString ServicePrivate::rootDirForIdentity(quint32 id)
      * we were not appending the "-<provider-id>" suffix. Besides, unless we
      * look up into the accounts DB, we don't know the value for the provider
      * ID.
-     * Because of both of these reasons, we list all the directories whose name
-     * starts with "id-<signon-id>" and pick the most recent one.
+     * Because of both of these reasons, we look for all the directories whose
+     * name starts with "id-<signon-id>" and pick the most recent one.
+     * In order not to list the cache directory at every call, we keep an
+     * index of these directories, which is invalidated whenever the contents
+     * of the cache directory change.
      */
-    QString cachePath =
-        QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
-    QDir cacheDir(cachePath + QStringLiteral("/online-accounts-ui"));
-    QString nameFilter = QString("id-%1*").arg(id);
-    QStringList rootDirs = cacheDir.entryList(QStringList() << nameFilter,
-                                              QDir::Dirs, QDir::Time);
-    return rootDirs.count() > 0 ? cacheDir.filePath(rootDirs.at(0)) : QString();
+    QString cachePath = CacheManager::cachePath();
+
+    bool indexIsFresh = false;
+    if (!m_identityIndexIsValid || cachePath != m_indexedCachePath) {
+        buildIdentityIndex(cachePath);
+        indexIsFresh = true;
+    }
+
+    QStringList rootDirs = m_identityDirs.value(id);
+    if (rootDirs.isEmpty() && !indexIsFresh &&
+        !m_missingIdentities.contains(id)) {
+        /* The file system watcher might not have notified us yet about a
+         * newly created directory; check once, and then rely on the watcher */
+        buildIdentityIndex(cachePath);
+        rootDirs = m_identityDirs.value(id);
+    }
+
+    if (rootDirs.isEmpty()) {
+        m_missingIdentities.insert(id);
+        return QString();
+    }
+
+    QString rootDir = rootDirs.at(0);
+    if (rootDirs.count() > 1) {
+        QDateTime newest = QFileInfo(rootDir).lastModified();
+        for (int i = 1; i < rootDirs.count(); i++) {
+            QDateTime lastModified = QFileInfo(rootDirs.at(i)).lastModified();
+            if (lastModified > newest) {
+                newest = lastModified;
+                rootDir = rootDirs.at(i);
+            }
+        }
+    }
+    return rootDir;
 }
 
 void ServicePrivate::removeIdentityData(quint32 id)
@@ -181,34 +219,60 @@ void ServicePrivate::removeIdentityData(quint32 id)
     /* Remove any data associated with the given identity. */
     QString rootDirName = rootDirForIdentity(id);
     if (rootDirName.isEmpty()) return;
-    QDir rootDir(rootDirName);
-    rootDir.removeRecursively();
+    m_cookieCache.remove(rootDirName + "/" + OAU_COOKIE_JAR_FILE);
+    m_cookieCache.remove(rootDirName + "/" + OAU_COOKIE_JSON_FILE);
+    m_identityIndexIsValid = false;
+    /* Webview profiles can be big: delete them in a background thread */
+    if (Q_UNLIKELY(!m_dataRemover.removeDirectory(rootDirName))) {
+        QDir rootDir(rootDirName);
+        rootDir.removeRecursively();
+    }
 }
 
-RawCookies ServicePrivate::cookiesForIdentity(quint32 id,
-                                              qint64 &timestamp) const
+RawCookies ServicePrivate::cookiesForIdentity(quint32 id, qint64 &timestamp)
 {
     RawCookies cookies;
 
-    QFileInfo fileInfo(rootDirForIdentity(id) + "/cookies.json");
-    if (!fileInfo.exists()) {
-        DEBUG() << "File does not exist:" << fileInfo.filePath();
+    QString rootDir = rootDirForIdentity(id);
+    if (rootDir.isEmpty()) {
+        DEBUG() << "No data directory for identity" << id;
         return cookies;
     }
-    timestamp = fileInfo.lastModified().toMSecsSinceEpoch() / 1000;
 
-    QFile file(fileInfo.filePath());
-    if (Q_UNLIKELY(!file.open(QIODevice::ReadOnly | QIODevice::Text))) {
-        qWarning() << "Cannot open file" << fileInfo.filePath();
+    /* Prefer the binary jar; the JSON file is only found in directories
+     * written by older versions */
+    QFileInfo fileInfo(rootDir + "/" + OAU_COOKIE_JAR_FILE);
+    bool isJar = fileInfo.exists();
+    if (!isJar) {
+        fileInfo.setFile(rootDir + "/" + OAU_COOKIE_JSON_FILE);
+    }
+    if (!fileInfo.exists()) {
+        DEBUG() << "File does not exist:" << fileInfo.filePath();
+        m_cookieCache.remove(fileInfo.filePath());
         return cookies;
     }
+    QDateTime lastModified = fileInfo.lastModified();
+    timestamp = lastModified.toMSecsSinceEpoch() / 1000;
+
+    /* Don't parse the file again if it didn't change */
+    QHash<QString,CachedCookies>::const_iterator i =
+        m_cookieCache.constFind(fileInfo.filePath());
+    if (i != m_cookieCache.constEnd() &&
+        i.value().lastModified == lastModified &&
+        i.value().size == fileInfo.size()) {
+        return i.value().cookies;
+    }
 
-    QByteArray contents = file.readAll();
-    QJsonDocument doc = QJsonDocument::fromJson(contents);
-    if (doc.isEmpty() || !doc.isArray()) return cookies;
+    bool ok = isJar ?
+        readCookieJar(fileInfo.filePath(), cookies) :
+        readJsonCookies(fileInfo.filePath(), cookies);
+    if (Q_UNLIKELY(!ok)) return cookies;
 
-    QVariantList cookieVariants = doc.array().toVariantList();
-    return cookiesFromVariant(cookieVariants);
+    CachedCookies &cached = m_cookieCache[fileInfo.filePath()];
+    cached.lastModified = lastModified;
+    cached.size = fileInfo.size();
+    cached.cookies = cookies;
+    return cookies;
 }
 
 Service::Service(QObject *parent):
@@ -243,10 +307,27 @@ QVariantMap Service::queryDialog(const QVariantMap &parameters)
 QVariantMap Service::refreshDialog(const QVariantMap &newParameters)
 {
     QVariantMap cleanParameters = expandDBusArguments(newParameters);
-    // TODO find the request and update it
+    DEBUG() << "Got refresh:" << cleanParameters;
+
+    QString requestId = cleanParameters.value(SSOUI_KEY_REQUESTID).toString();
+    OnlineAccountsUi::Request *request = 0;
+    if (!requestId.isEmpty()) {
+        QVariantMap match;
+        match.insert(SSOUI_KEY_REQUESTID, requestId);
+        request = OnlineAccountsUi::Request::find(match);
+    }
 
-    /* The following line tells QtDBus not to generate a reply now */
+    if (Q_UNLIKELY(request == 0)) {
+        qWarning() << "Cannot refresh unknown request" << requestId;
+        QVariantMap result;
+        result[SSOUI_KEY_ERROR] = SignOn::QUERY_ERROR_REFRESH_FAILED;
+        return result;
+    }
+
+    /* The request keeps running in the same UI process; the reply will be
+     * sent when it completes. */
     setDelayedReply(true);
+    request->refresh(message(), cleanParameters);
     return QVariantMap();
 }
 
@@ -262,6 +343,24 @@ void Service::removeIdentityData(quint32 id)
     d->removeIdentityData(id);
 }
 
+CacheManager *Service::cacheManager()
+{
+    Q_D(Service);
+    return &d->m_cacheManager;
+}
+
+qulonglong Service::cacheUsage() const
+{
+    Q_D(const Service);
+    return d->m_cacheManager.usage();
+}
+
+DataRemover *Service::dataRemover()
+{
+    Q_D(Service);
+    return &d->m_dataRemover;
+}
+
 void Service::cookiesForIdentity(quint32 id,
                                  RawCookies &cookies, qint64 &timestamp)
 {
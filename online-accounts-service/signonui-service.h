@@ -31,17 +31,28 @@ namespace SignOnUi {
 
 typedef QList<QByteArray> RawCookies;
 
+class CacheManager;
+class DataRemover;
 class ServicePrivate;
 
 class Service: public QObject, protected QDBusContext
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "com.nokia.singlesignonui")
+    /* Size in bytes of the webview data, as of the last garbage collection;
+     * like cookiesForIdentity(), this is Ubuntu-specific. */
+    Q_PROPERTY(qulonglong CacheUsage READ cacheUsage)
 
 public:
     explicit Service(QObject *parent = 0);
     ~Service();
 
+    CacheManager *cacheManager();
+    qulonglong cacheUsage() const;
+
+    /* Its "isIdle" property tells whether data removals are pending */
+    DataRemover *dataRemover();
+
 public Q_SLOTS:
     QVariantMap queryDialog(const QVariantMap &parameters);
     QVariantMap refreshDialog(const QVariantMap &newParameters);
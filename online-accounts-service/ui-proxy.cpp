@@ -21,6 +21,7 @@
 #include "debug.h"
 #include "ipc.h"
 #include "mir-helper.h"
+#include "render-stats.h"
 #include "request.h"
 #include "ui-proxy.h"
 
@@ -63,12 +64,14 @@ public:
     bool setupPromptSession();
     QString findAppArmorProfile();
     void startProcess();
+    void addTimings(const QVariantMap &operation, Request *request);
 
 private Q_SLOTS:
     void onNewConnection();
     void onDisconnected();
     void onDataReady(QByteArray &data);
     void onRequestCompleted();
+    void onRequestRefreshed(const QVariantMap &parameters);
     void onFinishedTimer();
 
 private:
@@ -175,6 +178,20 @@ void UiProxyPrivate::onNewConnection()
     }
 }
 
+void UiProxyPrivate::addTimings(const QVariantMap &operation,
+                                Request *request)
+{
+    if (!operation.contains(OAU_OPERATION_TIMINGS)) return;
+
+    QString providerId = operation.value(OAU_OPERATION_PROVIDER).toString();
+    if (providerId.isEmpty()) {
+        providerId = request->providerId();
+    }
+    RenderStats::instance()->addTimings(providerId,
+        operation.value(OAU_OPERATION_REQUEST_TYPE).toString(),
+        operation.value(OAU_OPERATION_TIMINGS).toMap());
+}
+
 void UiProxyPrivate::onDataReady(QByteArray &data)
 {
     QVariantMap map;
@@ -189,10 +206,12 @@ void UiProxyPrivate::onDataReady(QByteArray &data)
     QString code = map.value(OAU_OPERATION_CODE).toString();
     if (code == OAU_OPERATION_CODE_REQUEST_FINISHED) {
         Q_ASSERT(request);
+        addTimings(map, request);
         request->setDelay(map.value(OAU_OPERATION_DELAY).toInt());
         request->setResult(map.value(OAU_OPERATION_DATA).toMap());
     } else if (code == OAU_OPERATION_CODE_REQUEST_FAILED) {
         Q_ASSERT(request);
+        addTimings(map, request);
         request->fail(map.value(OAU_OPERATION_ERROR_NAME).toString(),
                       map.value(OAU_OPERATION_ERROR_MESSAGE).toString());
     } else if (code == OAU_OPERATION_CODE_REGISTER_HANDLER) {
@@ -367,6 +386,24 @@ void UiProxyPrivate::onRequestCompleted()
     }
 }
 
+void UiProxyPrivate::onRequestRefreshed(const QVariantMap &parameters)
+{
+    Request *request = qobject_cast<Request*>(sender());
+    Q_ASSERT(request);
+
+    /* If the UI process is not connected yet, the request will be sent
+     * along with the updated parameters */
+    int id = m_requests.key(request, -1);
+    if (id == -1 || m_status != UiProxy::Ready) return;
+
+    QVariantMap operation;
+    operation.insert(OAU_OPERATION_CODE, OAU_OPERATION_CODE_REFRESH);
+    operation.insert(OAU_OPERATION_ID, id);
+    operation.insert(OAU_OPERATION_DATA, parameters);
+    operation.insert(OAU_OPERATION_INTERFACE, request->interface());
+    sendOperation(operation);
+}
+
 UiProxy::UiProxy(pid_t clientPid, QObject *parent):
     QObject(parent),
     d_ptr(new UiProxyPrivate(clientPid, this))
@@ -401,6 +438,8 @@ void UiProxy::handleRequest(Request *request)
     d->m_requests.insert(requestId, request);
     QObject::connect(request, SIGNAL(completed()),
                      d, SLOT(onRequestCompleted()));
+    QObject::connect(request, SIGNAL(refreshed(const QVariantMap&)),
+                     d, SLOT(onRequestRefreshed(const QVariantMap&)));
     request->setInProgress(true);
 
     if (d->m_status == UiProxy::Ready) {
@@ -21,14 +21,113 @@
 #include "debug.h"
 #include "utils.h"
 
+#include <QDBusArgument>
 #include <QDBusConnection>
 #include <QDBusError>
 #include <QDBusMessage>
 #include <QDBusReply>
+#include <QDBusVariant>
+#include <QStringList>
 #include <sys/apparmor.h>
 
 namespace OnlineAccountsUi {
 
+static QVariant expandValue(const QVariant &value);
+
+static QVariant dbusArgumentToVariant(const QDBusArgument &argument)
+{
+    /* The argument is read in a single pass: containers are walked with the
+     * begin*()/end*() methods and their elements converted recursively. */
+    switch (argument.currentType()) {
+    case QDBusArgument::BasicType:
+        return argument.asVariant();
+    case QDBusArgument::VariantType:
+        {
+            QDBusVariant dbusVariant;
+            argument >> dbusVariant;
+            return expandValue(dbusVariant.variant());
+        }
+    case QDBusArgument::ArrayType:
+        {
+            QString signature = argument.currentSignature();
+            if (signature == QStringLiteral("ay")) {
+                QByteArray bytes;
+                argument >> bytes;
+                return bytes;
+            } else if (signature == QStringLiteral("as")) {
+                QStringList strings;
+                argument >> strings;
+                return strings;
+            }
+
+            QVariantList list;
+            argument.beginArray();
+            while (!argument.atEnd()) {
+                list.append(dbusArgumentToVariant(argument));
+            }
+            argument.endArray();
+            return list;
+        }
+    case QDBusArgument::MapType:
+        {
+            QVariantMap map;
+            argument.beginMap();
+            while (!argument.atEnd()) {
+                argument.beginMapEntry();
+                QVariant key = dbusArgumentToVariant(argument);
+                QVariant value = dbusArgumentToVariant(argument);
+                argument.endMapEntry();
+                map.insert(key.toString(), value);
+            }
+            argument.endMap();
+            return map;
+        }
+    case QDBusArgument::StructureType:
+        {
+            QVariantList fields;
+            argument.beginStructure();
+            while (!argument.atEnd()) {
+                fields.append(dbusArgumentToVariant(argument));
+            }
+            argument.endStructure();
+            return fields;
+        }
+    default:
+        qWarning() << "Unsupported D-Bus type" << argument.currentSignature();
+        return QVariant();
+    }
+}
+
+static QVariant expandValue(const QVariant &value)
+{
+    int type = value.userType();
+    if (type == qMetaTypeId<QDBusArgument>()) {
+        return dbusArgumentToVariant(value.value<QDBusArgument>());
+    } else if (type == qMetaTypeId<QDBusVariant>()) {
+        return expandValue(value.value<QDBusVariant>().variant());
+    } else if (type == QMetaType::QVariantMap) {
+        return expandDBusArguments(value.toMap());
+    } else if (type == QMetaType::QVariantList) {
+        QVariantList list = value.toList();
+        for (int i = 0; i < list.count(); i++) {
+            list[i] = expandValue(list.at(i));
+        }
+        return list;
+    }
+    return value;
+}
+
+QVariantMap expandDBusArguments(const QVariantMap &dbusMap)
+{
+    QVariantMap map;
+    QMapIterator<QString, QVariant> it(dbusMap);
+    while (it.hasNext()) {
+        it.next();
+        map.insert(it.key(), expandValue(it.value()));
+    }
+    return map;
+}
+
 QString apparmorProfileOfPeer(const QDBusMessage &message)
 {
     static QString ourProfile;
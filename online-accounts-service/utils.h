@@ -22,6 +22,7 @@
 #define OAU_UTILS_H
 
 #include <QString>
+#include <QVariantMap>
 
 class QDBusMessage;
 
@@ -29,6 +30,10 @@ namespace OnlineAccountsUi {
 
 QString apparmorProfileOfPeer(const QDBusMessage &message);
 
+/* Converts all the QDBusArgument values found in the map, at any nesting
+ * level, into native Qt types (maps, lists and basic types) */
+QVariantMap expandDBusArguments(const QVariantMap &dbusMap);
+
 } // namespace
 
 #endif // OAU_UTILS_H
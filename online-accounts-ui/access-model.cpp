@@ -25,13 +25,18 @@
 #include <Accounts/Application>
 #include <Accounts/Service>
 #include <OnlineAccountsPlugin/account-manager.h>
+#include <QHash>
 
 using namespace OnlineAccountsUi;
 
 namespace OnlineAccountsUi {
 
-class AccessModelPrivate
+/* The enabled state of the supported services is tracked in a bitmask */
+#define MAX_SUPPORTED_SERVICES 64
+
+class AccessModelPrivate: public QObject
 {
+    Q_OBJECT
     Q_DECLARE_PUBLIC(AccessModel)
 
 public:
@@ -39,10 +44,24 @@ public:
     inline ~AccessModelPrivate();
 
     void ensureSupportedServices() const;
+    void clearSupportedServices();
+    void clearAccounts() const;
+    Accounts::Account *account(int sourceRow) const;
+    bool allServicesEnabled(Accounts::Account *account) const;
+
+private Q_SLOTS:
+    void onEnabledChanged(const QString &serviceName, bool enabled);
+    void onAccountDestroyed(QObject *account);
 
 private:
     mutable AccessModel *q_ptr;
     mutable Accounts::ServiceList m_supportedServices;
+    /* Position of each supported service in the masks */
+    mutable QHash<QString,int> m_serviceBits;
+    mutable quint64 m_allServicesMask;
+    /* The supported services which are enabled, for each account */
+    mutable QHash<QObject*,quint64> m_enabledServices;
+    mutable int m_accountHandleRole;
     QString m_lastItemText;
     QString m_applicationId;
 };
@@ -50,7 +69,10 @@ private:
 } // namespace
 
 AccessModelPrivate::AccessModelPrivate(AccessModel *accessModel):
-    q_ptr(accessModel)
+    QObject(accessModel),
+    q_ptr(accessModel),
+    m_allServicesMask(0),
+    m_accountHandleRole(-1)
 {
 }
 
@@ -74,14 +96,131 @@ void AccessModelPrivate::ensureSupportedServices() const
     if (providerId.isEmpty()) return;
 
     AccountManager *manager = AccountManager::instance();
-    Accounts::Application application = manager->application(m_applicationId);
-    Accounts::ServiceList allServices = manager->serviceList();
-    Q_FOREACH(const Accounts::Service &service, allServices) {
-        if (service.provider() == providerId &&
-            !application.serviceUsage(service).isEmpty()) {
+    Q_FOREACH(const Accounts::Service &service,
+              manager->servicesForApplication(m_applicationId)) {
+        if (service.provider() == providerId) {
             m_supportedServices.append(service);
         }
     }
+
+    if (m_supportedServices.isEmpty()) return;
+
+    /* Any masks computed so far are meaningless */
+    clearAccounts();
+
+    if (Q_UNLIKELY(m_supportedServices.count() > MAX_SUPPORTED_SERVICES)) {
+        /* The services don't fit in the mask: allServicesEnabled() will
+         * check them one by one */
+        DEBUG() << "Too many services for" << m_applicationId;
+        return;
+    }
+
+    int count = m_supportedServices.count();
+    for (int i = 0; i < count; i++) {
+        m_serviceBits.insert(m_supportedServices[i].name(), i);
+    }
+    m_allServicesMask = (count == MAX_SUPPORTED_SERVICES) ?
+        ~Q_UINT64_C(0) : (Q_UINT64_C(1) << count) - 1;
+}
+
+void AccessModelPrivate::clearSupportedServices()
+{
+    m_supportedServices.clear();
+    m_serviceBits.clear();
+    m_allServicesMask = 0;
+    clearAccounts();
+}
+
+void AccessModelPrivate::clearAccounts() const
+{
+    Q_FOREACH(QObject *account, m_enabledServices.keys()) {
+        QObject::disconnect(account, 0, this, 0);
+    }
+    m_enabledServices.clear();
+}
+
+Accounts::Account *AccessModelPrivate::account(int sourceRow) const
+{
+    Q_Q(const AccessModel);
+
+    QAbstractItemModel *accountModel = q->sourceModel();
+    if (Q_UNLIKELY(!accountModel)) return 0;
+
+    if (m_accountHandleRole < 0) {
+        m_accountHandleRole =
+            accountModel->roleNames().key("accountHandle", -1);
+        if (Q_UNLIKELY(m_accountHandleRole < 0)) return 0;
+    }
+
+    QVariant result = accountModel->data(accountModel->index(sourceRow, 0),
+                                         m_accountHandleRole);
+    return qobject_cast<Accounts::Account*>(result.value<QObject*>());
+}
+
+bool AccessModelPrivate::allServicesEnabled(Accounts::Account *account) const
+{
+    if (Q_UNLIKELY(m_supportedServices.count() > MAX_SUPPORTED_SERVICES)) {
+        Accounts::Service selectedService = account->selectedService();
+        bool allEnabled = true;
+        Q_FOREACH(const Accounts::Service &service, m_supportedServices) {
+            account->selectService(service);
+            if (!account->isEnabled()) {
+                allEnabled = false;
+                break;
+            }
+        }
+        account->selectService(selectedService);
+        return allEnabled;
+    }
+
+    QHash<QObject*,quint64>::const_iterator i =
+        m_enabledServices.constFind(account);
+    if (i == m_enabledServices.constEnd()) {
+        /* First time we see this account: compute its mask, and keep it
+         * updated from now on */
+        quint64 mask = 0;
+        Q_FOREACH(const Accounts::Service &service,
+                  account->enabledServices()) {
+            int bit = m_serviceBits.value(service.name(), -1);
+            if (bit >= 0) mask |= Q_UINT64_C(1) << bit;
+        }
+        QObject::connect(account,
+                         SIGNAL(enabledChanged(const QString&,bool)),
+                         this, SLOT(onEnabledChanged(const QString&,bool)));
+        QObject::connect(account, SIGNAL(destroyed(QObject*)),
+                         this, SLOT(onAccountDestroyed(QObject*)));
+        i = m_enabledServices.insert(account, mask);
+    }
+
+    return i.value() == m_allServicesMask;
+}
+
+void AccessModelPrivate::onEnabledChanged(const QString &serviceName,
+                                          bool enabled)
+{
+    Q_Q(AccessModel);
+
+    int bit = m_serviceBits.value(serviceName, -1);
+    if (bit < 0) return;
+
+    QHash<QObject*,quint64>::iterator i = m_enabledServices.find(sender());
+    if (Q_UNLIKELY(i == m_enabledServices.end())) return;
+
+    bool wasAllEnabled = (i.value() == m_allServicesMask);
+    if (enabled) {
+        i.value() |= Q_UINT64_C(1) << bit;
+    } else {
+        i.value() &= ~(Q_UINT64_C(1) << bit);
+    }
+
+    if ((i.value() == m_allServicesMask) != wasAllEnabled) {
+        q->invalidateFilter();
+    }
+}
+
+void AccessModelPrivate::onAccountDestroyed(QObject *account)
+{
+    m_enabledServices.remove(account);
 }
 
 AccessModel::AccessModel(QObject *parent):
@@ -101,6 +240,10 @@ AccessModel::~AccessModel()
 
 void AccessModel::setAccountModel(QAbstractItemModel *accountModel)
 {
+    Q_D(AccessModel);
+
+    d->m_accountHandleRole = -1;
+    d->clearAccounts();
     setSourceModel(accountModel);
     Q_EMIT accountModelChanged();
 }
@@ -118,7 +261,7 @@ void AccessModel::setApplicationId(const QString &applicationId)
     d->m_applicationId = applicationId;
     Q_EMIT applicationIdChanged();
 
-    d->m_supportedServices.clear();
+    d->clearSupportedServices();
     /* Trigger a refresh of the filtered model */
     invalidateFilter();
 }
@@ -147,28 +290,12 @@ bool AccessModel::filterAcceptsRow(int sourceRow,
     /* We must avoid showing those accounts which have already been enabled for
      * this application. */
     d->ensureSupportedServices();
-    QVariant result;
-    bool ok = QMetaObject::invokeMethod(sourceModel(), "get",
-                                        Qt::DirectConnection,
-                                        Q_RETURN_ARG(QVariant, result),
-                                        Q_ARG(int, sourceRow),
-                                        Q_ARG(QString, "accountHandle"));
-    if (Q_UNLIKELY(!ok)) return false;
-
-    QObject *accountHandle = result.value<QObject*>();
-    Accounts::Account *account =
-        qobject_cast<Accounts::Account*>(accountHandle);
+    Accounts::Account *account = d->account(sourceRow);
     if (Q_UNLIKELY(!account)) return false;
 
-    bool allServicesEnabled = true;
-    Q_FOREACH(const Accounts::Service &service, d->m_supportedServices) {
-        account->selectService(service);
-        if (!account->isEnabled()) {
-            allServicesEnabled = false;
-            break;
-        }
-    }
-
+    bool allServicesEnabled = d->allServicesEnabled(account);
     DEBUG() << account->id() << "allServicesEnabled" << allServicesEnabled;
     return !allServicesEnabled;
 }
+
+#include "access-model.moc"
@@ -20,20 +20,22 @@
 
 #include "browser-request.h"
 
+#include "cookie-jar.h"
 #include "debug.h"
 #include "dialog.h"
 #include "globals.h"
 #include "i18n.h"
+#include "load-time-tracker.h"
+#include "redirect-matcher.h"
 
 #include <OnlineAccountsPlugin/request-handler.h>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QJsonArray>
-#include <QJsonDocument>
 #include <QList>
+#include <QPointer>
 #include <QQmlContext>
 #include <QQmlEngine>
-#include <QRegularExpression>
 #include <QStandardPaths>
 #include <QTimer>
 #include <QVariant>
@@ -42,10 +44,13 @@
 
 using namespace SignOnUi;
 
-#ifndef SIGNONUI_FAIL_TIMEOUT
-#define SIGNONUI_FAIL_TIMEOUT 3000
+/* How many times a failed page is reloaded before giving up */
+#ifndef SIGNONUI_MAX_LOAD_RETRIES
+#define SIGNONUI_MAX_LOAD_RETRIES 2
 #endif
 
+static QPointer<Dialog> preWarmedDialog;
+
 namespace SignOnUi {
 
 class BrowserRequestPrivate: public QObject
@@ -55,15 +60,19 @@ class BrowserRequestPrivate: public QObject
     Q_PROPERTY(QString title READ title CONSTANT)
     Q_PROPERTY(QUrl pageComponentUrl READ pageComponentUrl CONSTANT)
     Q_PROPERTY(QUrl currentUrl READ currentUrl WRITE setCurrentUrl)
-    Q_PROPERTY(QUrl startUrl READ startUrl CONSTANT)
-    Q_PROPERTY(QUrl finalUrl READ finalUrl CONSTANT)
+    Q_PROPERTY(QUrl startUrl READ startUrl NOTIFY startUrlChanged)
+    Q_PROPERTY(QUrl finalUrl READ finalUrl NOTIFY finalUrlChanged)
     Q_PROPERTY(QString rootDir READ rootDir CONSTANT)
+    Q_PROPERTY(int failTimeout READ failTimeout NOTIFY loadTimesChanged)
+    Q_PROPERTY(int averageLoadTime READ averageLoadTime
+               NOTIFY loadTimesChanged)
 
 public:
     BrowserRequestPrivate(BrowserRequest *request);
     ~BrowserRequestPrivate();
 
     void start();
+    void refresh(const QVariantMap &parameters);
 
     QString title() const { return q_ptr->windowTitle(); }
     void setCurrentUrl(const QUrl &url);
@@ -73,6 +82,8 @@ public:
     QUrl finalUrl() const { return m_finalUrl; }
     QUrl responseUrl() const { return m_responseUrl; }
     QString rootDir() const { return m_rootDir; }
+    int failTimeout() const { return m_loadTimes.failTimeout(); }
+    int averageLoadTime() const { return m_loadTimes.averageLoadTime(); }
 
     QString rootDirForIdentity() const;
 
@@ -88,15 +99,24 @@ private Q_SLOTS:
 
 Q_SIGNALS:
     void authenticated();
+    void startUrlChanged();
+    void finalUrlChanged();
+    void loadTimesChanged();
+    void reloadRequested();
 
 private:
     void buildDialog(const QVariantMap &params);
+    QString dialogTitle(const QVariantMap &params) const;
     void closeView();
-    bool pathsAreEqual(const QString &p1, const QString &p2);
 
 private:
     Dialog *m_dialog;
-    QRegularExpression m_pathRegExp;
+    bool m_dialogIsPreWarmed;
+    QElapsedTimer m_loadTimer;
+    RedirectMatcher m_redirectMatcher;
+    LoadTimeTracker m_loadTimes;
+    QElapsedTimer m_pageLoadTimer;
+    int m_retryCount;
     QUrl m_currentUrl;
     QUrl m_startUrl;
     QUrl m_finalUrl;
@@ -111,11 +131,11 @@ private:
 BrowserRequestPrivate::BrowserRequestPrivate(BrowserRequest *request):
     QObject(request),
     m_dialog(0),
-    m_pathRegExp("/*^"),
+    m_dialogIsPreWarmed(false),
+    m_retryCount(0),
     q_ptr(request)
 {
     m_failTimer.setSingleShot(true);
-    m_failTimer.setInterval(SIGNONUI_FAIL_TIMEOUT);
     QObject::connect(&m_failTimer, SIGNAL(timeout()),
                      this, SLOT(onFailTimer()));
 }
@@ -127,13 +147,6 @@ BrowserRequestPrivate::~BrowserRequestPrivate()
     delete m_dialog;
 }
 
-bool BrowserRequestPrivate::pathsAreEqual(const QString &p1, const QString &p2)
-{
-    QString p1copy(p1);
-    QString p2copy(p2);
-    return p1copy.remove(m_pathRegExp) == p2copy.remove(m_pathRegExp);
-}
-
 QString BrowserRequestPrivate::rootDirForIdentity() const
 {
     Q_Q(const BrowserRequest);
@@ -154,24 +167,61 @@ void BrowserRequestPrivate::start()
         rootDir.mkpath(".");
     }
 
-    m_finalUrl = params.value(SSOUI_KEY_FINALURL).toString();
+    m_redirectMatcher.setFinalUrls(params.value(SSOUI_KEY_FINALURL));
+    m_finalUrl = m_redirectMatcher.firstFinalUrl();
     m_startUrl = params.value(SSOUI_KEY_OPENURL).toString();
+    m_loadTimes.setHost(m_startUrl.host());
+    Q_EMIT loadTimesChanged();
     m_rootDir = rootDir.absolutePath();
     if (!q->hasHandler()) {
+        m_loadTimer.start();
         buildDialog(params);
 
         QObject::connect(m_dialog, SIGNAL(finished(int)),
                          this, SLOT(onFinished()));
 
-        m_dialog->engine()->addImportPath(PLUGIN_PRIVATE_MODULE_DIR);
-        m_dialog->rootContext()->setContextProperty("request", this);
-        m_dialog->setSource(QUrl("qrc:/qml/SignOnUiPage.qml"));
+        /* A pre-warmed dialog is already loaded: setting the request will
+         * make it set the data directory and load the start URL */
+        m_dialog->viewContext()->setContextProperty("request", this);
+        if (!m_dialogIsPreWarmed) {
+            m_dialog->engine()->addImportPath(PLUGIN_PRIVATE_MODULE_DIR);
+            m_dialog->load(QUrl("qrc:/qml/SignOnUiPage.qml"));
+        }
     } else {
         DEBUG() << "Setting request on handler";
         q->handler()->setRequest(this);
     }
 }
 
+void BrowserRequestPrivate::refresh(const QVariantMap &parameters)
+{
+    Q_Q(BrowserRequest);
+
+    DEBUG() << parameters;
+
+    /* Keep the same window and web engine, so that the page state and the
+     * cookies are preserved */
+    if (parameters.contains(SSOUI_KEY_FINALURL)) {
+        m_redirectMatcher.setFinalUrls(parameters.value(SSOUI_KEY_FINALURL));
+        m_finalUrl = m_redirectMatcher.firstFinalUrl();
+        Q_EMIT finalUrlChanged();
+    }
+
+    if (parameters.contains(SSOUI_KEY_OPENURL)) {
+        m_startUrl = parameters.value(SSOUI_KEY_OPENURL).toString();
+        m_responseUrl = QUrl();
+        Q_EMIT startUrlChanged();
+        if (m_startUrl.host() != m_loadTimes.host()) {
+            m_loadTimes.setHost(m_startUrl.host());
+            Q_EMIT loadTimesChanged();
+        }
+    }
+
+    if (m_dialog) {
+        m_dialog->setTitle(dialogTitle(q->parameters()));
+    }
+}
+
 QUrl BrowserRequestPrivate::pageComponentUrl() const
 {
     Q_Q(const BrowserRequest);
@@ -198,8 +248,7 @@ void BrowserRequestPrivate::setCurrentUrl(const QUrl &url)
     }
 
     m_currentUrl = url;
-    if (url.host() == m_finalUrl.host() &&
-        pathsAreEqual(url.path(), m_finalUrl.path())) {
+    if (m_redirectMatcher.matches(url)) {
         m_responseUrl = url;
         if (m_dialog != 0) {
             if (!m_dialog->isVisible()) {
@@ -221,15 +270,14 @@ void BrowserRequestPrivate::setCookies(const QVariant &cookies)
 {
     DEBUG() << cookies;
 
-    QJsonArray jsonCookies =
-        QJsonArray::fromVariantList(cookies.toList());
-
-    /* Save the cookies into a text file */
-    QFile file(m_rootDir + "/cookies.json");
-    if (Q_LIKELY(file.open(QIODevice::WriteOnly | QIODevice::Text))) {
-        QJsonDocument doc(jsonCookies);
-        file.write(doc.toJson());
-        file.close();
+    /* Save the cookies into the binary jar; once that succeeded, the JSON
+     * file left by older versions is no longer needed. If writing failed,
+     * keep it as a fallback. */
+    QString jarFileName = m_rootDir + "/" + OAU_COOKIE_JAR_FILE;
+    if (writeCookieJar(jarFileName, cookiesFromVariant(cookies.toList()))) {
+        QFile::remove(m_rootDir + "/" + OAU_COOKIE_JSON_FILE);
+    } else {
+        qWarning() << "Could not save cookies to" << jarFileName;
     }
 
     onFinished();
@@ -247,6 +295,7 @@ void BrowserRequestPrivate::cancel()
 void BrowserRequestPrivate::onLoadStarted()
 {
     m_failTimer.stop();
+    m_pageLoadTimer.start();
 }
 
 void BrowserRequestPrivate::onLoadFinished(bool ok)
@@ -255,11 +304,26 @@ void BrowserRequestPrivate::onLoadFinished(bool ok)
 
     DEBUG() << "Load finished" << ok;
 
+    if (m_loadTimer.isValid()) {
+        q->setContentLoaded();
+        DEBUG() << "First page loaded after" << m_loadTimer.elapsed() <<
+            "ms" << (m_dialogIsPreWarmed ? "(pre-warmed)" : "(cold)");
+        m_loadTimer.invalidate();
+    }
+
     if (!ok) {
-        m_failTimer.start();
+        m_pageLoadTimer.invalidate();
+        m_failTimer.start(m_loadTimes.failTimeout());
         return;
     }
 
+    if (m_pageLoadTimer.isValid()) {
+        m_loadTimes.addSample(m_pageLoadTimer.elapsed());
+        m_pageLoadTimer.invalidate();
+        Q_EMIT loadTimesChanged();
+    }
+    m_retryCount = 0;
+
     if (m_dialog && !m_dialog->isVisible()) {
         if (m_responseUrl.isEmpty()) {
             q->setWindow(m_dialog);
@@ -273,6 +337,16 @@ void BrowserRequestPrivate::onFailTimer()
 {
     Q_Q(BrowserRequest);
 
+    /* The failure might be transient: try again in the same view, which
+     * keeps the state of the authentication */
+    if (m_retryCount < SIGNONUI_MAX_LOAD_RETRIES) {
+        m_retryCount++;
+        DEBUG() << "Page loading failed, retry" << m_retryCount;
+        Q_EMIT reloadRequested();
+        m_failTimer.start(m_loadTimes.failTimeout());
+        return;
+    }
+
     DEBUG() << "Page loading failed";
     closeView();
     QVariantMap result;
@@ -297,10 +371,8 @@ void BrowserRequestPrivate::onFinished()
     q->setResult(reply);
 }
 
-void BrowserRequestPrivate::buildDialog(const QVariantMap &params)
+QString BrowserRequestPrivate::dialogTitle(const QVariantMap &params) const
 {
-    m_dialog = new Dialog;
-
     QString title;
     if (params.contains(SSOUI_KEY_TITLE)) {
         title = params[SSOUI_KEY_TITLE].toString();
@@ -312,8 +384,19 @@ void BrowserRequestPrivate::buildDialog(const QVariantMap &params)
         title = OnlineAccountsUi::_("Web authentication",
                                     SIGNONUI_I18N_DOMAIN);
     }
+    return title;
+}
 
-    m_dialog->setTitle(title);
+void BrowserRequestPrivate::buildDialog(const QVariantMap &params)
+{
+    if (preWarmedDialog) {
+        m_dialog = preWarmedDialog.data();
+        m_dialogIsPreWarmed = true;
+        preWarmedDialog.clear();
+    } else {
+        m_dialog = new Dialog;
+    }
+    m_dialog->setTitle(dialogTitle(params));
 
     DEBUG() << "Dialog was built";
 }
@@ -344,6 +427,19 @@ BrowserRequest::~BrowserRequest()
     delete d_ptr;
 }
 
+void BrowserRequest::preWarm()
+{
+    if (preWarmedDialog) return;
+
+    DEBUG() << "Pre-warming browser dialog";
+    Dialog *dialog = new Dialog;
+    dialog->engine()->addImportPath(PLUGIN_PRIVATE_MODULE_DIR);
+    dialog->viewContext()->setContextProperty("request",
+                                              QVariant::fromValue<QObject*>(0));
+    dialog->load(QUrl("qrc:/qml/SignOnUiPage.qml"));
+    preWarmedDialog = dialog;
+}
+
 void BrowserRequest::start()
 {
     Q_D(BrowserRequest);
@@ -352,4 +448,12 @@ void BrowserRequest::start()
     d->start();
 }
 
+void BrowserRequest::refresh(const QVariantMap &parameters)
+{
+    Q_D(BrowserRequest);
+
+    Request::refresh(parameters);
+    d->refresh(parameters);
+}
+
 #include "browser-request.moc"
@@ -40,8 +40,14 @@ public:
                             QObject *parent = 0);
     ~BrowserRequest();
 
+    /* Builds a hidden browser dialog, which will be used by the next
+     * request; this moves the initialization of the web engine out of the
+     * authentication path. */
+    static void preWarm();
+
     // reimplemented virtual methods
     void start();
+    void refresh(const QVariantMap &parameters);
 
 private:
     BrowserRequestPrivate *d_ptr;
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "component-cache.h"
+
+#include "debug.h"
+
+#include <QHash>
+#include <QQmlComponent>
+#include <QQmlContext>
+#include <QQmlEngine>
+#include <QQuickView>
+
+using namespace OnlineAccountsUi;
+
+namespace OnlineAccountsUi {
+
+class ComponentCachePrivate
+{
+    Q_DECLARE_PUBLIC(ComponentCache)
+
+public:
+    ComponentCachePrivate(ComponentCache *q);
+
+private:
+    mutable ComponentCache *q_ptr;
+    QQmlEngine *m_engine;
+    QHash<QUrl,QQmlComponent*> m_components;
+};
+
+} // namespace
+
+ComponentCachePrivate::ComponentCachePrivate(ComponentCache *q):
+    q_ptr(q),
+    m_engine(new QQmlEngine(q))
+{
+}
+
+ComponentCache *ComponentCache::m_instance = 0;
+
+ComponentCache *ComponentCache::instance()
+{
+    if (!m_instance) {
+        m_instance = new ComponentCache;
+    }
+
+    return m_instance;
+}
+
+ComponentCache::ComponentCache(QObject *parent):
+    QObject(parent),
+    d_ptr(new ComponentCachePrivate(this))
+{
+}
+
+ComponentCache::~ComponentCache()
+{
+    Q_D(ComponentCache);
+    /* The components must go before their engine */
+    qDeleteAll(d->m_components);
+    delete d_ptr;
+}
+
+QQmlEngine *ComponentCache::engine() const
+{
+    Q_D(const ComponentCache);
+    return d->m_engine;
+}
+
+QQmlComponent *ComponentCache::component(const QUrl &url)
+{
+    Q_D(ComponentCache);
+
+    QQmlComponent *component = d->m_components.value(url);
+    if (component && component->isError()) {
+        /* Try again: the error might have been caused by a missing import
+         * path */
+        d->m_components.remove(url);
+        delete component;
+        component = 0;
+    }
+
+    if (!component) {
+        DEBUG() << "Compiling" << url;
+        component = new QQmlComponent(d->m_engine, url,
+                                      QQmlComponent::PreferSynchronous);
+        d->m_components.insert(url, component);
+    }
+    return component;
+}
+
+bool ComponentCache::setSource(QQuickView *view, const QUrl &url,
+                               QQmlContext *context)
+{
+    Q_D(ComponentCache);
+
+    QQmlComponent *component;
+    if (view->engine() == d->m_engine) {
+        component = this->component(url);
+        /* A QQuickView installs its incubation controller only if the
+         * engine has none when the view is created; when that view is
+         * destroyed, the engine is left without a controller, even if other
+         * views created in the meantime are still alive. In that case, let
+         * this view drive the incubation. */
+        if (!d->m_engine->incubationController()) {
+            d->m_engine->setIncubationController(view->incubationController());
+        }
+    } else {
+        component = new QQmlComponent(view->engine(), url,
+                                      QQmlComponent::PreferSynchronous, view);
+    }
+
+    if (Q_UNLIKELY(!component->isReady())) {
+        qWarning() << "Cannot load" << url << component->errors();
+        return false;
+    }
+
+    QObject *root = component->create(context);
+    if (Q_UNLIKELY(!root)) {
+        qWarning() << "Cannot create" << url << component->errors();
+        return false;
+    }
+
+    view->setContent(url, component, root);
+    return true;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAU_COMPONENT_CACHE_H
+#define OAU_COMPONENT_CACHE_H
+
+#include <QObject>
+#include <QUrl>
+
+class QQmlComponent;
+class QQmlContext;
+class QQmlEngine;
+class QQuickView;
+
+namespace OnlineAccountsUi {
+
+class ComponentCachePrivate;
+class ComponentCache: public QObject
+{
+    Q_OBJECT
+
+public:
+    static ComponentCache *instance();
+
+    /* The QML engine shared by all the views of this process */
+    QQmlEngine *engine() const;
+
+    /* Returns the component for the given URL, compiling it on the first
+     * call; components are owned by the cache. */
+    QQmlComponent *component(const QUrl &url);
+
+    /* Instantiates the component into the view, creating its root object in
+     * the given context. Views created on engine() use the cached
+     * component, others compile it on their own engine. */
+    bool setSource(QQuickView *view, const QUrl &url, QQmlContext *context);
+
+protected:
+    explicit ComponentCache(QObject *parent = 0);
+    ~ComponentCache();
+
+private:
+    static ComponentCache *m_instance;
+    ComponentCachePrivate *d_ptr;
+    Q_DECLARE_PRIVATE(ComponentCache)
+};
+
+} // namespace
+
+#endif // OAU_COMPONENT_CACHE_H
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cookie-jar.h"
+
+#include "debug.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QVariantMap>
+#include <QtEndian>
+#include <string.h>
+
+/* File layout (all integers are little endian):
+ *   char[4]  magic, "OACJ"
+ *   quint32  format version
+ *   quint32  number of cookies
+ * followed, for each cookie, by
+ *   quint32  length of the raw cookie
+ *   char[]   raw cookie, as returned by QNetworkCookie::toRawForm()
+ */
+static const char cookieJarMagic[4] = { 'O', 'A', 'C', 'J' };
+static const quint32 cookieJarVersion = 1;
+static const int cookieJarHeaderSize = 12;
+
+namespace OnlineAccountsUi {
+
+static void appendUInt32(QByteArray &data, quint32 value)
+{
+    uchar buffer[4];
+    qToLittleEndian(value, buffer);
+    data.append(reinterpret_cast<const char *>(buffer), 4);
+}
+
+QList<QNetworkCookie> cookiesFromVariant(const QVariantList &cl)
+{
+    QList<QNetworkCookie> cookies;
+    Q_FOREACH(QVariant cookie, cl) {
+        if (cookie.userType() == qMetaTypeId<QNetworkCookie>()) {
+            cookies.append(cookie.value<QNetworkCookie>());
+            continue;
+        }
+
+        if (!cookie.canConvert(QVariant::Map)) {
+            continue;
+        }
+
+        QNetworkCookie nc;
+        QVariantMap vm = cookie.toMap();
+        if (!vm.contains("name") || !vm.contains("value")) {
+            continue;
+        }
+
+        nc.setName(vm.value("name").toByteArray());
+        nc.setValue(vm.value("value").toByteArray());
+        nc.setDomain(vm.value("domain").toString());
+        nc.setPath(vm.value("path").toString());
+        if (vm.contains("httponly") &&
+            vm.value("httponly").canConvert(QVariant::Bool)) {
+            nc.setHttpOnly(vm.value("httponly").toBool());
+        }
+
+        if (vm.contains("issecure") &&
+            vm.value("issecure").canConvert(QVariant::Bool)) {
+            nc.setSecure(vm.value("issecure").toBool());
+        }
+
+        if (vm.contains("expirationdate") &&
+            vm.value("expirationdate").canConvert(QMetaType::QDateTime)) {
+            nc.setExpirationDate(vm.value("expirationdate").toDateTime());
+        }
+
+        cookies.append(nc);
+    }
+    return cookies;
+}
+
+bool writeCookieJar(const QString &fileName,
+                    const QList<QNetworkCookie> &cookies)
+{
+    QDateTime now = QDateTime::currentDateTimeUtc();
+
+    QByteArray data;
+    quint32 count = 0;
+    Q_FOREACH(const QNetworkCookie &cookie, cookies) {
+        if (!cookie.isSessionCookie() && cookie.expirationDate() < now) {
+            continue;
+        }
+        QByteArray rawCookie = cookie.toRawForm();
+        appendUInt32(data, rawCookie.length());
+        data.append(rawCookie);
+        count++;
+    }
+
+    QByteArray header(cookieJarMagic, sizeof(cookieJarMagic));
+    appendUInt32(header, cookieJarVersion);
+    appendUInt32(header, count);
+
+    /* Write to a temporary file and then rename it, so that readers never
+     * see a partially written jar */
+    QSaveFile file(fileName);
+    if (Q_UNLIKELY(!file.open(QIODevice::WriteOnly))) {
+        qWarning() << "Cannot write cookie jar" << fileName;
+        return false;
+    }
+    file.write(header);
+    file.write(data);
+    return file.commit();
+}
+
+bool readCookieJar(const QString &fileName, QList<QByteArray> &rawCookies)
+{
+    QFile file(fileName);
+    if (Q_UNLIKELY(!file.open(QIODevice::ReadOnly))) {
+        qWarning() << "Cannot open file" << fileName;
+        return false;
+    }
+
+    qint64 size = file.size();
+    if (Q_UNLIKELY(size < cookieJarHeaderSize)) return false;
+
+    const uchar *data = file.map(0, size);
+    if (Q_UNLIKELY(!data)) {
+        qWarning() << "Cannot map file" << fileName;
+        return false;
+    }
+
+    if (Q_UNLIKELY(memcmp(data, cookieJarMagic, sizeof(cookieJarMagic)) != 0 ||
+                   qFromLittleEndian<quint32>(data + 4) != cookieJarVersion)) {
+        DEBUG() << "Unsupported cookie jar" << fileName;
+        file.unmap(const_cast<uchar *>(data));
+        return false;
+    }
+
+    quint32 count = qFromLittleEndian<quint32>(data + 8);
+    qint64 offset = cookieJarHeaderSize;
+    bool ok = true;
+    for (quint32 i = 0; i < count; i++) {
+        if (Q_UNLIKELY(offset + 4 > size)) { ok = false; break; }
+        quint32 length = qFromLittleEndian<quint32>(data + offset);
+        offset += 4;
+        if (Q_UNLIKELY(offset + length > size)) { ok = false; break; }
+        rawCookies.append(QByteArray(reinterpret_cast<const char *>(data) +
+                                     offset, length));
+        offset += length;
+    }
+
+    file.unmap(const_cast<uchar *>(data));
+    if (Q_UNLIKELY(!ok)) {
+        qWarning() << "Truncated cookie jar" << fileName;
+        rawCookies.clear();
+    }
+    return ok;
+}
+
+bool readJsonCookies(const QString &fileName, QList<QByteArray> &rawCookies)
+{
+    QFile file(fileName);
+    if (Q_UNLIKELY(!file.open(QIODevice::ReadOnly | QIODevice::Text))) {
+        qWarning() << "Cannot open file" << fileName;
+        return false;
+    }
+
+    QByteArray contents = file.readAll();
+    QJsonDocument doc = QJsonDocument::fromJson(contents);
+    if (doc.isEmpty() || !doc.isArray()) return false;
+
+    QVariantList cookieVariants = doc.array().toVariantList();
+    Q_FOREACH(const QNetworkCookie &cookie,
+              cookiesFromVariant(cookieVariants)) {
+        rawCookies.append(cookie.toRawForm());
+    }
+    return true;
+}
+
+} // namespace
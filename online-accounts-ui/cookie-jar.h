@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAU_COOKIE_JAR_H
+#define OAU_COOKIE_JAR_H
+
+#include <QByteArray>
+#include <QList>
+#include <QNetworkCookie>
+#include <QString>
+#include <QVariantList>
+
+/* Names of the cookie files inside the data directory of an identity; the
+ * JSON file is written by older versions only. */
+#define OAU_COOKIE_JAR_FILE QStringLiteral("cookies.bin")
+#define OAU_COOKIE_JSON_FILE QStringLiteral("cookies.json")
+
+namespace OnlineAccountsUi {
+
+/* Converts the cookies as delivered by the webview (either QNetworkCookie
+ * objects or dictionaries) */
+QList<QNetworkCookie> cookiesFromVariant(const QVariantList &cookies);
+
+/* The cookie jar is a binary file holding the cookies in their raw form;
+ * expired cookies are not written. */
+bool writeCookieJar(const QString &fileName,
+                    const QList<QNetworkCookie> &cookies);
+bool readCookieJar(const QString &fileName, QList<QByteArray> &rawCookies);
+
+/* Reads a cookies.json file */
+bool readJsonCookies(const QString &fileName, QList<QByteArray> &rawCookies);
+
+} // namespace
+
+#endif // OAU_COOKIE_JAR_H
@@ -47,27 +47,35 @@ class DialogRequestPrivate: public QObject
 {
     Q_OBJECT
     Q_DECLARE_PUBLIC(DialogRequest)
-    Q_PROPERTY(QString title READ title CONSTANT)
+    Q_PROPERTY(QString title READ title NOTIFY parametersChanged)
     Q_PROPERTY(QString userName READ userName WRITE setUserName \
                NOTIFY userNameChanged)
     Q_PROPERTY(QString password READ password WRITE setPassword \
                NOTIFY passwordChanged)
-    Q_PROPERTY(QString userNameText READ userNameText CONSTANT)
-    Q_PROPERTY(QString passwordText READ passwordText CONSTANT)
-    Q_PROPERTY(QString message READ message CONSTANT)
-    Q_PROPERTY(bool queryUserName READ queryUserName CONSTANT)
-    Q_PROPERTY(bool queryPassword READ queryPassword CONSTANT)
-    Q_PROPERTY(QUrl forgotPasswordUrl READ forgotPasswordUrl CONSTANT)
-    Q_PROPERTY(QString forgotPasswordText READ forgotPasswordText CONSTANT)
-    Q_PROPERTY(QUrl registerUrl READ registerUrl CONSTANT)
-    Q_PROPERTY(QString registerText READ registerText CONSTANT)
-    Q_PROPERTY(QString loginText READ loginText CONSTANT)
+    Q_PROPERTY(QString userNameText READ userNameText \
+               NOTIFY parametersChanged)
+    Q_PROPERTY(QString passwordText READ passwordText \
+               NOTIFY parametersChanged)
+    Q_PROPERTY(QString message READ message NOTIFY parametersChanged)
+    Q_PROPERTY(bool queryUserName READ queryUserName \
+               NOTIFY parametersChanged)
+    Q_PROPERTY(bool queryPassword READ queryPassword \
+               NOTIFY parametersChanged)
+    Q_PROPERTY(QUrl forgotPasswordUrl READ forgotPasswordUrl \
+               NOTIFY parametersChanged)
+    Q_PROPERTY(QString forgotPasswordText READ forgotPasswordText \
+               NOTIFY parametersChanged)
+    Q_PROPERTY(QUrl registerUrl READ registerUrl NOTIFY parametersChanged)
+    Q_PROPERTY(QString registerText READ registerText \
+               NOTIFY parametersChanged)
+    Q_PROPERTY(QString loginText READ loginText NOTIFY parametersChanged)
 
 public:
     DialogRequestPrivate(DialogRequest *request);
     ~DialogRequestPrivate();
 
     void start();
+    void refresh(const QVariantMap &parameters);
 
     QString title() const { return q_ptr->windowTitle(); }
     void setUserName(const QString &userName);
@@ -92,11 +100,13 @@ public Q_SLOTS:
 Q_SIGNALS:
     void userNameChanged();
     void passwordChanged();
+    void parametersChanged();
 
 private Q_SLOTS:
     void onFinished();
 
 private:
+    void readParameters(const QVariantMap &params);
     void closeView();
 
 private:
@@ -125,45 +135,85 @@ DialogRequestPrivate::DialogRequestPrivate(DialogRequest *request):
     m_queryPassword(false),
     q_ptr(request)
 {
-    const QVariantMap &params = q_ptr->parameters();
+    readParameters(q_ptr->parameters());
+}
+
+DialogRequestPrivate::~DialogRequestPrivate()
+{
+    closeView();
+    delete m_dialog;
+}
 
-    m_queryUsername = params.value(SSOUI_KEY_QUERYUSERNAME, false).toBool();
-    m_userName = params.value(SSOUI_KEY_USERNAME).toString();
-    m_userNameText = params.value(SSOUI_KEY_USERNAME_TEXT).toString();
+void DialogRequestPrivate::readParameters(const QVariantMap &params)
+{
+    /* Only the given keys are updated: this is also used when the request is
+     * refreshed */
+    if (params.contains(SSOUI_KEY_QUERYUSERNAME)) {
+        m_queryUsername = params.value(SSOUI_KEY_QUERYUSERNAME).toBool();
+    }
+    if (params.contains(SSOUI_KEY_USERNAME)) {
+        setUserName(params.value(SSOUI_KEY_USERNAME).toString());
+    }
+    if (params.contains(SSOUI_KEY_USERNAME_TEXT)) {
+        m_userNameText = params.value(SSOUI_KEY_USERNAME_TEXT).toString();
+    }
     if (m_userNameText.isEmpty()) {
         m_userNameText = OnlineAccountsUi::_("Username:",
                                              SIGNONUI_I18N_DOMAIN);
     }
 
-    m_queryPassword = params.value(SSOUI_KEY_QUERYPASSWORD, false).toBool();
-    m_password = params.value(SSOUI_KEY_PASSWORD).toString();
-    m_passwordText = params.value(SSOUI_KEY_PASSWORD_TEXT).toString();
+    if (params.contains(SSOUI_KEY_QUERYPASSWORD)) {
+        m_queryPassword = params.value(SSOUI_KEY_QUERYPASSWORD).toBool();
+    }
+    if (params.contains(SSOUI_KEY_PASSWORD)) {
+        setPassword(params.value(SSOUI_KEY_PASSWORD).toString());
+    }
+    if (params.contains(SSOUI_KEY_PASSWORD_TEXT)) {
+        m_passwordText = params.value(SSOUI_KEY_PASSWORD_TEXT).toString();
+    }
     if (m_passwordText.isEmpty()) {
         m_passwordText = OnlineAccountsUi::_("Password:",
                                              SIGNONUI_I18N_DOMAIN);
     }
 
+    if (params.contains(SSOUI_KEY_MESSAGE)) {
+        m_message = params.value(SSOUI_KEY_MESSAGE).toString();
+    }
 
-    m_message = params.value(SSOUI_KEY_MESSAGE).toString();
-
-    m_forgotPasswordUrl =
-        QUrl(params.value(SSOUI_KEY_FORGOTPASSWORDURL).toString());
-    m_forgotPasswordText = params.value(SSOUI_KEY_FORGOTPASSWORD).toString();
+    if (params.contains(SSOUI_KEY_FORGOTPASSWORDURL)) {
+        m_forgotPasswordUrl =
+            QUrl(params.value(SSOUI_KEY_FORGOTPASSWORDURL).toString());
+    }
+    if (params.contains(SSOUI_KEY_FORGOTPASSWORD)) {
+        m_forgotPasswordText =
+            params.value(SSOUI_KEY_FORGOTPASSWORD).toString();
+    }
 
-    m_registerUrl =
-        QUrl(params.value(SSOUI_KEY_REGISTER_URL).toString());
-    m_registerText = params.value(SSOUI_KEY_REGISTER_TEXT).toString();
+    if (params.contains(SSOUI_KEY_REGISTER_URL)) {
+        m_registerUrl = QUrl(params.value(SSOUI_KEY_REGISTER_URL).toString());
+    }
+    if (params.contains(SSOUI_KEY_REGISTER_TEXT)) {
+        m_registerText = params.value(SSOUI_KEY_REGISTER_TEXT).toString();
+    }
 
-    m_loginText = params.value(SSOUI_KEY_LOGIN_TEXT).toString();
+    if (params.contains(SSOUI_KEY_LOGIN_TEXT)) {
+        m_loginText = params.value(SSOUI_KEY_LOGIN_TEXT).toString();
+    }
     if (m_loginText.isEmpty()) {
         m_loginText = OnlineAccountsUi::_("Sign in");
     }
 }
 
-DialogRequestPrivate::~DialogRequestPrivate()
+void DialogRequestPrivate::refresh(const QVariantMap &parameters)
 {
-    closeView();
-    delete m_dialog;
+    DEBUG() << parameters;
+
+    /* Keep the same window, just update its contents */
+    readParameters(parameters);
+    if (m_dialog) {
+        m_dialog->setTitle(title());
+    }
+    Q_EMIT parametersChanged();
 }
 
 void DialogRequestPrivate::start()
@@ -182,8 +232,8 @@ void DialogRequestPrivate::start()
 
         m_dialog->engine()->addImportPath(q->mountPoint() +
                                           PLUGIN_PRIVATE_MODULE_DIR);
-        m_dialog->rootContext()->setContextProperty("request", this);
-        m_dialog->setSource(QUrl("qrc:/qml/SignOnUiDialog.qml"));
+        m_dialog->viewContext()->setContextProperty("request", this);
+        m_dialog->load(QUrl("qrc:/qml/SignOnUiDialog.qml"));
         q->setWindow(m_dialog);
     } else {
         DEBUG() << "Setting request on handler";
@@ -274,4 +324,12 @@ void DialogRequest::start()
     d->start();
 }
 
+void DialogRequest::refresh(const QVariantMap &parameters)
+{
+    Q_D(DialogRequest);
+
+    Request::refresh(parameters);
+    d->refresh(parameters);
+}
+
 #include "dialog-request.moc"
@@ -42,6 +42,7 @@ public:
 
     // reimplemented virtual methods
     void start();
+    void refresh(const QVariantMap &parameters);
 
 private:
     DialogRequestPrivate *d_ptr;
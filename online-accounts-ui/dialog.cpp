@@ -18,15 +18,19 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "component-cache.h"
 #include "debug.h"
 #include "dialog.h"
 
 #include <QEvent>
+#include <QQmlContext>
+#include <QQmlEngine>
 
 using namespace SignOnUi;
 
 Dialog::Dialog(QWindow *parent):
-    QQuickView(parent)
+    QQuickView(OnlineAccountsUi::ComponentCache::instance()->engine(), parent),
+    m_context(new QQmlContext(engine()->rootContext(), this))
 {
     setResizeMode(QQuickView::SizeRootObjectToView);
     setWindowState(Qt::WindowFullScreen);
@@ -49,6 +53,12 @@ void Dialog::show(WId parent, ShowMode mode)
     QQuickView::show();
 }
 
+void Dialog::load(const QUrl &url)
+{
+    OnlineAccountsUi::ComponentCache::instance()->setSource(this, url,
+                                                            m_context);
+}
+
 void Dialog::accept()
 {
     done(Dialog::Accepted);
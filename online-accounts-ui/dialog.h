@@ -24,6 +24,8 @@
 #include <QObject>
 #include <QQuickView>
 
+class QQmlContext;
+
 namespace SignOnUi {
 
 class Dialog: public QQuickView
@@ -45,6 +47,11 @@ public:
 
     void show(WId parent, ShowMode mode);
 
+    /* The engine is shared with the other views: context properties must be
+     * set here, and not in rootContext() */
+    QQmlContext *viewContext() const { return m_context; }
+    void load(const QUrl &url);
+
 public Q_SLOTS:
     void accept();
     void reject();
@@ -55,6 +62,9 @@ Q_SIGNALS:
 
 protected:
     bool event(QEvent *e);
+
+private:
+    QQmlContext *m_context;
 };
 
 } // namespace
@@ -24,6 +24,7 @@
 #include "dialog.h"
 #include "globals.h"
 #include "i18n.h"
+#include "redirect-matcher.h"
 
 #include <OnlineAccountsPlugin/request-handler.h>
 #include <QQmlContext>
@@ -69,6 +70,7 @@ private:
 
 private:
     Dialog *m_dialog;
+    RedirectMatcher m_redirectMatcher;
     QUrl m_startUrl;
     QUrl m_responseUrl;
     mutable ExternalBrowserRequest *q_ptr;
@@ -98,6 +100,7 @@ void ExternalBrowserRequestPrivate::start()
     DEBUG() << params;
 
     m_startUrl = params.value(SSOUI_KEY_OPENURL).toString();
+    m_redirectMatcher.setFinalUrls(params.value(SSOUI_KEY_FINALURL));
     if (!q->hasHandler()) {
         buildDialog(params);
 
@@ -105,8 +108,8 @@ void ExternalBrowserRequestPrivate::start()
                          this, SLOT(onFinished()));
 
         m_dialog->engine()->addImportPath(PLUGIN_PRIVATE_MODULE_DIR);
-        m_dialog->rootContext()->setContextProperty("request", this);
-        m_dialog->setSource(QUrl("qrc:/qml/SignOnUiPage.qml"));
+        m_dialog->viewContext()->setContextProperty("request", this);
+        m_dialog->load(QUrl("qrc:/qml/SignOnUiPage.qml"));
     } else {
         DEBUG() << "Setting request on handler";
         q->handler()->setRequest(this);
@@ -117,6 +120,13 @@ void ExternalBrowserRequestPrivate::urlVisited(const QUrl &url)
 {
     DEBUG() << "Url visited:" << url;
 
+    /* The loopback server might also get requests for other resources, such
+     * as the favicon */
+    if (!m_redirectMatcher.isEmpty() && !m_redirectMatcher.matches(url)) {
+        DEBUG() << "Not a final URL";
+        return;
+    }
+
     m_responseUrl = url;
     onFinished();
 }
@@ -31,6 +31,7 @@ class QIODevice;
 #define OAU_OPERATION_CODE_REGISTER_HANDLER "newHandler"
 #define OAU_OPERATION_CODE_REQUEST_FINISHED "finished"
 #define OAU_OPERATION_CODE_REQUEST_FAILED "failed"
+#define OAU_OPERATION_CODE_REFRESH "refresh"
 #define OAU_OPERATION_ID "id"
 #define OAU_OPERATION_DATA "data"
 #define OAU_OPERATION_DELAY "delay"
@@ -39,6 +40,13 @@ class QIODevice;
 #define OAU_OPERATION_ERROR_NAME "errname"
 #define OAU_OPERATION_ERROR_MESSAGE "errmsg"
 #define OAU_OPERATION_HANDLER_ID "handlerId"
+#define OAU_OPERATION_TIMINGS "timings"
+#define OAU_OPERATION_REQUEST_TYPE "requestType"
+#define OAU_OPERATION_PROVIDER "provider"
+/* Timings, in milliseconds since the request was started */
+#define OAU_TIMING_EXPOSED "exposed"
+#define OAU_TIMING_FIRST_FRAME "firstFrame"
+#define OAU_TIMING_LOADED "loaded"
 #define OAU_REQUEST_MATCH_KEY "X-RequestHandler"
 
 namespace OnlineAccountsUi {
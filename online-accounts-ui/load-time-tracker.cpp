@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "load-time-tracker.h"
+
+#include "debug.h"
+
+#include <QSettings>
+#include <QStandardPaths>
+#include <QtGlobal>
+
+using namespace SignOnUi;
+
+/* Used when no page has been loaded from the host yet */
+#ifndef SIGNONUI_FAIL_TIMEOUT
+#define SIGNONUI_FAIL_TIMEOUT 3000
+#endif
+
+/* Default bounds; they can be changed with the PageLoadTimeoutMin and
+ * PageLoadTimeoutMax settings */
+#ifndef SIGNONUI_FAIL_TIMEOUT_MIN
+#define SIGNONUI_FAIL_TIMEOUT_MIN 1000
+#endif
+#ifndef SIGNONUI_FAIL_TIMEOUT_MAX
+#define SIGNONUI_FAIL_TIMEOUT_MAX 20000
+#endif
+
+/* Weight of the newest sample in the moving average */
+#define LOAD_TIME_ALPHA 0.3
+/* How many times the average load time we wait for */
+#define FAIL_TIMEOUT_FACTOR 3
+
+LoadTimeTracker::LoadTimeTracker(const QString &host):
+    m_average(0),
+    m_sampleCount(0),
+    m_minTimeout(SIGNONUI_FAIL_TIMEOUT_MIN),
+    m_maxTimeout(SIGNONUI_FAIL_TIMEOUT_MAX)
+{
+    readBounds();
+    setHost(host);
+}
+
+QString LoadTimeTracker::storePath()
+{
+    /* Not in the cache directory: that's where the web engine data lives,
+     * which is watched and trimmed by the service */
+    return QStandardPaths::writableLocation(
+        QStandardPaths::GenericDataLocation) +
+        "/online-accounts-ui/page-load-times.ini";
+}
+
+void LoadTimeTracker::readBounds()
+{
+    QSettings settings("online-accounts-service");
+    m_minTimeout = settings.value("PageLoadTimeoutMin",
+                                  m_minTimeout).toInt();
+    m_maxTimeout = settings.value("PageLoadTimeoutMax",
+                                  m_maxTimeout).toInt();
+    if (Q_UNLIKELY(m_maxTimeout < m_minTimeout)) {
+        qWarning() << "Invalid page load timeout bounds" <<
+            m_minTimeout << m_maxTimeout;
+        m_maxTimeout = m_minTimeout;
+    }
+}
+
+void LoadTimeTracker::setHost(const QString &host)
+{
+    if (!host.isEmpty() && host == m_host) return;
+
+    m_host = host;
+    m_average = 0;
+    m_sampleCount = 0;
+    if (m_host.isEmpty()) return;
+
+    QSettings store(storePath(), QSettings::IniFormat);
+    store.beginGroup(m_host);
+    m_average = store.value("average", 0).toDouble();
+    m_sampleCount = store.value("samples", 0).toInt();
+}
+
+void LoadTimeTracker::addSample(qint64 loadTime)
+{
+    if (Q_UNLIKELY(loadTime < 0)) return;
+
+    if (m_sampleCount == 0) {
+        m_average = loadTime;
+    } else {
+        m_average += LOAD_TIME_ALPHA * (loadTime - m_average);
+    }
+    m_sampleCount++;
+    DEBUG() << m_host << "loaded in" << loadTime << "ms, average" <<
+        m_average << "timeout" << failTimeout();
+
+    if (m_host.isEmpty()) return;
+    QSettings store(storePath(), QSettings::IniFormat);
+    store.beginGroup(m_host);
+    store.setValue("average", m_average);
+    store.setValue("samples", m_sampleCount);
+}
+
+qint64 LoadTimeTracker::averageLoadTime() const
+{
+    return m_sampleCount > 0 ? qRound64(m_average) : -1;
+}
+
+int LoadTimeTracker::failTimeout() const
+{
+    qint64 timeout = m_sampleCount > 0 ?
+        qRound64(m_average * FAIL_TIMEOUT_FACTOR) : SIGNONUI_FAIL_TIMEOUT;
+    return int(qBound(qint64(m_minTimeout), timeout, qint64(m_maxTimeout)));
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIGNON_UI_LOAD_TIME_TRACKER_H
+#define SIGNON_UI_LOAD_TIME_TRACKER_H
+
+#include <QString>
+
+namespace SignOnUi {
+
+/* Keeps an exponentially weighted moving average of the page load times
+ * observed for a host, and derives from it how long to wait before a failed
+ * page load is considered a network error. The averages are stored in the
+ * data directory, where they can be inspected for tuning. */
+class LoadTimeTracker
+{
+public:
+    explicit LoadTimeTracker(const QString &host = QString());
+
+    void setHost(const QString &host);
+    QString host() const { return m_host; }
+
+    void addSample(qint64 loadTime);
+    /* Returns -1 if no page has been loaded from this host yet */
+    qint64 averageLoadTime() const;
+    int sampleCount() const { return m_sampleCount; }
+
+    /* In milliseconds, within the configured bounds */
+    int failTimeout() const;
+
+    static QString storePath();
+
+private:
+    void readBounds();
+
+private:
+    QString m_host;
+    double m_average;
+    int m_sampleCount;
+    int m_minTimeout;
+    int m_maxTimeout;
+};
+
+} // namespace
+
+#endif // SIGNON_UI_LOAD_TIME_TRACKER_H
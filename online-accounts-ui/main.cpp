@@ -71,6 +71,14 @@ int main(int argc, char **argv)
         setLoggingLevel(settings.value("LoggingLevel", 1).toInt());
     }
 
+    bool browserPreWarming;
+    if (environment.contains(QLatin1String("OAU_PREWARM_BROWSER"))) {
+        browserPreWarming =
+            environment.value(QLatin1String("OAU_PREWARM_BROWSER")) == "1";
+    } else {
+        browserPreWarming = settings.value("PreWarmBrowser", false).toBool();
+    }
+
     initTr(I18N_DOMAIN, NULL);
 
     QString socket;
@@ -100,6 +108,7 @@ int main(int argc, char **argv)
         qWarning() << "Could not connect to socket";
         return EXIT_FAILURE;
     }
+    server.setBrowserPreWarming(browserPreWarming);
 
     return app.exec();
 }
@@ -12,6 +12,7 @@ CONFIG += \
 QT += \
     dbus \
     gui \
+    network \
     qml \
     quick
 
@@ -43,14 +44,18 @@ DEFINES += \
 SOURCES += \
     access-model.cpp \
     browser-request.cpp \
+    component-cache.cpp \
+    cookie-jar.cpp \
     debug.cpp \
     dialog.cpp \
     dialog-request.cpp \
     external-browser-request.cpp \
     i18n.cpp \
     ipc.cpp \
+    load-time-tracker.cpp \
     main.cpp \
     provider-request.cpp \
+    redirect-matcher.cpp \
     request.cpp \
     signonui-request.cpp \
     ui-server.cpp
@@ -58,13 +63,17 @@ SOURCES += \
 HEADERS += \
     access-model.h \
     browser-request.h \
+    component-cache.h \
+    cookie-jar.h \
     debug.h \
     dialog.h \
     dialog-request.h \
     external-browser-request.h \
     i18n.h \
     ipc.h \
+    load-time-tracker.h \
     provider-request.h \
+    redirect-matcher.h \
     request.h \
     signonui-request.h \
     ui-server.h
@@ -78,6 +87,14 @@ QML_SOURCES = \
 RESOURCES += \
     ui.qrc
 
+# Compile the QML files embedded in the resources ahead of time
+CONFIG(qml-aot) {
+    !exists($$[QT_HOST_DATA]/mkspecs/features/qtquickcompiler.prf) {
+        error("qml-aot requires the Qt Quick compiler")
+    }
+    CONFIG += qtquickcompiler
+}
+
 OTHER_FILES += \
     $${QML_SOURCES} \
     $${RESOURCES}
@@ -19,12 +19,14 @@
  */
 
 #include "access-model.h"
+#include "component-cache.h"
 #include "debug.h"
 #include "globals.h"
 #include "provider-request.h"
 
 #include <OnlineAccountsPlugin/account-manager.h>
 #include <OnlineAccountsPlugin/application-manager.h>
+#include <QFileInfo>
 #include <QQmlContext>
 #include <QQmlEngine>
 #include <QQuickItem>
@@ -119,7 +121,25 @@ void ProviderRequestPrivate::start()
     }
     m_providerInfo = appManager->providerInfo(providerId);
 
-    m_view = new QQuickView;
+    /* If the plugin comes from a click package, also add
+     *   <package-dir>/lib
+     *   <package-dir>/lib/<DEB_HOST_MULTIARCH>
+     * to the QML import path. Since that would affect the modules seen by
+     * all the following requests, such plugins get an engine of their own.
+     */
+    QString packageDir = m_providerInfo.value("package-dir").toString();
+    if (packageDir.isEmpty()) {
+        m_view = new QQuickView(ComponentCache::instance()->engine(), 0);
+    } else {
+        /* Resolve the link to the current version of the package: the QML
+         * disk cache is keyed by file path, so entries compiled from
+         * different versions don't collide */
+        QString versionedPackageDir = QFileInfo(packageDir).canonicalFilePath();
+        if (!versionedPackageDir.isEmpty()) {
+            packageDir = versionedPackageDir;
+        }
+        m_view = new QQuickView;
+    }
     QObject::connect(m_view, SIGNAL(visibleChanged(bool)),
                      this, SLOT(onWindowVisibleChanged(bool)));
     m_view->setResizeMode(QQuickView::SizeRootObjectToView);
@@ -127,12 +147,6 @@ void ProviderRequestPrivate::start()
     QQmlEngine *engine = m_view->engine();
     engine->addImportPath(mountPoint + PLUGIN_PRIVATE_MODULE_DIR);
 
-    /* If the plugin comes from a click package, also add
-     *   <package-dir>/lib
-     *   <package-dir>/lib/<DEB_HOST_MULTIARCH>
-     * to the QML import path.
-     */
-    QString packageDir = m_providerInfo.value("package-dir").toString();
     if (!packageDir.isEmpty()) {
         engine->addImportPath(packageDir + "/lib");
 #ifdef DEB_HOST_MULTIARCH
@@ -140,7 +154,8 @@ void ProviderRequestPrivate::start()
 #endif
     }
 
-    QQmlContext *context = m_view->rootContext();
+    /* Each view has its own context, as the engine might be shared */
+    QQmlContext *context = new QQmlContext(engine->rootContext(), m_view);
 
     context->setContextProperty("systemQmlPluginPath",
                                 QUrl::fromLocalFile(mountPoint + OAU_PLUGIN_DIR));
@@ -151,7 +166,10 @@ void ProviderRequestPrivate::start()
     context->setContextProperty("request", this);
     context->setContextProperty("mainWindow", m_view);
 
-    m_view->setSource(QUrl(QStringLiteral("qrc:/qml/ProviderRequest.qml")));
+    if (ComponentCache::instance()->setSource(m_view,
+            QUrl(QStringLiteral("qrc:/qml/ProviderRequest.qml")), context)) {
+        q->setContentLoaded();
+    }
     /* It could be that allow() or deny() have been already called; don't show
      * the window in that case. */
     if (q->isInProgress()) {
@@ -12,7 +12,7 @@ MainView {
     height: units.gu(90)
 
     Page {
-        title: signonRequest.title
+        title: signonRequest ? signonRequest.title : ""
 
         WebView {
             id: loader
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "redirect-matcher.h"
+
+#include "debug.h"
+
+#include <QStringList>
+#include <QStringRef>
+
+using namespace SignOnUi;
+
+static inline bool isHttpScheme(const QString &scheme)
+{
+    return scheme == QLatin1String("http") || scheme == QLatin1String("https");
+}
+
+static inline QStringRef withoutTrailingSlashes(const QString &path)
+{
+    int length = path.length();
+    while (length > 0 && path.at(length - 1) == QLatin1Char('/')) length--;
+    return path.leftRef(length);
+}
+
+RedirectMatcher::RedirectMatcher()
+{
+}
+
+void RedirectMatcher::setFinalUrls(const QVariant &finalUrls)
+{
+    m_patterns.clear();
+
+    Q_FOREACH(const QString &finalUrl, finalUrls.toStringList()) {
+        QUrl url(finalUrl);
+        if (Q_UNLIKELY(url.isEmpty() || !url.isValid() ||
+                       url.scheme().isEmpty())) {
+            DEBUG() << "Ignoring invalid final URL" << finalUrl;
+            continue;
+        }
+
+        Pattern pattern;
+        pattern.url = url;
+        pattern.scheme = url.scheme();
+        pattern.host = url.host();
+        pattern.path = withoutTrailingSlashes(url.path()).toString();
+        pattern.isHttp = isHttpScheme(pattern.scheme);
+        pattern.schemeOnly = !pattern.isHttp &&
+            pattern.host.isEmpty() && pattern.path.isEmpty();
+        m_patterns.append(pattern);
+    }
+}
+
+QUrl RedirectMatcher::firstFinalUrl() const
+{
+    return m_patterns.isEmpty() ? QUrl() : m_patterns.first().url;
+}
+
+bool RedirectMatcher::matches(const QUrl &url) const
+{
+    if (m_patterns.isEmpty()) return false;
+
+    /* The scheme is stored as is in the QUrl, while host and path are
+     * rebuilt at every call: only get them when needed */
+    const QString scheme = url.scheme();
+    const bool isHttp = isHttpScheme(scheme);
+    QString host;
+    QString path;
+    bool haveHostAndPath = false;
+
+    QVector<Pattern>::const_iterator i;
+    for (i = m_patterns.constBegin(); i != m_patterns.constEnd(); i++) {
+        const Pattern &pattern = *i;
+        if (pattern.isHttp ? !isHttp : pattern.scheme != scheme) continue;
+        if (pattern.schemeOnly) return true;
+
+        if (!haveHostAndPath) {
+            host = url.host();
+            path = url.path();
+            haveHostAndPath = true;
+        }
+        if (host == pattern.host &&
+            withoutTrailingSlashes(path) == pattern.path) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIGNON_UI_REDIRECT_MATCHER_H
+#define SIGNON_UI_REDIRECT_MATCHER_H
+
+#include <QString>
+#include <QUrl>
+#include <QVariant>
+#include <QVector>
+
+namespace SignOnUi {
+
+/* Tells whether a URL visited during the authentication is one of the final
+ * URLs requested by the client. The final URLs are parsed once, and can be:
+ *   - http(s) URLs: the host and the path must match, while the scheme, the
+ *     query and any trailing slashes in the path are ignored;
+ *   - "scheme:" alone: any URL having that scheme matches;
+ *   - custom scheme callbacks, like "com.example.app:/callback": the scheme,
+ *     host and path must all match.
+ */
+class RedirectMatcher
+{
+public:
+    RedirectMatcher();
+
+    /* Accepts either a single URL or a list of URLs */
+    void setFinalUrls(const QVariant &finalUrls);
+    QUrl firstFinalUrl() const;
+    bool isEmpty() const { return m_patterns.isEmpty(); }
+
+    bool matches(const QUrl &url) const;
+
+private:
+    struct Pattern {
+        QUrl url;
+        QString scheme;
+        QString host;
+        QString path;
+        bool isHttp;
+        bool schemeOnly;
+    };
+    QVector<Pattern> m_patterns;
+};
+
+} // namespace
+
+#endif // SIGNON_UI_REDIRECT_MATCHER_H
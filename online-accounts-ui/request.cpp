@@ -21,12 +21,16 @@
 #include "debug.h"
 // TODO #include "dialog-request.h"
 #include "globals.h"
+#include "ipc.h"
 #include "provider-request.h"
 #include "request.h"
 #include "signonui-request.h"
 
+#include <QElapsedTimer>
+#include <QEvent>
 #include <QFile>
 #include <QPointer>
+#include <QQuickWindow>
 
 using namespace OnlineAccountsUi;
 
@@ -62,8 +66,15 @@ public:
         return m_parameters[OAU_KEY_WINDOW_ID].toUInt();
     }
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) Q_DECL_OVERRIDE;
+
 private:
     void setWindow(QWindow *window);
+    void recordTiming(const char *name);
+
+private Q_SLOTS:
+    void onFrameSwapped();
 
 private:
     mutable Request *q_ptr;
@@ -77,6 +88,9 @@ private:
     QString m_errorMessage;
     QVariantMap m_result;
     int m_delay;
+    QElapsedTimer m_timer;
+    QVariantMap m_timings;
+    bool m_contentLoaded;
 };
 
 } // namespace
@@ -94,7 +108,8 @@ RequestPrivate::RequestPrivate(const QString &interface,
     m_clientApparmorProfile(clientProfile),
     m_inProgress(false),
     m_window(0),
-    m_delay(0)
+    m_delay(0),
+    m_contentLoaded(false)
 {
 }
 
@@ -111,6 +126,16 @@ void RequestPrivate::setWindow(QWindow *window)
 
     m_window = window;
 
+    /* Measure the time until the UI is actually drawn */
+    window->installEventFilter(this);
+    QQuickWindow *quickWindow = qobject_cast<QQuickWindow*>(window);
+    if (quickWindow) {
+        QObject::connect(quickWindow, SIGNAL(frameSwapped()),
+                         this, SLOT(onFrameSwapped()));
+    } else if (m_contentLoaded) {
+        recordTiming(OAU_TIMING_LOADED);
+    }
+
     if (windowId() != 0) {
         DEBUG() << "Requesting window reparenting";
         QWindow *parent = QWindow::fromWinId(windowId());
@@ -119,6 +144,32 @@ void RequestPrivate::setWindow(QWindow *window)
     window->show();
 }
 
+void RequestPrivate::recordTiming(const char *name)
+{
+    QString key = QString::fromLatin1(name);
+    if (m_timings.contains(key) || !m_timer.isValid()) return;
+    m_timings.insert(key, m_timer.elapsed());
+}
+
+bool RequestPrivate::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::Expose && watched == m_window &&
+        m_window->isExposed()) {
+        recordTiming(OAU_TIMING_EXPOSED);
+        m_window->removeEventFilter(this);
+    }
+    return false;
+}
+
+void RequestPrivate::onFrameSwapped()
+{
+    QObject::disconnect(m_window, SIGNAL(frameSwapped()),
+                        this, SLOT(onFrameSwapped()));
+    recordTiming(OAU_TIMING_FIRST_FRAME);
+    DEBUG() << "Time to first frame:" << m_timer.elapsed() << "ms";
+    if (m_contentLoaded) recordTiming(OAU_TIMING_LOADED);
+}
+
 /* Some unit tests might need to provide a different implementation for the
  * Request::newRequest() factory method; for this reason, we allow the method
  * to be excluded from compilation.
@@ -250,6 +301,37 @@ int Request::delay() const
     return d->m_delay;
 }
 
+void Request::setContentLoaded()
+{
+    Q_D(Request);
+    /* The contents are often ready before the window is even shown: until
+     * they have been drawn, the user is still waiting for them. */
+    d->m_contentLoaded = true;
+    if (d->m_timings.contains(QStringLiteral(OAU_TIMING_FIRST_FRAME)) ||
+        (d->m_window && !qobject_cast<QQuickWindow*>(d->m_window.data()))) {
+        d->recordTiming(OAU_TIMING_LOADED);
+    }
+}
+
+QVariantMap Request::timings() const
+{
+    Q_D(const Request);
+    return d->m_timings;
+}
+
+void Request::refresh(const QVariantMap &parameters)
+{
+    Q_D(Request);
+
+    DEBUG() << parameters;
+
+    QMapIterator<QString, QVariant> it(parameters);
+    while (it.hasNext()) {
+        it.next();
+        d->m_parameters.insert(it.key(), it.value());
+    }
+}
+
 void Request::start()
 {
     Q_D(Request);
@@ -258,6 +340,7 @@ void Request::start()
         return;
     }
     d->m_inProgress = true;
+    d->m_timer.start();
 }
 
 void Request::cancel()
@@ -50,11 +50,19 @@ public:
     QString clientApparmorProfile() const;
     QWindow *window() const;
 
+    /* Merges the given parameters into the current ones; subclasses update
+     * their UI accordingly. */
+    virtual void refresh(const QVariantMap &parameters);
+
     QVariantMap result() const;
     QString errorName() const;
     QString errorMessage() const;
     int delay() const;
 
+    /* Milliseconds elapsed from start() until the window was first exposed,
+     * drew its first frame and showed its loaded contents */
+    QVariantMap timings() const;
+
 public Q_SLOTS:
     virtual void start();
     void cancel();
@@ -70,6 +78,7 @@ protected:
                      QObject *parent = 0);
     virtual void setWindow(QWindow *window);
     void setDelay(int delay);
+    void setContentLoaded();
 
     QString mountPoint() const;
 
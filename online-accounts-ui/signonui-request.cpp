@@ -25,12 +25,12 @@
 #include "dialog-request.h"
 #include "external-browser-request.h"
 #include "globals.h"
+#include "redirect-matcher.h"
 
 #include <Accounts/Account>
 #include <Accounts/Provider>
 #include <OnlineAccountsPlugin/account-manager.h>
 #include <OnlineAccountsPlugin/request-handler.h>
-#include <QDBusArgument>
 #include <QPointer>
 #include <QUrl>
 #include <SignOn/uisessiondata.h>
@@ -70,12 +70,9 @@ RequestPrivate::RequestPrivate(Request *request):
     m_handler(0)
 {
     const QVariantMap &parameters = request->parameters();
-    if (parameters.contains(SSOUI_KEY_CLIENT_DATA)) {
-        QVariant variant = parameters[SSOUI_KEY_CLIENT_DATA];
-        m_clientData = (variant.type() == QVariant::Map) ?
-            variant.toMap() :
-            qdbus_cast<QVariantMap>(variant.value<QDBusArgument>());
-    }
+    /* The service has already converted the D-Bus arguments into native
+     * types */
+    m_clientData = parameters.value(SSOUI_KEY_CLIENT_DATA).toMap();
 
     m_account = findAccount();
 }
@@ -92,24 +89,25 @@ Accounts::Account *RequestPrivate::findAccount()
     if (identity == 0)
         return 0;
 
-    /* Find the account using this identity.
-     * FIXME: there might be more than one!
-     */
     OnlineAccountsUi::AccountManager *manager =
         OnlineAccountsUi::AccountManager::instance();
-    Q_FOREACH(Accounts::AccountId accountId, manager->accountList()) {
-        Accounts::Account *account = manager->account(accountId);
-        if (account == 0) continue;
-
-        QVariant value(QVariant::UInt);
-        if (account->value("CredentialsId", value) != Accounts::NONE &&
-            value.toUInt() == identity) {
-            return account;
+    QList<Accounts::AccountId> accountIds =
+        manager->accountsForCredentials(identity);
+    if (accountIds.isEmpty()) return 0;
+
+    /* If more accounts share this identity, prefer the one for the provider
+     * given by the client */
+    if (accountIds.count() > 1) {
+        QString providerId = m_clientData.value("providerId").toString();
+        Q_FOREACH(Accounts::AccountId accountId, accountIds) {
+            Accounts::Account *account = manager->account(accountId);
+            if (account != 0 && account->providerName() == providerId) {
+                return account;
+            }
         }
     }
 
-    // Not found
-    return 0;
+    return manager->account(accountIds.first());
 }
 
 #ifndef NO_REQUEST_FACTORY
@@ -119,9 +117,10 @@ Request *Request::newRequest(int id,
                              QObject *parent)
 {
     if (parameters.contains(SSOUI_KEY_OPENURL)) {
-        QUrl finalUrl =
-            QUrl::fromUserInput(parameters.value(SSOUI_KEY_FINALURL).
-                                toString());
+        /* Parse the final URL like the request itself will do */
+        RedirectMatcher redirectMatcher;
+        redirectMatcher.setFinalUrls(parameters.value(SSOUI_KEY_FINALURL));
+        QUrl finalUrl = redirectMatcher.firstFinalUrl();
         if (finalUrl.host() == "localhost") {
             /* Let's assume that we only use a loopback callback URL when we
              * are forced to use the system browser; when we don't have this
@@ -18,6 +18,7 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "browser-request.h"
 #include "debug.h"
 #include "ipc.h"
 #include "request.h"
@@ -28,11 +29,20 @@
 #include <QByteArray>
 #include <QDataStream>
 #include <QLocalSocket>
+#include <QTimer>
 #include <QtQml>
 #include <SignOn/uisessiondata_priv.h>
 
 using namespace OnlineAccountsUi;
 
+/* How long the process must stay idle before we pre-warm the browser */
+#define PRE_WARM_DELAY 500
+
+/* The daemon only keeps us alive for the delay returned with a finished
+ * request; when pre-warming, we ask it to keep us around at least this long,
+ * or the pre-warmed browser would be wasted. */
+#define PRE_WARM_KEEP_ALIVE 5000
+
 static UiServer *m_instance = 0;
 
 namespace OnlineAccountsUi {
@@ -49,16 +59,23 @@ public:
     bool setupSocket();
     bool init();
     void sendOperation(const QVariantMap &data);
+    void addTimings(QVariantMap &operation, Request *request);
+    int keepAliveTime(Request *request) const;
+    void schedulePreWarming(int keepAliveTime);
 
 private Q_SLOTS:
     void onDataReady(QByteArray &data);
     void onRequestCompleted();
     void registerHandler(SignOnUi::RequestHandler *handler);
+    void onPreWarmTimeout();
 
 private:
     QLocalSocket m_socket;
     OnlineAccountsUi::Ipc m_ipc;
     SignOnUi::RequestHandlerWatcher m_handlerWatcher;
+    QMap<int,Request*> m_requests;
+    bool m_browserPreWarming;
+    QTimer m_preWarmTimer;
     mutable UiServer *q_ptr;
 };
 
@@ -67,8 +84,14 @@ private:
 UiServerPrivate::UiServerPrivate(const QString &address,
                                  UiServer *pluginServer):
     QObject(pluginServer),
+    m_browserPreWarming(false),
     q_ptr(pluginServer)
 {
+    m_preWarmTimer.setSingleShot(true);
+    m_preWarmTimer.setInterval(PRE_WARM_DELAY);
+    QObject::connect(&m_preWarmTimer, SIGNAL(timeout()),
+                     this, SLOT(onPreWarmTimeout()));
+
     QObject::connect(&m_ipc, SIGNAL(dataReady(QByteArray &)),
                      this, SLOT(onDataReady(QByteArray &)));
     QObject::connect(&m_socket, SIGNAL(disconnected()),
@@ -94,6 +117,45 @@ void UiServerPrivate::sendOperation(const QVariantMap &data)
     m_ipc.write(ba);
 }
 
+void UiServerPrivate::addTimings(QVariantMap &operation, Request *request)
+{
+    QVariantMap timings = request->timings();
+    if (timings.isEmpty()) return;
+
+    operation.insert(OAU_OPERATION_TIMINGS, timings);
+    operation.insert(OAU_OPERATION_REQUEST_TYPE,
+                     QString::fromLatin1(request->metaObject()->className()));
+    /* The service cannot tell the provider of SignOn requests */
+    SignOnUi::Request *signonRequest =
+        qobject_cast<SignOnUi::Request*>(request);
+    if (signonRequest) {
+        operation.insert(OAU_OPERATION_PROVIDER, signonRequest->providerId());
+    }
+}
+
+int UiServerPrivate::keepAliveTime(Request *request) const
+{
+    if (m_browserPreWarming && m_requests.isEmpty()) {
+        return qMax(request->delay(), PRE_WARM_KEEP_ALIVE);
+    }
+    return request->delay();
+}
+
+void UiServerPrivate::schedulePreWarming(int keepAliveTime)
+{
+    if (m_browserPreWarming && m_requests.isEmpty() &&
+        keepAliveTime > PRE_WARM_DELAY) {
+        m_preWarmTimer.start();
+    }
+}
+
+void UiServerPrivate::onPreWarmTimeout()
+{
+    /* Don't compete with a request which might have just arrived */
+    if (!m_requests.isEmpty()) return;
+    SignOnUi::BrowserRequest::preWarm();
+}
+
 void UiServerPrivate::onDataReady(QByteArray &data)
 {
     QVariantMap map;
@@ -104,6 +166,7 @@ void UiServerPrivate::onDataReady(QByteArray &data)
 
     QString code = map.value(OAU_OPERATION_CODE).toString();
     if (code == OAU_OPERATION_CODE_PROCESS) {
+        m_preWarmTimer.stop();
         QVariantMap parameters = map[OAU_OPERATION_DATA].toMap();
         Request *request =
             Request::newRequest(map[OAU_OPERATION_INTERFACE].toString(),
@@ -113,6 +176,7 @@ void UiServerPrivate::onDataReady(QByteArray &data)
                                 this);
         QObject::connect(request, SIGNAL(completed()),
                          this, SLOT(onRequestCompleted()));
+        m_requests.insert(request->id(), request);
 
         /* Check if a RequestHandler has been setup to handle this request. If
          * so, bing the request object to the handler and start the request
@@ -127,6 +191,14 @@ void UiServerPrivate::onDataReady(QByteArray &data)
             }
         }
         request->start();
+    } else if (code == OAU_OPERATION_CODE_REFRESH) {
+        Request *request = m_requests.value(map[OAU_OPERATION_ID].toInt(), 0);
+        if (Q_UNLIKELY(!request)) {
+            qWarning() << "Refresh for unknown request" <<
+                map[OAU_OPERATION_ID].toInt();
+            return;
+        }
+        request->refresh(map[OAU_OPERATION_DATA].toMap());
     } else {
         qWarning() << "Invalid operation code: " << code;
     }
@@ -137,6 +209,7 @@ void UiServerPrivate::onRequestCompleted()
     Request *request = qobject_cast<Request*>(sender());
     request->disconnect(this);
     request->deleteLater();
+    m_requests.remove(request->id());
 
     if (request->errorName().isEmpty()) {
         QVariantMap operation;
@@ -144,9 +217,12 @@ void UiServerPrivate::onRequestCompleted()
                          OAU_OPERATION_CODE_REQUEST_FINISHED);
         operation.insert(OAU_OPERATION_ID, request->id());
         operation.insert(OAU_OPERATION_DATA, request->result());
-        operation.insert(OAU_OPERATION_DELAY, request->delay());
+        int delay = keepAliveTime(request);
+        operation.insert(OAU_OPERATION_DELAY, delay);
         operation.insert(OAU_OPERATION_INTERFACE, request->interface());
+        addTimings(operation, request);
         sendOperation(operation);
+        schedulePreWarming(delay);
     } else {
         QVariantMap operation;
         operation.insert(OAU_OPERATION_CODE,
@@ -155,6 +231,7 @@ void UiServerPrivate::onRequestCompleted()
         operation.insert(OAU_OPERATION_INTERFACE, request->interface());
         operation.insert(OAU_OPERATION_ERROR_NAME, request->errorName());
         operation.insert(OAU_OPERATION_ERROR_MESSAGE, request->errorMessage());
+        addTimings(operation, request);
         sendOperation(operation);
     }
 }
@@ -199,4 +276,13 @@ bool UiServer::init()
     return d->init();
 }
 
+void UiServer::setBrowserPreWarming(bool enabled)
+{
+    Q_D(UiServer);
+    d->m_browserPreWarming = enabled;
+    if (!enabled) {
+        d->m_preWarmTimer.stop();
+    }
+}
+
 #include "ui-server.moc"
@@ -43,6 +43,10 @@ public:
 
     bool init();
 
+    /* When enabled, a browser dialog is prepared whenever the process is
+     * idle */
+    void setBrowserPreWarming(bool enabled);
+
 Q_SIGNALS:
     void finished();
 
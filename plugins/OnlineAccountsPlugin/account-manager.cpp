@@ -20,9 +20,223 @@
 
 #include "account-manager.h"
 
+#include <Accounts/Account>
+#include <Accounts/Application>
+#include <Accounts/Service>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QStandardPaths>
+#include <algorithm>
+
 using namespace OnlineAccountsUi;
 using namespace Accounts;
 
+namespace OnlineAccountsUi {
+
+class AccountManagerPrivate: public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PUBLIC(AccountManager)
+
+public:
+    AccountManagerPrivate(AccountManager *q);
+    ~AccountManagerPrivate();
+
+    void ensureCredentialsIndex();
+    void ensureServiceIndexes();
+
+private:
+    QByteArray definitionsStamp() const;
+    void indexAccount(AccountId accountId);
+    void unindexAccount(AccountId accountId);
+
+private Q_SLOTS:
+    void onAccountCreated(Accounts::AccountId accountId);
+    void onAccountRemoved(Accounts::AccountId accountId);
+    void onAccountUpdated(Accounts::AccountId accountId);
+
+private:
+    mutable AccountManager *q_ptr;
+    bool m_credentialsIndexIsValid;
+    /* Maps a signon identity to the accounts using it, and vice versa */
+    QHash<uint,QList<AccountId> > m_accountsByCredentials;
+    QHash<AccountId,uint> m_credentialsByAccount;
+    /* Service indexes, and the state of the definition files they were
+     * built from */
+    QByteArray m_serviceIndexesStamp;
+    QStringList m_providers;
+    QHash<QString,ServiceList> m_servicesByProvider;
+    QHash<QString,ServiceList> m_servicesByApplication;
+    QHash<QString,QStringList> m_applicationsByService;
+};
+
+} // namespace
+
+/* Mimic the lookup done by libaccounts-glib */
+static QStringList definitionDirs(const char *envVar, const QString &subDir)
+{
+    QByteArray envDir = qgetenv(envVar);
+    if (!envDir.isEmpty()) return QStringList(QFile::decodeName(envDir));
+
+    QStringList dirs;
+    Q_FOREACH(const QString &dataDir,
+              QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation)) {
+        dirs.append(dataDir + "/accounts/" + subDir);
+    }
+    return dirs;
+}
+
+static void appendDirectoryStamp(const QString &path, QByteArray &stamp)
+{
+    QDir dir(path);
+    if (!dir.exists()) return;
+
+    Q_FOREACH(const QFileInfo &fileInfo, dir.entryInfoList(QDir::Files)) {
+        stamp.append(QFile::encodeName(fileInfo.fileName()));
+        stamp.append(QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+        stamp.append(QByteArray::number(fileInfo.size()));
+        stamp.append('\0');
+    }
+}
+
+AccountManagerPrivate::AccountManagerPrivate(AccountManager *q):
+    QObject(q),
+    q_ptr(q),
+    m_credentialsIndexIsValid(false)
+{
+    QObject::connect(q, SIGNAL(accountCreated(Accounts::AccountId)),
+                     this, SLOT(onAccountCreated(Accounts::AccountId)));
+    QObject::connect(q, SIGNAL(accountRemoved(Accounts::AccountId)),
+                     this, SLOT(onAccountRemoved(Accounts::AccountId)));
+    QObject::connect(q, SIGNAL(accountUpdated(Accounts::AccountId)),
+                     this, SLOT(onAccountUpdated(Accounts::AccountId)));
+}
+
+AccountManagerPrivate::~AccountManagerPrivate()
+{
+}
+
+void AccountManagerPrivate::ensureCredentialsIndex()
+{
+    Q_Q(AccountManager);
+
+    if (m_credentialsIndexIsValid) return;
+
+    m_accountsByCredentials.clear();
+    m_credentialsByAccount.clear();
+    Q_FOREACH(AccountId accountId, q->accountList()) {
+        indexAccount(accountId);
+    }
+    m_credentialsIndexIsValid = true;
+}
+
+QByteArray AccountManagerPrivate::definitionsStamp() const
+{
+    /* libaccounts doesn't notify us about changes in the .service and
+     * .application files; listing their directories is still much cheaper
+     * than parsing them. */
+    QByteArray stamp("services:");
+    Q_FOREACH(const QString &path, definitionDirs("AG_SERVICES", "services")) {
+        appendDirectoryStamp(path, stamp);
+    }
+    stamp.append("applications:");
+    Q_FOREACH(const QString &path,
+              definitionDirs("AG_APPLICATIONS", "applications")) {
+        appendDirectoryStamp(path, stamp);
+    }
+    return stamp;
+}
+
+void AccountManagerPrivate::ensureServiceIndexes()
+{
+    Q_Q(AccountManager);
+
+    QByteArray stamp = definitionsStamp();
+    if (stamp == m_serviceIndexesStamp) return;
+
+    m_providers.clear();
+    m_servicesByProvider.clear();
+    m_servicesByApplication.clear();
+    m_applicationsByService.clear();
+
+    Q_FOREACH(const Service &service, q->serviceList()) {
+        QString providerId = service.provider();
+        if (!m_servicesByProvider.contains(providerId)) {
+            m_providers.append(providerId);
+        }
+        m_servicesByProvider[providerId].append(service);
+
+        QStringList &applicationIds = m_applicationsByService[service.name()];
+        Q_FOREACH(const Application &application,
+                  q->applicationList(service)) {
+            applicationIds.append(application.name());
+            m_servicesByApplication[application.name()].append(service);
+        }
+    }
+
+    m_serviceIndexesStamp = stamp;
+}
+
+void AccountManagerPrivate::indexAccount(AccountId accountId)
+{
+    Q_Q(AccountManager);
+
+    Account *account = q->account(accountId);
+    if (Q_UNLIKELY(account == 0)) return;
+
+    /* credentialsId() reads the setting of the selected service first;
+     * the account object is shared, so restore its selection afterwards */
+    Service selectedService = account->selectedService();
+    account->selectService();
+    uint credentialsId = account->credentialsId();
+    account->selectService(selectedService);
+    if (credentialsId == 0) return;
+
+    QList<AccountId> &accounts = m_accountsByCredentials[credentialsId];
+    QList<AccountId>::iterator i =
+        std::lower_bound(accounts.begin(), accounts.end(), accountId);
+    if (i == accounts.end() || *i != accountId) {
+        accounts.insert(i, accountId);
+    }
+    m_credentialsByAccount.insert(accountId, credentialsId);
+}
+
+void AccountManagerPrivate::unindexAccount(AccountId accountId)
+{
+    QHash<AccountId,uint>::iterator i = m_credentialsByAccount.find(accountId);
+    if (i == m_credentialsByAccount.end()) return;
+
+    QHash<uint,QList<AccountId> >::iterator j =
+        m_accountsByCredentials.find(i.value());
+    if (j != m_accountsByCredentials.end()) {
+        j.value().removeOne(accountId);
+        if (j.value().isEmpty()) m_accountsByCredentials.erase(j);
+    }
+    m_credentialsByAccount.erase(i);
+}
+
+void AccountManagerPrivate::onAccountCreated(Accounts::AccountId accountId)
+{
+    if (!m_credentialsIndexIsValid) return;
+    indexAccount(accountId);
+}
+
+void AccountManagerPrivate::onAccountRemoved(Accounts::AccountId accountId)
+{
+    if (!m_credentialsIndexIsValid) return;
+    unindexAccount(accountId);
+}
+
+void AccountManagerPrivate::onAccountUpdated(Accounts::AccountId accountId)
+{
+    if (!m_credentialsIndexIsValid) return;
+    /* The credentials might have been changed */
+    unindexAccount(accountId);
+    indexAccount(accountId);
+}
+
 AccountManager *AccountManager::m_instance = 0;
 
 AccountManager *AccountManager::instance()
@@ -40,10 +254,49 @@ AccountManager *AccountManager::instance()
 }
 
 AccountManager::AccountManager(QObject *parent):
-    Accounts::Manager(parent)
+    Accounts::Manager(parent),
+    d_ptr(new AccountManagerPrivate(this))
 {
 }
 
 AccountManager::~AccountManager()
 {
 }
+
+QList<AccountId> AccountManager::accountsForCredentials(uint credentialsId)
+{
+    Q_D(AccountManager);
+    d->ensureCredentialsIndex();
+    return d->m_accountsByCredentials.value(credentialsId);
+}
+
+QStringList AccountManager::serviceProviders()
+{
+    Q_D(AccountManager);
+    d->ensureServiceIndexes();
+    return d->m_providers;
+}
+
+ServiceList AccountManager::servicesForProvider(const QString &providerId)
+{
+    Q_D(AccountManager);
+    d->ensureServiceIndexes();
+    return d->m_servicesByProvider.value(providerId);
+}
+
+ServiceList
+AccountManager::servicesForApplication(const QString &applicationId)
+{
+    Q_D(AccountManager);
+    d->ensureServiceIndexes();
+    return d->m_servicesByApplication.value(applicationId);
+}
+
+QStringList AccountManager::applicationsForService(const QString &serviceId)
+{
+    Q_D(AccountManager);
+    d->ensureServiceIndexes();
+    return d->m_applicationsByService.value(serviceId);
+}
+
+#include "account-manager.moc"
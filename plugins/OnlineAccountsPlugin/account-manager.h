@@ -23,9 +23,12 @@
 
 #include "global.h"
 #include <Accounts/Manager>
+#include <QList>
+#include <QStringList>
 
 namespace OnlineAccountsUi {
 
+class AccountManagerPrivate;
 class OAP_EXPORT AccountManager: public Accounts::Manager
 {
     Q_OBJECT
@@ -33,12 +36,25 @@ class OAP_EXPORT AccountManager: public Accounts::Manager
 public:
     static AccountManager *instance();
 
+    /* Returns the accounts using the given signon identity, in ascending
+     * order of their ID */
+    QList<Accounts::AccountId> accountsForCredentials(uint credentialsId);
+
+    /* Lookups into the installed services; the indexes are rebuilt whenever
+     * the service or application files change */
+    QStringList serviceProviders();
+    Accounts::ServiceList servicesForProvider(const QString &providerId);
+    Accounts::ServiceList servicesForApplication(const QString &applicationId);
+    QStringList applicationsForService(const QString &serviceId);
+
 protected:
     explicit AccountManager(QObject *parent = 0);
     ~AccountManager();
 
 private:
     static AccountManager *m_instance;
+    AccountManagerPrivate *d_ptr;
+    Q_DECLARE_PRIVATE(AccountManager)
 };
 
 } // namespace
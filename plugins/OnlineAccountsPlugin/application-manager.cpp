@@ -21,18 +21,29 @@
 #include "account-manager.h"
 #include "application-manager.h"
 
+#include <QDateTime>
 #include <QDebug>
 #include <QDomDocument>
 #include <QDomElement>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QSettings>
 #include <QStandardPaths>
+#include <QXmlStreamReader>
 
 using namespace OnlineAccountsUi;
 
 ApplicationManager *ApplicationManager::m_instance = 0;
 
 namespace OnlineAccountsUi {
+
+struct CachedProfile {
+    QDateTime lastModified;
+    qint64 size;
+    QString profile;
+};
+
 class ApplicationManagerPrivate
 {
 public:
@@ -43,6 +54,13 @@ public:
                                    const QString &profile) const;
     static QString stripVersion(const QString &appId);
     static QString displayId(const QString &appId);
+
+private:
+    static QString readProfile(QFile &file);
+
+private:
+    /* Profiles read from the .application files, by application ID */
+    mutable QHash<QString,CachedProfile> m_profiles;
 };
 } // namespace
 
@@ -50,6 +68,22 @@ ApplicationManagerPrivate::ApplicationManagerPrivate()
 {
 }
 
+QString ApplicationManagerPrivate::readProfile(QFile &file)
+{
+    /* The profile is a direct child of the root element: there's no need to
+     * parse the rest of the file */
+    QXmlStreamReader reader(&file);
+    if (!reader.readNextStartElement()) return QString();
+
+    while (reader.readNextStartElement()) {
+        if (reader.name() == QStringLiteral("profile")) {
+            return reader.readElementText();
+        }
+        reader.skipCurrentElement();
+    }
+    return QString();
+}
+
 QString ApplicationManagerPrivate::applicationProfile(const QString &applicationId) const
 {
     /* We need to load the XML file and look for the "profile" element. The
@@ -57,10 +91,10 @@ QString ApplicationManagerPrivate::applicationProfile(const QString &application
      * added to the Accounts::Application class. */
     QString localShare =
         QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
-    QFile file(QString("%1/accounts/applications/%2.application").
-               arg(localShare).arg(applicationId));
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qDebug() << "file not found:" << file.fileName();
+    QFileInfo fileInfo(QString("%1/accounts/applications/%2.application").
+                       arg(localShare).arg(applicationId));
+    if (!fileInfo.exists()) {
+        qDebug() << "file not found:" << fileInfo.filePath();
         /* libaccounts would fall back to looking into /usr/share/accounts/,
          * but we know that .click packages don't install files in there, and
          * currently the profile information is only attached to click
@@ -68,12 +102,31 @@ QString ApplicationManagerPrivate::applicationProfile(const QString &application
          * ~/.local/share/accounts/, we can assume we won't find the profile
          * info anywhere.
          */
+        m_profiles.remove(applicationId);
+        return QString();
+    }
+
+    /* Don't parse the file again if it didn't change */
+    QDateTime lastModified = fileInfo.lastModified();
+    QHash<QString,CachedProfile>::const_iterator i =
+        m_profiles.constFind(applicationId);
+    if (i != m_profiles.constEnd() &&
+        i.value().lastModified == lastModified &&
+        i.value().size == fileInfo.size()) {
+        return i.value().profile;
+    }
+
+    QFile file(fileInfo.filePath());
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qDebug() << "cannot open file:" << file.fileName();
         return QString();
     }
-    QDomDocument doc;
-    doc.setContent(&file);
-    const QDomElement root = doc.documentElement();
-    return root.firstChildElement(QStringLiteral("profile")).text();
+
+    CachedProfile &cached = m_profiles[applicationId];
+    cached.lastModified = lastModified;
+    cached.size = fileInfo.size();
+    cached.profile = readProfile(file);
+    return cached.profile;
 }
 
 bool ApplicationManagerPrivate::applicationMatchesProfile(const Accounts::Application &application,
@@ -185,12 +238,10 @@ QVariantMap ApplicationManager::applicationInfo(const QString &claimedAppId,
 
     /* List all the services supported by this application */
     QVariantList serviceIds;
-    Accounts::ServiceList allServices =
-        AccountManager::instance()->serviceList();
-    Q_FOREACH(const Accounts::Service &service, allServices) {
-        if (!application.serviceUsage(service).isEmpty()) {
-            serviceIds.append(service.name());
-        }
+    Accounts::ServiceList services =
+        AccountManager::instance()->servicesForApplication(application.name());
+    Q_FOREACH(const Accounts::Service &service, services) {
+        serviceIds.append(service.name());
     }
     app.insert(QStringLiteral("services"), serviceIds);
 
@@ -225,14 +276,19 @@ QVariantMap ApplicationManager::providerInfo(const QString &providerId) const
 QStringList ApplicationManager::usefulProviders() const
 {
     AccountManager *manager = AccountManager::instance();
-    Accounts::ServiceList allServices = manager->serviceList();
     QStringList providers;
-    Q_FOREACH(const Accounts::Service &service, allServices) {
-        if (providers.contains(service.provider())) continue;
+    Q_FOREACH(const QString &providerId, manager->serviceProviders()) {
+        if (providerId == "ubuntuone") {
+            providers.append(providerId);
+            continue;
+        }
 
-        if (!manager->applicationList(service).isEmpty() ||
-            service.provider() == "ubuntuone") {
-            providers.append(service.provider());
+        Q_FOREACH(const Accounts::Service &service,
+                  manager->servicesForProvider(providerId)) {
+            if (!manager->applicationsForService(service.name()).isEmpty()) {
+                providers.append(providerId);
+                break;
+            }
         }
     }
     return providers;
@@ -22,6 +22,7 @@
 
 #include <QCoreApplication>
 #include <QDebug>
+#include <QHash>
 #include <QTcpServer>
 #include <QTcpSocket>
 
@@ -44,10 +45,12 @@ public:
 private Q_SLOTS:
     void onNewConnection();
     void onReadyRead();
+    void onDisconnected();
 
 private:
     int m_portIncrementAttempts;
-    QByteArray m_data;
+    /* Data received so far, for each connection */
+    QHash<QTcpSocket*,QByteArray> m_data;
     QByteArray m_servedHtml;
     LoopbackServer *q_ptr;
 };
@@ -105,6 +108,8 @@ void LoopbackServerPrivate::onNewConnection()
 {
     QTcpSocket *socket = nextPendingConnection();
     Q_ASSERT(socket);
+    QObject::connect(socket, &QTcpSocket::disconnected,
+                     this, &LoopbackServerPrivate::onDisconnected);
     QObject::connect(socket, &QTcpSocket::disconnected,
                      socket, &QTcpSocket::deleteLater);
     QObject::connect(socket, &QTcpSocket::readyRead,
@@ -118,13 +123,20 @@ void LoopbackServerPrivate::onReadyRead()
     QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
     Q_ASSERT(socket);
 
-    m_data += socket->readAll();
-    int lineLength = m_data.indexOf('\r');
+    QByteArray &data = m_data[socket];
+    data += socket->readAll();
+    int lineLength = data.indexOf('\r');
     if (lineLength < 0) {
         /* Not all data has been received; will get more later */
         return;
     }
-    QByteArray firstLine = m_data.left(lineLength);
+    QByteArray firstLine = data.left(lineLength);
+
+    /* Only the request line matters: ignore the rest of the request */
+    QObject::disconnect(socket, &QTcpSocket::readyRead,
+                        this, &LoopbackServerPrivate::onReadyRead);
+    m_data.remove(socket);
+
     QList<QByteArray> parts = firstLine.split(' ');
     if (parts.count() >= 2) {
         QString path = QString::fromUtf8(parts[1]);
@@ -137,6 +149,13 @@ void LoopbackServerPrivate::onReadyRead()
     socket->disconnectFromHost();
 }
 
+void LoopbackServerPrivate::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    Q_ASSERT(socket);
+    m_data.remove(socket);
+}
+
 LoopbackServer::LoopbackServer(QObject *parent):
     QObject(parent),
     d_ptr(new LoopbackServerPrivate(this))
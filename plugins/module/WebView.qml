@@ -8,6 +8,9 @@ ChromedWebView {
     property QtObject signonRequest
     property string userAgent
 
+    /* The context created by this view, as opposed to the default one */
+    property QtObject ownContext: null
+
     onNewViewRequested: {
         var popup = popupComponent.createObject(root, {
             "context": context,
@@ -27,12 +30,26 @@ ChromedWebView {
     }
 
     onSignonRequestChanged: if (signonRequest) {
+        /* The view might have been created before the request was known, so
+         * its initial context has no data path; since the data path of a
+         * context can't be changed once it's in use, replace the whole context
+         * with one storing its data in the identity's directory before loading
+         * any page */
+        if (!ownContext || ownContext.dataPath != signonRequest.rootDir) {
+            var unusedContext = ownContext
+            ownContext = contextComponent.createObject(root, {
+                "dataPath": signonRequest.rootDir,
+            })
+            context = ownContext
+            if (unusedContext) unusedContext.destroy()
+        }
         signonRequest.authenticated.connect(onAuthenticated)
         url = signonRequest.startUrl
     }
 
     onLoadingChanged: {
         console.log("Loading changed")
+        if (!signonRequest) return
         if (loading && !lastLoadFailed) {
             signonRequest.onLoadStarted()
         } else if (lastLoadSucceeded) {
@@ -41,11 +58,26 @@ ChromedWebView {
             signonRequest.onLoadFinished(false)
         }
     }
-    onUrlChanged: signonRequest.currentUrl = url
+    onUrlChanged: if (signonRequest) signonRequest.currentUrl = url
+
+    Connections {
+        target: signonRequest
+        onStartUrlChanged: root.url = signonRequest.startUrl
+        onReloadRequested: root.reload()
+    }
+
+    Component {
+        id: contextComponent
+        WebContext {
+            userAgent: root.userAgent ? root.userAgent : defaultUserAgent
+        }
+    }
 
-    context: WebContext {
-        dataPath: signonRequest ? signonRequest.rootDir : ""
-        userAgent: root.userAgent ? root.userAgent : defaultUserAgent
+    /* If the request is already known, the handler above has created the
+     * context; a placeholder is only needed for pre-warmed views */
+    Component.onCompleted: if (!ownContext) {
+        ownContext = contextComponent.createObject(root)
+        context = ownContext
     }
 
     function onAuthenticated() {
@@ -56,6 +56,24 @@ qml.files = $${QML_SOURCES}
 qml.path = $${PLUGIN_INSTALL_BASE}
 INSTALLS += qml
 
+# Install the compiled QML files next to their sources, where the QML engine
+# will pick them up instead of parsing the sources
+CONFIG(qml-aot) {
+    qtPrepareTool(QMLCACHEGEN, qmlcachegen)
+    qmlcache.input = QML_SOURCES
+    qmlcache.output = ${QMAKE_FILE_IN_BASE}${QMAKE_FILE_EXT}c
+    qmlcache.commands = $$QMLCACHEGEN ${QMAKE_FILE_IN} -o ${QMAKE_FILE_OUT}
+    qmlcache.CONFIG = no_link target_predeps
+    QMAKE_EXTRA_COMPILERS += qmlcache
+
+    for(qmlFile, QML_SOURCES) {
+        qmlc.files += $$OUT_PWD/$${qmlFile}c
+    }
+    qmlc.path = $${PLUGIN_INSTALL_BASE}
+    qmlc.CONFIG += no_check_exist
+    INSTALLS += qmlc
+}
+
 QMLDIR_FILES += qmldir
 QMAKE_SUBSTITUTES += qmldir.in
 OTHER_FILES += qmldir.in
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "acl-updater.h"
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QSignalSpy>
+#include <QStringList>
+#include <QTest>
+#include <SignOn/Identity>
+#include <SignOn/IdentityInfo>
+#include <libqtdbusmock/DBusMock.h>
+#include "fake_signond.h"
+
+class AclUpdaterTest: public QObject
+{
+    Q_OBJECT
+
+public:
+    AclUpdaterTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void testMaxPendingRequests();
+    void testInvalidRequests();
+    void testMerging();
+    void testSameIdentityNotConcurrent();
+    void testPendingLimit();
+    void testMissingIdentity();
+
+private:
+    void addIdentity(uint id, const QStringList &acl);
+    QStringList aclOf(uint id);
+
+private:
+    QtDBusTest::DBusTestRunner m_dbus;
+    QtDBusMock::DBusMock m_mock;
+    FakeSignond m_signond;
+};
+
+AclUpdaterTest::AclUpdaterTest():
+    QObject(0),
+    m_dbus(),
+    m_mock(m_dbus),
+    m_signond(&m_mock)
+{
+}
+
+void AclUpdaterTest::addIdentity(uint id, const QStringList &acl)
+{
+    QVariantMap info;
+    info["ACL"] = acl;
+    info["Id"] = id;
+    m_signond.addIdentity(id, info);
+}
+
+QStringList AclUpdaterTest::aclOf(uint id)
+{
+    SignOn::Identity *identity = SignOn::Identity::existingIdentity(id, this);
+    QSignalSpy gotInfo(identity, SIGNAL(info(const SignOn::IdentityInfo&)));
+    identity->queryInfo();
+    if (!gotInfo.wait()) return QStringList();
+
+    SignOn::IdentityInfo info =
+        gotInfo.at(0).at(0).value<SignOn::IdentityInfo>();
+    delete identity;
+    return info.accessControlList();
+}
+
+void AclUpdaterTest::initTestCase()
+{
+    qputenv("SSO_USE_PEER_BUS", "0");
+    m_dbus.startServices();
+}
+
+void AclUpdaterTest::testMaxPendingRequests()
+{
+    AclUpdater updater;
+    QCOMPARE(updater.maxPendingRequests(), 4);
+
+    updater.setMaxPendingRequests(10);
+    QCOMPARE(updater.maxPendingRequests(), 10);
+
+    /* At least one request must be allowed to run */
+    updater.setMaxPendingRequests(0);
+    QCOMPARE(updater.maxPendingRequests(), 1);
+}
+
+void AclUpdaterTest::testInvalidRequests()
+{
+    AclUpdater updater;
+    QSignalSpy finished(&updater, SIGNAL(finished()));
+
+    QVERIFY(!updater.removeApp("com.ubuntu.test_MyApp", 0));
+    QVERIFY(!updater.removeApp("noUnderscore", 3));
+    QVERIFY(updater.isIdle());
+
+    QTest::qWait(10);
+    QCOMPARE(finished.count(), 0);
+}
+
+void AclUpdaterTest::testMerging()
+{
+    addIdentity(10, QStringList() <<
+                "one" << "com.ubuntu.test_First_0.1" <<
+                "com.ubuntu.test_Second_0.2" << "two_click");
+
+    AclUpdater updater;
+    QSignalSpy credentialsUpdated(&updater,
+                                  SIGNAL(credentialsUpdated(uint,bool)));
+    QSignalSpy finished(&updater, SIGNAL(finished()));
+
+    /* Requests for the same credentials which have not been started yet
+     * are served by a single update */
+    QVERIFY(updater.removeApp("com.ubuntu.test_First", 10));
+    QVERIFY(updater.removeApp("com.ubuntu.test_Second", 10));
+    QVERIFY(updater.removeApp("com.ubuntu.test_First", 10));
+    QVERIFY(!updater.isIdle());
+
+    QVERIFY(finished.wait());
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(updater.isIdle());
+
+    QCOMPARE(credentialsUpdated.count(), 1);
+    QCOMPARE(credentialsUpdated.at(0).at(0).toUInt(), 10U);
+    QCOMPARE(credentialsUpdated.at(0).at(1).toBool(), true);
+
+    QCOMPARE(aclOf(10).toSet(),
+             (QStringList() << "one" << "two_click").toSet());
+}
+
+void AclUpdaterTest::testSameIdentityNotConcurrent()
+{
+    addIdentity(11, QStringList() <<
+                "com.ubuntu.test_First_0.1" << "com.ubuntu.test_Second_0.2" <<
+                "three");
+
+    AclUpdater updater;
+    QSignalSpy credentialsUpdated(&updater,
+                                  SIGNAL(credentialsUpdated(uint,bool)));
+    QSignalSpy finished(&updater, SIGNAL(finished()));
+
+    /* Let the first update start, then queue another one for the same
+     * identity: it must wait for the first one to complete, or the first
+     * change to the ACL would be overwritten */
+    QVERIFY(updater.removeApp("com.ubuntu.test_First", 11));
+    QCoreApplication::processEvents();
+    QVERIFY(updater.removeApp("com.ubuntu.test_Second", 11));
+
+    QVERIFY(finished.wait());
+    QCOMPARE(finished.count(), 1);
+
+    QCOMPARE(credentialsUpdated.count(), 2);
+    for (int i = 0; i < credentialsUpdated.count(); i++) {
+        QCOMPARE(credentialsUpdated.at(i).at(0).toUInt(), 11U);
+        QCOMPARE(credentialsUpdated.at(i).at(1).toBool(), true);
+    }
+
+    QCOMPARE(aclOf(11), QStringList() << "three");
+}
+
+void AclUpdaterTest::testPendingLimit()
+{
+    QList<uint> ids;
+    ids << 21 << 22 << 23 << 24;
+    Q_FOREACH(uint id, ids) {
+        addIdentity(id, QStringList() <<
+                    "com.ubuntu.test_First_0.1" << QString("app%1").arg(id));
+    }
+
+    AclUpdater updater;
+    updater.setMaxPendingRequests(1);
+    QSignalSpy credentialsUpdated(&updater,
+                                  SIGNAL(credentialsUpdated(uint,bool)));
+    QSignalSpy finished(&updater, SIGNAL(finished()));
+
+    Q_FOREACH(uint id, ids) {
+        QVERIFY(updater.removeApp("com.ubuntu.test_First", id));
+    }
+
+    QVERIFY(finished.wait());
+    QCOMPARE(finished.count(), 1);
+
+    /* With one request at a time, the updates complete in the order in
+     * which they were queued */
+    QCOMPARE(credentialsUpdated.count(), ids.count());
+    for (int i = 0; i < ids.count(); i++) {
+        QCOMPARE(credentialsUpdated.at(i).at(0).toUInt(), ids[i]);
+        QCOMPARE(credentialsUpdated.at(i).at(1).toBool(), true);
+    }
+
+    Q_FOREACH(uint id, ids) {
+        QCOMPARE(aclOf(id), QStringList() << QString("app%1").arg(id));
+    }
+}
+
+void AclUpdaterTest::testMissingIdentity()
+{
+    addIdentity(31, QStringList() << "com.ubuntu.test_First_0.1" << "other");
+
+    AclUpdater updater;
+    QSignalSpy credentialsUpdated(&updater,
+                                  SIGNAL(credentialsUpdated(uint,bool)));
+    QSignalSpy finished(&updater, SIGNAL(finished()));
+
+    /* A failure doesn't prevent the other updates from completing */
+    QVERIFY(updater.removeApp("com.ubuntu.test_First", 99));
+    QVERIFY(updater.removeApp("com.ubuntu.test_First", 31));
+
+    QVERIFY(finished.wait());
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(updater.isIdle());
+
+    QCOMPARE(credentialsUpdated.count(), 2);
+    QMap<uint,bool> results;
+    for (int i = 0; i < credentialsUpdated.count(); i++) {
+        results.insert(credentialsUpdated.at(i).at(0).toUInt(),
+                       credentialsUpdated.at(i).at(1).toBool());
+    }
+    QCOMPARE(results.value(99, true), false);
+    QCOMPARE(results.value(31, false), true);
+
+    QCOMPARE(aclOf(31), QStringList() << "other");
+}
+
+QTEST_GUILESS_MAIN(AclUpdaterTest);
+
+#include "tst_acl_updater.moc"
@@ -0,0 +1,35 @@
+include(../../common-project-config.pri)
+
+TARGET = tst_acl_updater
+
+CONFIG += \
+    debug \
+    link_pkgconfig
+
+QT += \
+    core \
+    dbus \
+    testlib
+
+PKGCONFIG += \
+    libqtdbusmock-1 \
+    libqtdbustest-1 \
+    libsignon-qt5
+
+DEFINES += \
+    QT_NO_KEYWORDS \
+    SIGNOND_MOCK_TEMPLATE=\\\"$${PWD}/signond.py\\\"
+
+INCLUDEPATH += \
+    $${TOP_SRC_DIR}/click-hooks
+
+SOURCES += \
+    $${TOP_SRC_DIR}/click-hooks/acl-updater.cpp \
+    tst_acl_updater.cpp
+
+HEADERS += \
+    $${TOP_SRC_DIR}/click-hooks/acl-updater.h
+
+check.commands = "./$${TARGET}"
+check.depends = $${TARGET}
+QMAKE_EXTRA_TARGETS += check
@@ -25,6 +25,8 @@
 #include <QDomDocument>
 #include <QDomElement>
 #include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QProcess>
 #include <QRegularExpression>
 #include <QSignalSpy>
@@ -36,6 +38,7 @@
 #include "fake_signond.h"
 
 #define TEST_DIR "/tmp/hooks-test2"
+#define STATE_FILE ".processed-hooks.json"
 
 namespace QTest {
 template<>
@@ -73,24 +76,33 @@ private Q_SLOTS:
     void testValidHooks();
     void testRemoval();
     void testRemovalWithAcl();
+    void testRemovalWithSharedAcl();
     void testTimestampRemoval();
+    void testStaleOutputRemoval();
+    void benchmarkProcessing_data();
+    void benchmarkProcessing();
 
 private:
     void clearHooksDir();
     void clearInstallDir();
     void clearPackageDir();
+    void startSignond();
     bool runHookProcess();
     bool runXmlDiff(const QString &generated, const QString &expected);
     void writeHookFile(const QString &name, const QString &contents);
     void writeInstalledFile(const QString &name, const QString &contents);
     void writePackageFile(const QString &name,
                           const QString &contents = QString());
+    void writeInstalledApp(const QString &shortAppId);
+    QStringList aclOf(uint credentialsId);
     QStringList findGeneratedFiles() const;
+    QJsonObject readProcessedHooks() const;
 
 private:
     QtDBusTest::DBusTestRunner m_dbus;
     QtDBusMock::DBusMock m_mock;
     FakeSignond m_signond;
+    bool m_signondStarted;
     QByteArray m_busAddress;
     QDir m_testDir;
     QDir m_hooksDir;
@@ -103,6 +115,7 @@ OnlineAccountsHooksTest::OnlineAccountsHooksTest():
     m_dbus(),
     m_mock(m_dbus),
     m_signond(&m_mock),
+    m_signondStarted(false),
     m_testDir(TEST_DIR),
     m_hooksDir(TEST_DIR "/online-accounts-hooks2"),
     m_installDir(TEST_DIR "/accounts"),
@@ -129,6 +142,15 @@ void OnlineAccountsHooksTest::clearPackageDir()
     m_packageDir.mkpath(".");
 }
 
+void OnlineAccountsHooksTest::startSignond()
+{
+    if (m_signondStarted) return;
+
+    qputenv("DBUS_SESSION_BUS_ADDRESS", m_busAddress);
+    m_dbus.startServices();
+    m_signondStarted = true;
+}
+
 bool OnlineAccountsHooksTest::runHookProcess()
 {
     QProcess process;
@@ -213,11 +235,64 @@ static QStringList findFiles(const QDir &dir)
     return files;
 }
 
+/* Writes the .application and .service files which the hook would have
+ * generated for an application having a service for the "example" provider */
+void OnlineAccountsHooksTest::writeInstalledApp(const QString &shortAppId)
+{
+    QString profile = shortAppId + "_3.0";
+    QString serviceId = shortAppId + "_example";
+    writeInstalledFile("applications/" + shortAppId + ".application",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+        "<!--this file is auto-generated by online-accounts-hooks2; do not modify-->\n"
+        "<application id=\"" + shortAppId + "\">\n"
+        "  <description>My application</description>\n"
+        "  <services>\n"
+        "    <service id=\"" + serviceId + "\">\n"
+        "      <description>Publish somewhere</description>\n"
+        "    </service>\n"
+        "  </services>\n"
+        "  <profile>" + profile + "</profile>\n"
+        "</application>");
+    writeInstalledFile("services/" + serviceId + ".service",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+        "<!--this file is auto-generated by online-accounts-hooks2; do not modify-->\n"
+        "<service id=\"" + serviceId + "\">\n"
+        "  <name>Hello world</name>\n"
+        "  <type>" + shortAppId + "</type>\n"
+        "  <provider>example</provider>\n"
+        "  <description>My application</description>\n"
+        "  <profile>" + profile + "</profile>\n"
+        "</service>");
+}
+
+QStringList OnlineAccountsHooksTest::aclOf(uint credentialsId)
+{
+    SignOn::Identity *identity =
+        SignOn::Identity::existingIdentity(credentialsId, this);
+    QSignalSpy gotInfo(identity, SIGNAL(info(const SignOn::IdentityInfo&)));
+    identity->queryInfo();
+    if (!gotInfo.wait()) return QStringList();
+
+    SignOn::IdentityInfo info =
+        gotInfo.at(0).at(0).value<SignOn::IdentityInfo>();
+    delete identity;
+    return info.accessControlList();
+}
+
 QStringList OnlineAccountsHooksTest::findGeneratedFiles() const
 {
     return findFiles(m_installDir);
 }
 
+QJsonObject OnlineAccountsHooksTest::readProcessedHooks() const
+{
+    QFile file(m_hooksDir.filePath(STATE_FILE));
+    if (!file.open(QIODevice::ReadOnly)) return QJsonObject();
+
+    QJsonObject state = QJsonDocument::fromJson(file.readAll()).object();
+    return state.value("hooks").toObject();
+}
+
 void OnlineAccountsHooksTest::initTestCase()
 {
     qputenv("XDG_DATA_HOME", TEST_DIR);
@@ -748,8 +823,7 @@ void OnlineAccountsHooksTest::testRemoval()
 
 void OnlineAccountsHooksTest::testRemovalWithAcl()
 {
-    qputenv("DBUS_SESSION_BUS_ADDRESS", m_busAddress);
-    m_dbus.startServices();
+    startSignond();
 
     QString myApp("applications/com.ubuntu.test_MyAcl.application");
     writeInstalledFile(myApp,
@@ -821,10 +895,90 @@ void OnlineAccountsHooksTest::testRemovalWithAcl()
     QCOMPARE(info.accessControlList().toSet(), expectedAcl.toSet());
 }
 
+void OnlineAccountsHooksTest::testRemovalWithSharedAcl()
+{
+    startSignond();
+
+    QStringList apps;
+    apps << "com-ubuntu.test_SharedOne" << "com-ubuntu.test_SharedTwo";
+    Q_FOREACH(const QString &app, apps) {
+        writeInstalledApp(app);
+    }
+
+    /* Accounts 1 and 2 share the same credentials, and have both services
+     * enabled; account 3 has its own credentials and only the first service
+     * enabled; account 4 has no services enabled. */
+    struct {
+        uint credentialsId;
+        QStringList enabledApps;
+    } accountData[] = {
+        { 40, apps },
+        { 40, apps },
+        { 41, QStringList() << apps[0] },
+        { 42, QStringList() },
+    };
+
+    Accounts::Manager manager;
+    QHash<QString,Accounts::Service> services;
+    Q_FOREACH(const QString &app, apps) {
+        Accounts::Service service = manager.service(app + "_example");
+        QVERIFY(service.isValid());
+        services.insert(app, service);
+    }
+
+    QList<Accounts::Account*> accounts;
+    for (uint i = 0; i < sizeof(accountData) / sizeof(accountData[0]); i++) {
+        Accounts::Account *account = manager.createAccount("example");
+        account->setDisplayName(QString("Account %1").arg(i));
+        account->setEnabled(true);
+        account->setCredentialsId(accountData[i].credentialsId);
+        Q_FOREACH(const QString &app, accountData[i].enabledApps) {
+            account->selectService(services[app]);
+            account->setEnabled(true);
+        }
+        account->syncAndBlock();
+        QVERIFY(account->id() > 0);
+        accounts.append(account);
+    }
+
+    QStringList initialAcl;
+    initialAcl << "one" <<
+        "com-ubuntu.test_SharedOne_0.1" <<
+        "com-ubuntu.test_SharedTwo_0.1" <<
+        "two_click";
+    for (uint id = 40; id <= 42; id++) {
+        QVariantMap initialInfo;
+        initialInfo["ACL"] = initialAcl;
+        initialInfo["Id"] = id;
+        m_signond.addIdentity(id, initialInfo);
+    }
+
+    /* Both applications are removed: each of them must be removed from the
+     * ACL of the credentials of the accounts where they were enabled, without
+     * the updates of the shared credentials overwriting each other */
+    QVERIFY(runHookProcess());
+
+    Q_FOREACH(Accounts::Account *account, accounts) {
+        Q_FOREACH(const Accounts::Service &service, services) {
+            account->selectService(service);
+            QTRY_COMPARE(account->isEnabled(), false);
+        }
+    }
+
+    QCOMPARE(aclOf(40).toSet(),
+             (QStringList() << "one" << "two_click").toSet());
+    QCOMPARE(aclOf(41).toSet(),
+             (QStringList() << "one" << "com-ubuntu.test_SharedTwo_0.1" <<
+              "two_click").toSet());
+    QCOMPARE(aclOf(42).toSet(), initialAcl.toSet());
+}
+
 void OnlineAccountsHooksTest::testTimestampRemoval()
 {
+    /* The timestamp files written by older versions must be removed */
     QString stillInstalled("com-ubuntu.test_MyApp_2.0.accounts");
-    writeHookFile(stillInstalled, "{}");
+    writeHookFile(stillInstalled,
+                  "{ \"services\": [{ \"provider\": \"example\" }]}");
     QString stillInstalledTimestamp("com-ubuntu.test_MyApp_2.0.accounts.processed");
     writeHookFile(stillInstalledTimestamp, "");
     QString oldTimestamp("com-ubuntu.test_MyApp_1.0.accounts.processed");
@@ -837,10 +991,90 @@ void OnlineAccountsHooksTest::testTimestampRemoval()
     QVERIFY(runHookProcess());
 
     QVERIFY(m_hooksDir.exists(stillInstalled));
-    QVERIFY(m_hooksDir.exists(stillInstalledTimestamp));
+    QVERIFY(!m_hooksDir.exists(stillInstalledTimestamp));
     QVERIFY(!m_hooksDir.exists(oldTimestamp));
     QVERIFY(!m_hooksDir.exists(staleTimestamp1));
     QVERIFY(!m_hooksDir.exists(staleTimestamp2));
+
+    /* The hook file has been processed and recorded in the state file */
+    QJsonObject hooks = readProcessedHooks();
+    QCOMPARE(hooks.keys(), QStringList() << stillInstalled);
+    QJsonObject hook = hooks.value(stillInstalled).toObject();
+    QVERIFY(!hook.value("hash").toString().isEmpty());
+    QCOMPARE(hook.value("outputFiles").toVariant().toStringList().toSet(),
+             findGeneratedFiles().toSet());
+}
+
+void OnlineAccountsHooksTest::testStaleOutputRemoval()
+{
+    QString oldVersion("com-ubuntu.test_MyApp_1.0.accounts");
+    writeHookFile(oldVersion,
+                  "{ \"services\": ["
+                  "  { \"provider\": \"example\" },"
+                  "  { \"provider\": \"other\" }"
+                  "]}");
+    QVERIFY(runHookProcess());
+
+    QStringList expectedFiles;
+    expectedFiles <<
+        "applications/com-ubuntu.test_MyApp.application" <<
+        "services/com-ubuntu.test_MyApp_example.service" <<
+        "services/com-ubuntu.test_MyApp_other.service";
+    QCOMPARE(findGeneratedFiles().toSet(), expectedFiles.toSet());
+
+    /* Upgrade the application: the new version drops one service */
+    QVERIFY(m_hooksDir.remove(oldVersion));
+    QString newVersion("com-ubuntu.test_MyApp_2.0.accounts");
+    writeHookFile(newVersion,
+                  "{ \"services\": [{ \"provider\": \"example\" }]}");
+    QVERIFY(runHookProcess());
+
+    expectedFiles.removeAll("services/com-ubuntu.test_MyApp_other.service");
+    QCOMPARE(findGeneratedFiles().toSet(), expectedFiles.toSet());
+    QCOMPARE(readProcessedHooks().keys(), QStringList() << newVersion);
+
+    /* Uninstall it */
+    QVERIFY(m_hooksDir.remove(newVersion));
+    QVERIFY(runHookProcess());
+
+    QVERIFY(findGeneratedFiles().isEmpty());
+    QVERIFY(readProcessedHooks().isEmpty());
+}
+
+void OnlineAccountsHooksTest::benchmarkProcessing_data()
+{
+    QTest::addColumn<int>("hookCount");
+    QTest::addColumn<QString>("workerThreads");
+
+    QTest::newRow("50, sequential") << 50 << "1";
+    QTest::newRow("50, parallel") << 50 << "";
+    QTest::newRow("500, sequential") << 500 << "1";
+    QTest::newRow("500, parallel") << 500 << "";
+}
+
+void OnlineAccountsHooksTest::benchmarkProcessing()
+{
+    QFETCH(int, hookCount);
+    QFETCH(QString, workerThreads);
+
+    for (int i = 0; i < hookCount; i++) {
+        writeHookFile(QString("com.ubuntu.test%1_MyApp_0.1.accounts").arg(i),
+                      QString("{ \"services\": [{"
+                              "  \"provider\": \"myProvider\","
+                              "  \"name\": \"Service %1\""
+                              "}]}").arg(i));
+    }
+
+    qputenv("OAH_WORKER_THREADS", workerThreads.toUtf8());
+    bool ok = false;
+    QBENCHMARK_ONCE {
+        ok = runHookProcess();
+    }
+    qunsetenv("OAH_WORKER_THREADS");
+    QVERIFY(ok);
+
+    QCOMPARE(readProcessedHooks().count(), hookCount);
+    QCOMPARE(findGeneratedFiles().count(), hookCount * 2);
 }
 
 QTEST_GUILESS_MAIN(OnlineAccountsHooksTest);
@@ -118,6 +118,21 @@ int Request::delay() const
     return d->m_delay;
 }
 
+void Request::refresh(const QDBusMessage &message,
+                      const QVariantMap &parameters)
+{
+    Q_D(Request);
+    Q_UNUSED(message);
+
+    QMapIterator<QString, QVariant> it(parameters);
+    while (it.hasNext()) {
+        it.next();
+        d->m_parameters.insert(it.key(), it.value());
+    }
+
+    Q_EMIT refreshed(parameters);
+}
+
 void Request::cancel()
 {
     setCanceled();
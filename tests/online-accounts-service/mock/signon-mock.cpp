@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "signon-mock.h"
+
+#include <QTimer>
+
+/* How long the mocked signond takes to process an authentication */
+#define PROCESSING_TIME 20
+
+using namespace SignOn;
+
+static SignOnMock *m_instance = 0;
+
+SignOnMock::SignOnMock():
+    m_activeSessions(0),
+    m_maxActiveSessions(0)
+{
+}
+
+SignOnMock *SignOnMock::instance()
+{
+    if (!m_instance) {
+        m_instance = new SignOnMock;
+    }
+    return m_instance;
+}
+
+void SignOnMock::reset()
+{
+    m_transientFailures.clear();
+    m_processedIdentities.clear();
+    m_activeSessions = 0;
+    m_maxActiveSessions = 0;
+}
+
+AuthSession::AuthSession(quint32 identity, const QString &method,
+                         QObject *parent):
+    QObject(parent),
+    m_identity(identity),
+    m_isProcessing(false)
+{
+    Q_UNUSED(method);
+}
+
+AuthSession::~AuthSession()
+{
+    if (m_isProcessing) {
+        SignOnMock::instance()->m_activeSessions--;
+    }
+}
+
+void AuthSession::process(const SessionData &sessionData,
+                          const QString &mechanism)
+{
+    Q_UNUSED(sessionData);
+    Q_UNUSED(mechanism);
+
+    SignOnMock *mock = SignOnMock::instance();
+    mock->m_processedIdentities.append(m_identity);
+    mock->m_activeSessions++;
+    mock->m_maxActiveSessions = qMax(mock->m_maxActiveSessions,
+                                     mock->m_activeSessions);
+    m_isProcessing = true;
+    QTimer::singleShot(PROCESSING_TIME, this, SLOT(reply()));
+}
+
+void AuthSession::reply()
+{
+    SignOnMock *mock = SignOnMock::instance();
+    mock->m_activeSessions--;
+    m_isProcessing = false;
+
+    int &failures = mock->m_transientFailures[m_identity];
+    if (failures > 0) {
+        failures--;
+        Q_EMIT error(Error(Error::Network, "Network is down"));
+    } else {
+        QVariantMap reply;
+        reply.insert("AccessToken", "a token");
+        Q_EMIT response(SessionData(reply));
+    }
+}
+
+Identity::Identity(quint32 id, QObject *parent):
+    QObject(parent),
+    m_id(id)
+{
+}
+
+Identity *Identity::existingIdentity(quint32 id, QObject *parent)
+{
+    return new Identity(id, parent);
+}
+
+AuthSession *Identity::createSession(const QString &methodName)
+{
+    return new AuthSession(m_id, methodName, this);
+}
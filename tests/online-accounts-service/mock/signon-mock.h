@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOCK_SIGNON_H
+#define MOCK_SIGNON_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+namespace SignOn {
+
+class SessionData
+{
+public:
+    SessionData(const QVariantMap &data = QVariantMap()): m_data(data) {}
+    QVariantMap toMap() const { return m_data; }
+
+private:
+    QVariantMap m_data;
+};
+
+class Error
+{
+public:
+    enum ErrorType {
+        Unknown = 1,
+        NoConnection = 307,
+        Network = 308,
+        TimedOut = 312,
+        UserInteraction = 313
+    };
+
+    Error(int type = Unknown, const QString &message = QString()):
+        m_type(type), m_message(message) {}
+    int type() const { return m_type; }
+    QString message() const { return m_message; }
+
+private:
+    int m_type;
+    QString m_message;
+};
+
+class AuthSession: public QObject
+{
+    Q_OBJECT
+
+public:
+    AuthSession(quint32 identity, const QString &method, QObject *parent);
+    ~AuthSession();
+
+    void process(const SessionData &sessionData,
+                 const QString &mechanism = QString());
+
+Q_SIGNALS:
+    void error(const SignOn::Error &err);
+    void response(const SignOn::SessionData &sessionData);
+
+private Q_SLOTS:
+    void reply();
+
+private:
+    quint32 m_identity;
+    bool m_isProcessing;
+};
+
+class Identity: public QObject
+{
+    Q_OBJECT
+
+public:
+    static Identity *existingIdentity(quint32 id, QObject *parent = 0);
+    AuthSession *createSession(const QString &methodName);
+
+private:
+    Identity(quint32 id, QObject *parent);
+    quint32 m_id;
+};
+
+} // namespace
+
+/* Controls the behaviour of the mocked signond */
+class SignOnMock
+{
+public:
+    static SignOnMock *instance();
+
+    void reset();
+
+    /* The next "count" authentications of the given identity fail with a
+     * network error */
+    void setTransientFailures(quint32 identity, int count) {
+        m_transientFailures[identity] = count;
+    }
+
+    int maxActiveSessions() const { return m_maxActiveSessions; }
+    QList<quint32> processedIdentities() const {
+        return m_processedIdentities;
+    }
+
+private:
+    friend class SignOn::AuthSession;
+    SignOnMock();
+
+    QHash<quint32,int> m_transientFailures;
+    QList<quint32> m_processedIdentities;
+    int m_activeSessions;
+    int m_maxActiveSessions;
+};
+
+#endif // MOCK_SIGNON_H
@@ -1,7 +1,9 @@
 TEMPLATE = subdirs
 SUBDIRS = \
     tst_inactivity_timer.pro \
+    tst_indicator_service.pro \
     tst_libaccounts_service.pro \
+    tst_reauthenticator.pro \
     tst_service.pro \
     tst_signonui_service.pro \
     tst_ui_proxy.pro
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "indicator-service.h"
+#include "signon-mock.h"
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTest>
+
+using namespace SignOnUi;
+
+class PropertiesListener: public QObject
+{
+    Q_OBJECT
+
+public:
+    PropertiesListener(): QObject() {
+        QDBusConnection::sessionBus().connect(QString(),
+            WEBCREDENTIALS_OBJECT_PATH,
+            "org.freedesktop.DBus.Properties",
+            "PropertiesChanged",
+            this,
+            SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+    }
+
+    QVariantMap lastChanges;
+
+Q_SIGNALS:
+    void propertiesChanged();
+
+private Q_SLOTS:
+    void onPropertiesChanged(const QString &interface,
+                             const QVariantMap &changed,
+                             const QStringList &invalidated) {
+        Q_UNUSED(invalidated);
+        if (interface != WEBCREDENTIALS_INTERFACE) return;
+        lastChanges = changed;
+        Q_EMIT propertiesChanged();
+    }
+};
+
+static QString journalPath()
+{
+    return QStandardPaths::writableLocation(
+        QStandardPaths::GenericDataLocation) +
+        QStringLiteral("/online-accounts-service/failures");
+}
+
+/* How a string would appear in a file written with QDataStream */
+static QByteArray serialized(const QString &string)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << string;
+    return data.mid(sizeof(quint32));
+}
+
+static QVariantMap failureNotification(quint32 identity,
+                                       const QVariantMap &clientData)
+{
+    QVariantMap notification;
+    notification.insert("DisplayName", "Bob");
+    notification.insert("ClientData", clientData);
+    notification.insert("Identity", identity);
+    notification.insert("Method", "oauth2");
+    notification.insert("Mechanism", "web_server");
+    return notification;
+}
+
+class IndicatorServiceTest: public QObject
+{
+    Q_OBJECT
+
+public:
+    IndicatorServiceTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void testBurst();
+    void testDelay();
+    void testJournal();
+    void testJournalRestore();
+    void testReauthenticateDuplicates();
+    void testReauthenticateAccounts();
+
+private:
+    QDBusMessage reauthenticateAccounts(const QSet<uint> &accountIds);
+
+private:
+    IndicatorService *m_service;
+    PropertiesListener *m_listener;
+    QDBusConnection m_conn;
+};
+
+IndicatorServiceTest::IndicatorServiceTest():
+    QObject(0),
+    m_service(0),
+    m_listener(0),
+    m_conn(QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+                                         "caller"))
+{
+}
+
+QDBusMessage
+IndicatorServiceTest::reauthenticateAccounts(const QSet<uint> &accountIds)
+{
+    QDBusMessage msg =
+        QDBusMessage::createMethodCall(WEBCREDENTIALS_BUS_NAME,
+                                       WEBCREDENTIALS_OBJECT_PATH,
+                                       WEBCREDENTIALS_INTERFACE,
+                                       "ReauthenticateAccounts");
+    msg << QVariant::fromValue(accountIds) << QVariantMap();
+
+    /* The service lives in this same process, so we must not block */
+    QDBusPendingCallWatcher watcher(m_conn.asyncCall(msg));
+    QSignalSpy finished(&watcher,
+                        SIGNAL(finished(QDBusPendingCallWatcher*)));
+    if (!finished.wait()) return QDBusMessage();
+    return watcher.reply();
+}
+
+void IndicatorServiceTest::initTestCase()
+{
+    /* Don't touch the user's failure journal */
+    QStandardPaths::setTestModeEnabled(true);
+    QFile::remove(journalPath());
+
+    m_service = new IndicatorService(this);
+    QDBusConnection conn = QDBusConnection::sessionBus();
+    conn.registerObject(WEBCREDENTIALS_OBJECT_PATH,
+                        m_service->serviceObject());
+    conn.registerService(WEBCREDENTIALS_BUS_NAME);
+
+    m_listener = new PropertiesListener;
+}
+
+void IndicatorServiceTest::init()
+{
+    QSignalSpy propertiesChanged(m_listener, SIGNAL(propertiesChanged()));
+
+    SignOnMock::instance()->reset();
+    m_service->setPropertiesChangedDelay(0);
+    if (!m_service->failures().isEmpty() || m_service->errorStatus()) {
+        m_service->removeFailures(m_service->failures());
+        m_service->clearErrorStatus();
+        QVERIFY(propertiesChanged.wait());
+    }
+}
+
+void IndicatorServiceTest::testBurst()
+{
+    QSignalSpy propertiesChanged(m_listener, SIGNAL(propertiesChanged()));
+
+    QVariantMap notification;
+    notification.insert("DisplayName", "Bob");
+    for (uint accountId = 1; accountId <= 50; accountId++) {
+        m_service->reportFailure(accountId, notification);
+    }
+
+    QVERIFY(propertiesChanged.wait());
+    /* Make sure that no other signals arrive */
+    QTest::qWait(100);
+    QCOMPARE(propertiesChanged.count(), 1);
+
+    QVariantMap changes = m_listener->lastChanges;
+    QCOMPARE(changes.value("ErrorStatus").toBool(), true);
+    QList<uint> failures =
+        qdbus_cast<QList<uint> >(changes.value("Failures"));
+    QCOMPARE(failures.count(), 50);
+    QCOMPARE(failures.toSet(), m_service->failures());
+}
+
+void IndicatorServiceTest::testDelay()
+{
+    QSignalSpy propertiesChanged(m_listener, SIGNAL(propertiesChanged()));
+
+    m_service->setPropertiesChangedDelay(200);
+
+    QVariantMap notification;
+    m_service->reportFailure(3, notification);
+    QTest::qWait(50);
+    m_service->reportFailure(4, notification);
+    QTest::qWait(50);
+    QCOMPARE(propertiesChanged.count(), 0);
+
+    QVERIFY(propertiesChanged.wait());
+    QTest::qWait(100);
+    QCOMPARE(propertiesChanged.count(), 1);
+
+    QList<uint> failures =
+        qdbus_cast<QList<uint> >(m_listener->lastChanges.value("Failures"));
+    QCOMPARE(failures.toSet(), QSet<uint>() << 3 << 4);
+}
+
+void IndicatorServiceTest::testJournal()
+{
+    QVariantMap clientData;
+    clientData.insert("UserName", "bob");
+    clientData.insert("ClientId", "ThisIsMyApp");
+    clientData.insert("ClientSecret", "VerySecret");
+    m_service->reportFailure(5, failureNotification(9, clientData));
+    QTRY_VERIFY(QFile::exists(journalPath()));
+
+    /* Only the user can access the journal */
+    QFile::Permissions permissions = QFile::permissions(journalPath());
+    QVERIFY(permissions & QFile::ReadOwner);
+    QVERIFY(permissions & QFile::WriteOwner);
+    QCOMPARE(int(permissions & (QFile::ReadGroup | QFile::WriteGroup |
+                                QFile::ExeGroup | QFile::ReadOther |
+                                QFile::WriteOther | QFile::ExeOther)), 0);
+
+    /* None of the authentication data is written to disk */
+    QFile file(journalPath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray contents = file.readAll();
+    QVERIFY(!contents.isEmpty());
+    Q_FOREACH(const QVariant &value, clientData) {
+        QVERIFY(!contents.contains(serialized(value.toString())));
+    }
+    QVERIFY(!contents.contains(serialized("oauth2")));
+    file.close();
+
+    /* When no failures are left, the journal is removed */
+    m_service->removeFailures(QSet<uint>() << 5);
+    m_service->clearErrorStatus();
+    QTRY_VERIFY(!QFile::exists(journalPath()));
+}
+
+void IndicatorServiceTest::testJournalRestore()
+{
+    QVariantMap clientData;
+    clientData.insert("UserName", "bob");
+    m_service->reportFailure(5, failureNotification(9, clientData));
+    m_service->reportFailure(6, QVariantMap());
+    QVERIFY(!m_service->isIdle());
+    QTRY_VERIFY(QFile::exists(journalPath()));
+
+    /* Simulate a restart of the service */
+    IndicatorService restored;
+    QCOMPARE(restored.failures(), QSet<uint>() << 5 << 6);
+    QCOMPARE(restored.errorStatus(), true);
+
+    /* The restored failures don't keep the service alive */
+    QVERIFY(restored.isIdle());
+
+    /* ...and cannot be replayed, since the authentication data is lost */
+    bool reauthenticating = true;
+    QVERIFY(QMetaObject::invokeMethod(restored.serviceObject(),
+                                      "ReauthenticateAccount",
+                                      Q_RETURN_ARG(bool, reauthenticating),
+                                      Q_ARG(uint, 5),
+                                      Q_ARG(QVariantMap, QVariantMap())));
+    QCOMPARE(reauthenticating, false);
+    QTest::qWait(50);
+    QVERIFY(SignOnMock::instance()->processedIdentities().isEmpty());
+
+    /* A new failure is not idle anymore */
+    QSignalSpy isIdleChanged(&restored, SIGNAL(isIdleChanged()));
+    restored.reportFailure(5, failureNotification(9, clientData));
+    QCOMPARE(isIdleChanged.count(), 1);
+    QVERIFY(!restored.isIdle());
+
+    restored.removeFailures(QSet<uint>() << 5);
+    QCOMPARE(isIdleChanged.count(), 2);
+    QVERIFY(restored.isIdle());
+    QCOMPARE(restored.failures(), QSet<uint>() << 6);
+
+    restored.removeFailures(restored.failures());
+    restored.clearErrorStatus();
+}
+
+void IndicatorServiceTest::testReauthenticateDuplicates()
+{
+    QVariantMap clientData;
+    clientData.insert("UserName", "bob");
+
+    /* The same authentication failing twice is replayed only once */
+    m_service->reportFailure(5, failureNotification(9, clientData));
+    m_service->reportFailure(5, failureNotification(9, clientData));
+
+    QDBusMessage reply = reauthenticateAccounts(QSet<uint>() << 5);
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QList<uint> reauthenticated =
+        qdbus_cast<QList<uint> >(reply.arguments().at(0));
+    QCOMPARE(reauthenticated, QList<uint>() << 5);
+
+    QCOMPARE(SignOnMock::instance()->processedIdentities(),
+             QList<quint32>() << 9);
+    QVERIFY(m_service->failures().isEmpty());
+    QVERIFY(m_service->isIdle());
+}
+
+void IndicatorServiceTest::testReauthenticateAccounts()
+{
+    QSet<uint> accountIds;
+    for (uint accountId = 1; accountId <= 7; accountId++) {
+        QVariantMap clientData;
+        clientData.insert("UserName", "bob");
+        m_service->reportFailure(accountId,
+                                 failureNotification(100 + accountId,
+                                                     clientData));
+        accountIds.insert(accountId);
+    }
+    /* This one cannot be replayed */
+    m_service->reportFailure(8, QVariantMap());
+
+    QDBusMessage reply =
+        reauthenticateAccounts(QSet<uint>(accountIds) << 8);
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QList<uint> reauthenticated =
+        qdbus_cast<QList<uint> >(reply.arguments().at(0));
+    QCOMPARE(reauthenticated.toSet(), accountIds);
+
+    /* All accounts have been processed, but never more than three at a
+     * time */
+    QCOMPARE(SignOnMock::instance()->processedIdentities().count(), 7);
+    QCOMPARE(SignOnMock::instance()->maxActiveSessions(), 3);
+    QCOMPARE(m_service->failures(), QSet<uint>() << 8);
+}
+
+QTEST_MAIN(IndicatorServiceTest);
+
+#include "tst_indicator_service.moc"
@@ -0,0 +1,48 @@
+include(../../common-project-config.pri)
+
+TARGET = tst_indicator_service
+
+CONFIG += \
+    debug
+
+QT += \
+    core \
+    dbus \
+    testlib
+
+DEFINES += \
+    SIGNONUI_I18N_DOMAIN=\\\"$${SIGNONUI_I18N_DOMAIN}\\\"
+
+ONLINE_ACCOUNTS_SERVICE_DIR = $${TOP_SRC_DIR}/online-accounts-service
+COMMON_SRC_DIR = $${TOP_SRC_DIR}/online-accounts-ui
+COMMON_MOCK_DIR = $${TOP_SRC_DIR}/tests/online-accounts-ui/mock
+
+SOURCES += \
+    $${TOP_BUILD_DIR}/online-accounts-service/webcredentials_adaptor.cpp \
+    $${COMMON_MOCK_DIR}/notification-mock.cpp \
+    $${COMMON_SRC_DIR}/debug.cpp \
+    $${COMMON_SRC_DIR}/i18n.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/indicator-service.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/reauthenticator.cpp \
+    mock/signon-mock.cpp \
+    tst_indicator_service.cpp
+
+HEADERS += \
+    $${TOP_BUILD_DIR}/online-accounts-service/webcredentials_adaptor.h \
+    $${COMMON_MOCK_DIR}/notification-mock.h \
+    $${COMMON_SRC_DIR}/notification.h \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/indicator-service.h \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/reauthenticator.h \
+    mock/signon-mock.h
+
+# libsignon-qt is not used: the SignOn headers come from the mock directory
+INCLUDEPATH += \
+    $${TOP_BUILD_DIR}/online-accounts-service \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR} \
+    $${COMMON_SRC_DIR} \
+    $${COMMON_MOCK_DIR} \
+    mock
+
+check.commands = "xvfb-run -s '-screen 0 640x480x24' -a dbus-test-runner -t ./$${TARGET}"
+check.depends = $${TARGET}
+QMAKE_EXTRA_TARGETS += check
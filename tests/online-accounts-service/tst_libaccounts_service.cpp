@@ -26,6 +26,7 @@
 #include <Accounts/Service>
 #include <QDBusConnection>
 #include <QDebug>
+#include <QPointer>
 #include <QProcess>
 #include <QSignalSpy>
 #include <QString>
@@ -46,10 +47,19 @@ public:
 
 private:
     QProcess *requestStore(const QString &args, bool showError = false) {
+        return requestMethod("store", args, showError);
+    }
+
+    QProcess *requestStoreBatch(const QString &args, bool showError = false) {
+        return requestMethod("storeBatch", args, showError);
+    }
+
+    QProcess *requestMethod(const QString &method, const QString &args,
+                            bool showError) {
         QString command = QStringLiteral("gdbus call --session "
                                          "--dest " TEST_SERVICE_NAME " "
                                          "--object-path " TEST_OBJECT_PATH " "
-                                         "--method com.google.code.AccountsSSO.Accounts.Manager.store ");
+                                         "--method com.google.code.AccountsSSO.Accounts.Manager.%1 ").arg(method);
         QProcess *process = new QProcess(this);
         if (showError) {
             process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
@@ -68,9 +78,14 @@ private Q_SLOTS:
     void testAccount();
     void testSettings_data();
     void testSettings();
+    void testBatch();
+    void testCoalescing_data();
+    void testCoalescing();
+    void testStoreDuringSync();
 
 private:
     LibaccountsService m_service;
+    int m_defaultCoalescingInterval;
 };
 
 /* Mocking libaccounts-qt { */
@@ -84,10 +99,13 @@ public:
 
 public:
     Accounts::Account *lastLoadedAccount;
+    QList<Accounts::Account*> loadedAccounts;
 
 private:
     friend class Accounts::Manager;
     QStringList m_services;
+    /* Like libaccounts-qt, return the same object while it's alive */
+    QHash<Accounts::AccountId,QPointer<Accounts::Account> > m_accounts;
     static ManagerController *m_instance;
 };
 
@@ -104,6 +122,7 @@ public:
         m_id(0),
         m_wasDeleted(false),
         m_syncWasCalled(false),
+        m_syncCount(0),
         m_account(account) {
         m_controllers[account] = this;
     }
@@ -123,7 +142,7 @@ public:
     }
 
 protected:
-    void syncCalled() { m_syncWasCalled = true; }
+    void syncCalled() { m_syncWasCalled = true; m_syncCount++; }
 
 public:
     quint32 m_id;
@@ -132,6 +151,7 @@ public:
     RemovedKeys m_removedKeys;
     bool m_wasDeleted;
     bool m_syncWasCalled;
+    int m_syncCount;
 private:
     friend class Accounts::Account;
     static QHash<Accounts::Account *,AccountController*> m_controllers;
@@ -261,10 +281,15 @@ Manager::~Manager()
 
 Account *Manager::account(const AccountId &id) const
 {
+    Account *cached = d->m_controller.m_accounts.value(id);
+    if (cached) return cached;
+
     Account::Private *accountD = new Account::Private();
     d->m_controller.lastLoadedAccount =
         new Account(accountD, const_cast<Manager*>(this));
+    d->m_controller.loadedAccounts.append(d->m_controller.lastLoadedAccount);
     accountD->m_controller->m_id = id;
+    d->m_controller.m_accounts.insert(id, d->m_controller.lastLoadedAccount);
     return d->m_controller.lastLoadedAccount;
 }
 
@@ -272,6 +297,7 @@ Account *Manager::createAccount(const QString &providerName)
 {
     Account::Private *accountD = new Account::Private();
     d->m_controller.lastLoadedAccount = new Account(accountD, this);
+    d->m_controller.loadedAccounts.append(d->m_controller.lastLoadedAccount);
     accountD->m_controller->m_provider = providerName;
     return d->m_controller.lastLoadedAccount;
 }
@@ -319,12 +345,16 @@ LibaccountsServiceTest::LibaccountsServiceTest():
 
     qRegisterMetaType<QProcess::ExitStatus>();
     setLoggingLevel(2);
+
+    m_defaultCoalescingInterval = m_service.coalescingInterval();
 }
 
 void LibaccountsServiceTest::init()
 {
     ManagerController *mc = ManagerController::instance();
     mc->lastLoadedAccount = 0;
+    mc->loadedAccounts.clear();
+    m_service.setCoalescingInterval(m_defaultCoalescingInterval);
 }
 
 void LibaccountsServiceTest::testProfile_data()
@@ -517,6 +547,169 @@ void LibaccountsServiceTest::testSettings()
     finished.wait();
 }
 
+void LibaccountsServiceTest::testBatch()
+{
+    setApparmorProfile("com.ubuntu.package_app_0.1");
+
+    ManagerController *mc = ManagerController::instance();
+    mc->setServices(QStringList() << "cool");
+
+    QProcess *client = requestStoreBatch("\"["
+        "(0, true, false, 'com.ubuntu.package_app',"
+        " [('cool', 'type', 3, {'enabled': <true>}, [])]),"
+        "(4, false, false, 'com.ubuntu.other_app', []),"
+        "(5, false, true, 'com.ubuntu.package_app', [])"
+        "]\"", true);
+    QSignalSpy finished(client, SIGNAL(finished(int,QProcess::ExitStatus)));
+
+    /* The entry for the other provider must not be loaded */
+    QTRY_COMPARE(mc->loadedAccounts.count(), 2);
+    AccountController *created = AccountController::mock(mc->loadedAccounts[0]);
+    AccountController *deleted = AccountController::mock(mc->loadedAccounts[1]);
+    QTRY_COMPARE(created->syncWasCalled(), true);
+    QTRY_COMPARE(deleted->syncWasCalled(), true);
+
+    QCOMPARE(created->m_provider, QString("com.ubuntu.package_app"));
+    QCOMPARE(created->m_serviceSettings["cool"].value("enabled"),
+             QVariant(true));
+    QCOMPARE(deleted->m_id, quint32(5));
+    QCOMPARE(deleted->m_wasDeleted, true);
+
+    /* Only one reply is sent, after all accounts are written */
+    created->m_id = 12;
+    created->doSync();
+    QTest::qWait(50);
+    QCOMPARE(finished.count(), 0);
+    deleted->doSync(Accounts::Error(Accounts::Error::Database, "disk full"));
+
+    finished.wait();
+
+    QByteArray stdOut = client->readAllStandardOutput();
+    QVERIFY(stdOut.contains("12, ''"));
+    QVERIFY(stdOut.contains("4, 'Profile/provider mismatch'"));
+    QVERIFY(stdOut.contains("0, 'disk full'"));
+}
+
+void LibaccountsServiceTest::testCoalescing_data()
+{
+    QTest::addColumn<QString>("firstName");
+    QTest::addColumn<QString>("secondName");
+
+    QTest::newRow("Bob, then Tom") << "Bob" << "Tom";
+    QTest::newRow("Tom, then Bob") << "Tom" << "Bob";
+}
+
+void LibaccountsServiceTest::testCoalescing()
+{
+    QFETCH(QString, firstName);
+    QFETCH(QString, secondName);
+
+    setApparmorProfile("MyProvider");
+    m_service.setCoalescingInterval(1000);
+
+    ManagerController *mc = ManagerController::instance();
+    mc->setServices(QStringList() << "cool");
+
+    QString params("8 false false MyProvider "
+                   "\"[('cool', 'type', 3, {%1}, [])]\"");
+    QProcess *client1 = requestStore(
+        params.arg(QString("'enabled': <true>, 'name': <'%1'>").
+                   arg(firstName)), true);
+    QSignalSpy finished1(client1, SIGNAL(finished(int,QProcess::ExitStatus)));
+
+    /* Make sure that the first request has been received before sending
+     * the second one */
+    QTRY_VERIFY(mc->lastLoadedAccount != 0);
+    AccountController *ac = AccountController::mock(mc->lastLoadedAccount);
+    QTRY_COMPARE(ac->m_serviceSettings["cool"].value("name").toString(),
+                 firstName);
+
+    QProcess *client2 = requestStore(
+        params.arg(QString("'name': <'%1'>").arg(secondName)), true);
+    QSignalSpy finished2(client2, SIGNAL(finished(int,QProcess::ExitStatus)));
+
+    QTRY_COMPARE(ac->m_serviceSettings["cool"].value("name").toString(),
+                 secondName);
+    QCOMPARE(ac->syncWasCalled(), false);
+
+    /* Both changes are written with a single sync */
+    QTRY_COMPARE(ac->syncWasCalled(), true);
+    QCOMPARE(ac->m_syncCount, 1);
+    QCOMPARE(mc->loadedAccounts.count(), 1);
+
+    QVariantMap expectedSettings;
+    expectedSettings.insert("enabled", true);
+    expectedSettings.insert("name", secondName);
+    QCOMPARE(ac->m_serviceSettings["cool"], expectedSettings);
+    QVERIFY(ac->m_removedKeys.isEmpty());
+
+    ac->doSync();
+
+    /* Both clients get their reply */
+    if (finished1.count() == 0) finished1.wait();
+    if (finished2.count() == 0) finished2.wait();
+    QCOMPARE(client1->readAllStandardOutput().trimmed(),
+             QByteArray("(uint32 8,)"));
+    QCOMPARE(client2->readAllStandardOutput().trimmed(),
+             QByteArray("(uint32 8,)"));
+
+    /* Nothing else was written */
+    QTest::qWait(50);
+    QCOMPARE(mc->loadedAccounts.count(), 1);
+}
+
+void LibaccountsServiceTest::testStoreDuringSync()
+{
+    setApparmorProfile("MyProvider");
+    m_service.setCoalescingInterval(50);
+
+    ManagerController *mc = ManagerController::instance();
+    mc->setServices(QStringList() << "cool");
+
+    QString params("8 false false MyProvider "
+                   "\"[('cool', 'type', 3, {%1}, [])]\"");
+    QProcess *client1 = requestStore(
+        params.arg("'enabled': <true>, 'name': <'Bob'>"), true);
+    QSignalSpy finished1(client1, SIGNAL(finished(int,QProcess::ExitStatus)));
+
+    QTRY_VERIFY(mc->lastLoadedAccount != 0);
+    AccountController *ac1 = AccountController::mock(mc->lastLoadedAccount);
+    QTRY_COMPARE(ac1->syncWasCalled(), true);
+
+    /* A change arriving while the account is being synced is not applied to
+     * the object being synced, and it's not replied to yet */
+    QProcess *client2 = requestStore(params.arg("'name': <'Tom'>"), true);
+    QSignalSpy finished2(client2, SIGNAL(finished(int,QProcess::ExitStatus)));
+    QTest::qWait(200);
+    QCOMPARE(ac1->m_serviceSettings["cool"].value("name").toString(),
+             QString("Bob"));
+    QCOMPARE(ac1->m_syncCount, 1);
+    QCOMPARE(mc->loadedAccounts.count(), 1);
+
+    ac1->doSync();
+    if (finished1.count() == 0) finished1.wait();
+    QCOMPARE(client1->readAllStandardOutput().trimmed(),
+             QByteArray("(uint32 8,)"));
+    QCOMPARE(finished2.count(), 0);
+
+    /* The second change is written to a new object, with its own sync */
+    QTRY_COMPARE(mc->loadedAccounts.count(), 2);
+    AccountController *ac2 = AccountController::mock(mc->lastLoadedAccount);
+    QCOMPARE(ac2->m_id, quint32(8));
+    QTRY_COMPARE(ac2->syncWasCalled(), true);
+    QCOMPARE(ac2->m_syncCount, 1);
+
+    QVariantMap expectedSettings;
+    expectedSettings.insert("name", QString("Tom"));
+    QCOMPARE(ac2->m_serviceSettings["cool"], expectedSettings);
+    QVERIFY(ac2->m_removedKeys.isEmpty());
+
+    ac2->doSync();
+    if (finished2.count() == 0) finished2.wait();
+    QCOMPARE(client2->readAllStandardOutput().trimmed(),
+             QByteArray("(uint32 8,)"));
+}
+
 QTEST_MAIN(LibaccountsServiceTest);
 
 #include "tst_libaccounts_service.moc"
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "reauthenticator.h"
+#include "signon-mock.h"
+
+#include <QDebug>
+#include <QSignalSpy>
+#include <QTest>
+
+using namespace SignOnUi;
+
+class ReauthenticatorTest: public QObject
+{
+    Q_OBJECT
+
+public:
+    ReauthenticatorTest();
+
+private Q_SLOTS:
+    void init();
+    void testDuplicates();
+    void testConcurrencyWithRetries();
+    void testRetriesExhausted();
+
+private:
+    QList<AuthData> makeAuthData(int count);
+};
+
+ReauthenticatorTest::ReauthenticatorTest():
+    QObject(0)
+{
+}
+
+QList<AuthData> ReauthenticatorTest::makeAuthData(int count)
+{
+    QList<AuthData> clientData;
+    for (int i = 1; i <= count; i++) {
+        AuthData authData;
+        authData.identity = i;
+        authData.method = "oauth2";
+        authData.mechanism = "web_server";
+        authData.sessionData.insert("ClientId", "a client");
+        clientData.append(authData);
+    }
+    return clientData;
+}
+
+void ReauthenticatorTest::init()
+{
+    SignOnMock::instance()->reset();
+}
+
+void ReauthenticatorTest::testDuplicates()
+{
+    QList<AuthData> clientData = makeAuthData(2);
+    clientData.append(clientData);
+
+    Reauthenticator reauthenticator(clientData, QVariantMap());
+    QSignalSpy finished(&reauthenticator, SIGNAL(finished(bool)));
+    reauthenticator.start();
+
+    QVERIFY(finished.wait());
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+    QCOMPARE(SignOnMock::instance()->processedIdentities().count(), 2);
+}
+
+void ReauthenticatorTest::testConcurrencyWithRetries()
+{
+    SignOnMock *mock = SignOnMock::instance();
+    for (quint32 i = 1; i <= 8; i++) {
+        mock->setTransientFailures(i, 2);
+    }
+
+    Reauthenticator reauthenticator(makeAuthData(8), QVariantMap());
+    QSignalSpy finished(&reauthenticator, SIGNAL(finished(bool)));
+    reauthenticator.start();
+
+    QVERIFY(finished.wait(5000));
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+
+    /* Each identity has been tried three times, but the retries never
+     * caused more than two sessions to run at once */
+    QList<quint32> processed = mock->processedIdentities();
+    QCOMPARE(processed.count(), 8 * 3);
+    for (quint32 i = 1; i <= 8; i++) {
+        QCOMPARE(processed.count(i), 3);
+    }
+    QVERIFY(mock->maxActiveSessions() <= 2);
+}
+
+void ReauthenticatorTest::testRetriesExhausted()
+{
+    SignOnMock *mock = SignOnMock::instance();
+    mock->setTransientFailures(1, 10);
+
+    Reauthenticator reauthenticator(makeAuthData(3), QVariantMap());
+    QSignalSpy finished(&reauthenticator, SIGNAL(finished(bool)));
+    reauthenticator.start();
+
+    QVERIFY(finished.wait(5000));
+    QCOMPARE(finished.at(0).at(0).toBool(), false);
+
+    /* The first attempt, plus three retries */
+    QList<quint32> processed = mock->processedIdentities();
+    QCOMPARE(processed.count(1), 4);
+    QCOMPARE(processed.count(2), 1);
+    QCOMPARE(processed.count(3), 1);
+    QVERIFY(mock->maxActiveSessions() <= 2);
+}
+
+QTEST_GUILESS_MAIN(ReauthenticatorTest);
+
+#include "tst_reauthenticator.moc"
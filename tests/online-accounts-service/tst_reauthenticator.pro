@@ -0,0 +1,37 @@
+include(../../common-project-config.pri)
+
+TARGET = tst_reauthenticator
+
+CONFIG += \
+    debug
+
+QT += \
+    core \
+    testlib
+
+# Keep the retries quick
+DEFINES += \
+    RETRY_BASE_DELAY=10
+
+ONLINE_ACCOUNTS_SERVICE_DIR = $${TOP_SRC_DIR}/online-accounts-service
+COMMON_SRC_DIR = $${TOP_SRC_DIR}/online-accounts-ui
+
+SOURCES += \
+    $${COMMON_SRC_DIR}/debug.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/reauthenticator.cpp \
+    mock/signon-mock.cpp \
+    tst_reauthenticator.cpp
+
+HEADERS += \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/reauthenticator.h \
+    mock/signon-mock.h
+
+# libsignon-qt is not used: the SignOn headers come from the mock directory
+INCLUDEPATH += \
+    $${COMMON_SRC_DIR} \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR} \
+    mock
+
+check.commands = "xvfb-run -s '-screen 0 640x480x24' -a ./$${TARGET}"
+check.depends = $${TARGET}
+QMAKE_EXTRA_TARGETS += check
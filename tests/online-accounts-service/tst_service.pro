@@ -24,6 +24,7 @@ COMMON_SRC_DIR = $${TOP_SRC_DIR}/online-accounts-ui
 
 SOURCES += \
     $${TOP_BUILD_DIR}/online-accounts-service/onlineaccountsui_adaptor.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/render-stats.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request-manager.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/service.cpp \
@@ -32,6 +33,7 @@ SOURCES += \
 
 HEADERS += \
     $${TOP_BUILD_DIR}/online-accounts-service/onlineaccountsui_adaptor.h \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/render-stats.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request-manager.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/service.h \
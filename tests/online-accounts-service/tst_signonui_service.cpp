@@ -18,19 +18,90 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "cache-manager.h"
+#include "cookie-jar.h"
+#include "data-remover.h"
 #include "globals.h"
+#include "inactivity-timer.h"
 #include "mock/request-manager-mock.h"
 #include "signonui-service.h"
+#include "utils.h"
 
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDateTime>
 #include <QDebug>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QNetworkCookie>
 #include <QSignalSpy>
 #include <QString>
 #include <QTemporaryDir>
 #include <QTest>
+#include <SignOn/uisessiondata_priv.h>
 #include <sys/time.h>
 
+using namespace OnlineAccountsUi;
 using namespace SignOnUi;
 
+#define CAPTURE_OBJECT_PATH "/com/ubuntu/OnlineAccountsUi/Test"
+#define CAPTURE_INTERFACE "com.ubuntu.OnlineAccountsUi.Test"
+
+class ParametersCapture: public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", CAPTURE_INTERFACE)
+
+public:
+    QVariantMap lastParameters;
+
+public Q_SLOTS:
+    void capture(const QVariantMap &parameters) {
+        lastParameters = parameters;
+        Q_EMIT captured();
+    }
+
+Q_SIGNALS:
+    void captured();
+};
+
+/* A queryDialog() call as signond would send it */
+static QVariantMap queryDialogParameters()
+{
+    QVariantMap windowProperties;
+    windowProperties.insert("AllowedSchemes",
+                            QStringList() << "https" << "http");
+    windowProperties.insert("Size", QVariantList() << 480 << 640);
+
+    QVariantMap clientData;
+    clientData.insert("requestorPid", uint(4312));
+    clientData.insert("providerId", QString("google"));
+    clientData.insert("X-RequestHandler", QString("handler-1"));
+    clientData.insert("Scopes", QStringList() <<
+                      "https://www.googleapis.com/auth/userinfo.email" <<
+                      "https://www.googleapis.com/auth/calendar");
+    clientData.insert("WindowProperties", windowProperties);
+
+    QVariantMap parameters;
+    parameters.insert(SSOUI_KEY_REQUESTID,
+                      QString("/com/google/code/AccountsSSO/SingleSignOn/"
+                              "AuthSession_3"));
+    parameters.insert(SSOUI_KEY_IDENTITY, uint(12));
+    parameters.insert(SSOUI_KEY_METHOD, QString("oauth2"));
+    parameters.insert(SSOUI_KEY_MECHANISM, QString("web_server"));
+    parameters.insert(SSOUI_KEY_OPENURL,
+                      QString("https://accounts.google.com/o/oauth2/auth?"
+                              "client_id=759250720802&response_type=code"));
+    parameters.insert(SSOUI_KEY_FINALURL,
+                      QString("https://localhost/connect/login_success.html"));
+    parameters.insert(SSOUI_KEY_TITLE, QString("Google"));
+    parameters.insert(SSOUI_KEY_PID, uint(1234));
+    parameters.insert(SSOUI_KEY_CLIENT_DATA, clientData);
+    return parameters;
+}
+
 class ServiceTest: public QObject
 {
     Q_OBJECT
@@ -39,14 +110,25 @@ public:
     ServiceTest();
 
 private:
+    QVariantMap receiveOverDBus(const QVariantMap &parameters);
     void writeFile(const QString &name, const QByteArray &contents);
     void setFileDate(const QString &name, qint64 timestamp);
 
 private Q_SLOTS:
     void testCookies_data();
     void testCookies();
+    void testCookiesCache();
+    void testCookieJar();
+    void testDataRemoval();
+    void testCacheCollection();
+    void testCollectionBeforeExit();
+    void testExpandDBusArguments();
+    void benchmarkExpandDBusArguments();
+    void benchmarkCookies_data();
+    void benchmarkCookies();
 
 private:
+    ParametersCapture m_capture;
     OnlineAccountsUi::RequestManager m_requestManager;
     Service m_service;
 };
@@ -54,6 +136,34 @@ private:
 ServiceTest::ServiceTest():
     QObject(0)
 {
+    /* Don't let this instance collect the caches of the single tests */
+    m_service.cacheManager()->setCollectionDelay(3600 * 1000);
+}
+
+QVariantMap ServiceTest::receiveOverDBus(const QVariantMap &parameters)
+{
+    /* Send the parameters through a different connection, so that they are
+     * really marshalled */
+    QDBusConnection receiver = QDBusConnection::sessionBus();
+    receiver.registerObject(CAPTURE_OBJECT_PATH, &m_capture,
+                            QDBusConnection::ExportAllSlots);
+    QDBusConnection sender =
+        QDBusConnection::connectToBus(QDBusConnection::SessionBus, "sender");
+
+    QDBusMessage msg =
+        QDBusMessage::createMethodCall(receiver.baseService(),
+                                       CAPTURE_OBJECT_PATH,
+                                       CAPTURE_INTERFACE,
+                                       "capture");
+    msg << parameters;
+
+    QSignalSpy captured(&m_capture, SIGNAL(captured()));
+    sender.asyncCall(msg);
+    if (!captured.wait()) {
+        qWarning() << "Parameters not received";
+    }
+    receiver.unregisterObject(CAPTURE_OBJECT_PATH);
+    return m_capture.lastParameters;
 }
 
 void ServiceTest::writeFile(const QString &name, const QByteArray &contents)
@@ -146,6 +256,379 @@ void ServiceTest::testCookies()
     QCOMPARE(timestamp / 10, expectedTimestamp / 10);
 }
 
+void ServiceTest::testCookiesCache()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    qputenv("XDG_CACHE_HOME", tempDir.path().toUtf8());
+
+    QDir cacheDir(tempDir.path());
+    cacheDir.mkpath("online-accounts-ui/id-5-cool");
+    cacheDir.cd("online-accounts-ui");
+
+    QString cookieFile = cacheDir.filePath("id-5-cool/cookies.json");
+    writeFile(cookieFile, "[{\"name\": \"C1\", \"value\": \"one\"}]");
+    setFileDate(cookieFile, 1406104196);
+
+    RawCookies cookies;
+    qint64 timestamp = 0;
+    m_service.cookiesForIdentity(5, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies() << "C1=one");
+
+    /* Modify the file: the new cookies must be returned */
+    writeFile(cookieFile, "[{\"name\": \"C1\", \"value\": \"three\"}]");
+    setFileDate(cookieFile, 1406104200);
+    m_service.cookiesForIdentity(5, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies() << "C1=three");
+
+    /* An identity whose directory didn't exist at the previous lookup */
+    cacheDir.mkpath("id-52-cool");
+    writeFile(cacheDir.filePath("id-52-cool/cookies.json"),
+              "[{\"name\": \"C2\", \"value\": \"two\"}]");
+    m_service.cookiesForIdentity(52, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies() << "C2=two");
+
+    /* The identity ID must match exactly */
+    cookies.clear();
+    m_service.cookiesForIdentity(50, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies());
+
+    /* Missing identities are not looked for again until the file system
+     * watcher reports a change in the cache directory */
+    cacheDir.mkpath("id-50-cool");
+    writeFile(cacheDir.filePath("id-50-cool/cookies.json"),
+              "[{\"name\": \"C3\", \"value\": \"late\"}]");
+    m_service.cookiesForIdentity(50, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies());
+    QTRY_COMPARE((m_service.cookiesForIdentity(50, cookies, timestamp),
+                  cookies), RawCookies() << "C3=late");
+
+    /* Data removal */
+    m_service.removeIdentityData(5);
+    QVERIFY(!QFile::exists(cookieFile));
+    cookies.clear();
+    m_service.cookiesForIdentity(5, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies());
+}
+
+void ServiceTest::testCookieJar()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    qputenv("XDG_CACHE_HOME", tempDir.path().toUtf8());
+
+    QDir cacheDir(tempDir.path());
+    cacheDir.mkpath("online-accounts-ui/id-8");
+    cacheDir.cd("online-accounts-ui/id-8");
+
+    /* A stale JSON file must be shadowed by the binary jar */
+    writeFile(cacheDir.filePath("cookies.json"),
+              "[{\"name\": \"Old\", \"value\": \"json\"}]");
+
+    QList<QNetworkCookie> jar = QNetworkCookie::parseCookies(
+        "C1=one; domain=foo.com\n"
+        "C2=two; HttpOnly\n"
+        "C3=expired; expires=Sat, 20-Aug-2016 16:33:43 GMT");
+    QVariantList variants;
+    Q_FOREACH(const QNetworkCookie &cookie, jar) {
+        variants.append(QVariant::fromValue(cookie));
+    }
+    /* Cookies can also be given as dictionaries */
+    QVariantMap cookieMap;
+    cookieMap.insert("name", "C4");
+    cookieMap.insert("value", "four");
+    cookieMap.insert("path", "/");
+    variants.append(cookieMap);
+
+    QVERIFY(writeCookieJar(cacheDir.filePath("cookies.bin"),
+                           cookiesFromVariant(variants)));
+
+    RawCookies cookies;
+    qint64 timestamp = 0;
+    m_service.cookiesForIdentity(8, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies() <<
+             jar[0].toRawForm() <<
+             jar[1].toRawForm() <<
+             "C4=four; path=/");
+
+    /* A truncated file must not return garbage */
+    QFile file(cacheDir.filePath("cookies.bin"));
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 3));
+    file.close();
+    cookies.clear();
+    QVERIFY(!readCookieJar(file.fileName(), cookies));
+    QCOMPARE(cookies, RawCookies());
+}
+
+void ServiceTest::testDataRemoval()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    qputenv("XDG_CACHE_HOME", tempDir.path().toUtf8());
+
+    QDir cacheDir(tempDir.path());
+    cacheDir.mkpath("online-accounts-ui/id-9-cool/storage");
+    cacheDir.mkpath("online-accounts-ui/.removed-id-3-1469000000000/storage");
+    cacheDir.cd("online-accounts-ui");
+    writeFile(cacheDir.filePath("id-9-cool/cookies.json"),
+              "[{\"name\": \"C1\", \"value\": \"one\"}]");
+    writeFile(cacheDir.filePath("id-9-cool/storage/data"), "some data");
+    writeFile(cacheDir.filePath(".removed-id-3-1469000000000/storage/data"),
+              "old data");
+
+    /* Leftover tombstones are deleted when the service starts */
+    Service service;
+    DataRemover *remover = service.dataRemover();
+    QSignalSpy isIdleChanged(remover, SIGNAL(isIdleChanged()));
+    QVERIFY(!remover->isIdle());
+    QVERIFY(isIdleChanged.wait());
+    QVERIFY(remover->isIdle());
+    QVERIFY(!cacheDir.exists(".removed-id-3-1469000000000"));
+
+    RawCookies cookies;
+    qint64 timestamp = 0;
+    service.cookiesForIdentity(9, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies() << "C1=one");
+
+    /* The data must disappear immediately, even if the actual deletion
+     * happens later */
+    isIdleChanged.clear();
+    service.removeIdentityData(9);
+    QCOMPARE(isIdleChanged.count(), 1);
+    QVERIFY(!remover->isIdle());
+    QVERIFY(!cacheDir.exists("id-9-cool"));
+    cookies.clear();
+    service.cookiesForIdentity(9, cookies, timestamp);
+    QCOMPARE(cookies, RawCookies());
+
+    QVERIFY(isIdleChanged.wait());
+    QVERIFY(remover->isIdle());
+    QCOMPARE(cacheDir.entryList(QDir::AllEntries | QDir::Hidden |
+                                QDir::NoDotAndDotDot),
+             QStringList());
+}
+
+void ServiceTest::testCacheCollection()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    qputenv("XDG_CACHE_HOME", tempDir.path().toUtf8());
+
+    QDir cacheDir(tempDir.path());
+    cacheDir.mkpath("online-accounts-ui");
+    cacheDir.cd("online-accounts-ui");
+    cacheDir.mkpath("id-1");
+    cacheDir.mkpath("id-1-cool");
+    cacheDir.mkpath("id-2-cool/storage");
+    cacheDir.mkpath("id-3-cool/storage");
+    cacheDir.mkpath("id-3");
+
+    QByteArray cookies("[{\"name\": \"C1\", \"value\": \"one\"}]");
+    /* Left over by an older version */
+    writeFile(cacheDir.filePath("id-1/data"), QByteArray(1000, 'x'));
+    writeFile(cacheDir.filePath("id-1-cool/cookies.json"), cookies);
+    writeFile(cacheDir.filePath("id-1-cool/data"), QByteArray(1000, 'x'));
+    writeFile(cacheDir.filePath("id-2-cool/cookies.json"), cookies);
+    writeFile(cacheDir.filePath("id-2-cool/storage/data"),
+              QByteArray(5000, 'x'));
+    /* Recently used: must not be touched */
+    writeFile(cacheDir.filePath("id-3-cool/storage/data"),
+              QByteArray(5000, 'x'));
+    /* Not the newest directory of its identity, but used recently: it
+     * might still be in use by a UI process */
+    writeFile(cacheDir.filePath("id-3/data"), QByteArray(100, 'x'));
+    qint64 recently = QDateTime::currentDateTime().toTime_t() - 60;
+    setFileDate(cacheDir.filePath("id-3/data"), recently);
+    setFileDate(cacheDir.filePath("id-3"), recently);
+
+    QStringList oldFiles;
+    oldFiles << "id-1/data" << "id-1" <<
+        "id-2-cool/cookies.json" << "id-2-cool/storage/data" << "id-2-cool";
+    Q_FOREACH(const QString &name, oldFiles) {
+        setFileDate(cacheDir.filePath(name), 1406104196);
+    }
+    QStringList lessOldFiles;
+    lessOldFiles << "id-1-cool/cookies.json" << "id-1-cool/data" <<
+        "id-1-cool";
+    Q_FOREACH(const QString &name, lessOldFiles) {
+        setFileDate(cacheDir.filePath(name), 1469000000);
+    }
+
+    Service service;
+    CacheManager *cacheManager = service.cacheManager();
+    DataRemover *remover = service.dataRemover();
+    QSignalSpy collected(cacheManager, SIGNAL(collected()));
+    QSignalSpy isIdleChanged(remover, SIGNAL(isIdleChanged()));
+
+    /* Evicting the least recently used entry is enough to fit */
+    cacheManager->setBudget(7000);
+    cacheManager->collect();
+    QVERIFY(collected.wait());
+    if (!remover->isIdle()) {
+        QVERIFY(isIdleChanged.wait());
+    }
+
+    QVERIFY(!cacheDir.exists("id-1"));
+    QVERIFY(cacheDir.exists("id-1-cool/data"));
+    QVERIFY(cacheDir.exists("id-2-cool/cookies.json"));
+    QVERIFY(!cacheDir.exists("id-2-cool/storage"));
+    QVERIFY(cacheDir.exists("id-3-cool/storage/data"));
+    QVERIFY(cacheDir.exists("id-3/data"));
+
+    qulonglong expectedUsage = 1000 + 5000 + 100 + 2 * cookies.length();
+    QCOMPARE(cacheManager->usage(), qint64(expectedUsage));
+    QCOMPARE(service.property("CacheUsage").toULongLong(), expectedUsage);
+
+    /* The cookies survive the eviction */
+    RawCookies rawCookies;
+    qint64 timestamp = 0;
+    service.cookiesForIdentity(2, rawCookies, timestamp);
+    QCOMPARE(rawCookies, RawCookies() << "C1=one");
+
+    /* Only the tombstones have been removed */
+    QStringList entries =
+        cacheDir.entryList(QDir::AllEntries | QDir::Hidden |
+                           QDir::NoDotAndDotDot);
+    QCOMPARE(entries,
+             QStringList() << "id-1-cool" << "id-2-cool" << "id-3" <<
+             "id-3-cool");
+}
+
+void ServiceTest::testCollectionBeforeExit()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    qputenv("XDG_CACHE_HOME", tempDir.path().toUtf8());
+
+    QDir cacheDir(tempDir.path());
+    cacheDir.mkpath("online-accounts-ui/id-4-cool/storage");
+    cacheDir.cd("online-accounts-ui");
+    QByteArray cookies("[{\"name\": \"C1\", \"value\": \"one\"}]");
+    writeFile(cacheDir.filePath("id-4-cool/cookies.json"), cookies);
+    writeFile(cacheDir.filePath("id-4-cool/storage/data"),
+              QByteArray(5000, 'x'));
+    QStringList files;
+    files << "id-4-cool/cookies.json" << "id-4-cool/storage/data";
+    Q_FOREACH(const QString &name, files) {
+        setFileDate(cacheDir.filePath(name), 1406104196);
+    }
+
+    /* Watch the same objects as the daemon does; the collection scheduled
+     * on startup takes longer than the inactivity timeout */
+    Service service;
+    CacheManager *cacheManager = service.cacheManager();
+    cacheManager->setBudget(1000);
+    cacheManager->setCollectionDelay(300);
+    QVERIFY(!cacheManager->isIdle());
+
+    InactivityTimer inactivityTimer(100);
+    inactivityTimer.watchObject(service.dataRemover());
+    inactivityTimer.watchObject(cacheManager);
+    QSignalSpy timeout(&inactivityTimer, SIGNAL(timeout()));
+
+    /* The budget is enforced before the service would exit */
+    QVERIFY(timeout.wait(5000));
+    QVERIFY(cacheManager->isIdle());
+    QVERIFY(cacheManager->usage() <= 1000);
+    QVERIFY(!cacheDir.exists("id-4-cool/storage"));
+    QVERIFY(cacheDir.exists("id-4-cool/cookies.json"));
+}
+
+void ServiceTest::testExpandDBusArguments()
+{
+    QVariantMap parameters = queryDialogParameters();
+    QVariantMap received = receiveOverDBus(parameters);
+    QCOMPARE(received.count(), parameters.count());
+    /* QtDBus doesn't convert nested containers */
+    QCOMPARE(received.value(SSOUI_KEY_CLIENT_DATA).userType(),
+             qMetaTypeId<QDBusArgument>());
+
+    QVariantMap expanded = expandDBusArguments(received);
+    QCOMPARE(expanded, parameters);
+
+    QVariantMap clientData = expanded.value(SSOUI_KEY_CLIENT_DATA).toMap();
+    QVariant windowProperties = clientData.value("WindowProperties");
+    QCOMPARE(windowProperties.userType(), int(QMetaType::QVariantMap));
+    QVariant size = windowProperties.toMap().value("Size");
+    QCOMPARE(size.userType(), int(QMetaType::QVariantList));
+    QCOMPARE(size.toList().at(1).toInt(), 640);
+}
+
+void ServiceTest::benchmarkExpandDBusArguments()
+{
+    QVariantMap received = receiveOverDBus(queryDialogParameters());
+
+    QVariantMap expanded;
+    QBENCHMARK {
+        expanded = expandDBusArguments(received);
+    }
+    QCOMPARE(expanded, queryDialogParameters());
+}
+
+void ServiceTest::benchmarkCookies_data()
+{
+    QTest::addColumn<bool>("binary");
+
+    QTest::newRow("json") << false;
+    QTest::newRow("binary") << true;
+}
+
+void ServiceTest::benchmarkCookies()
+{
+    QFETCH(bool, binary);
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+
+    /* A realistic jar, as left by a provider's login pages */
+    QDateTime expiration = QDateTime::currentDateTimeUtc().addDays(30);
+    QList<QNetworkCookie> jar;
+    QVariantList jsonCookies;
+    for (int i = 0; i < 300; i++) {
+        QNetworkCookie cookie(QString("cookie_%1").arg(i).toUtf8(),
+                              QByteArray(64, 'a' + i % 26));
+        cookie.setDomain(QString(".domain%1.example.com").arg(i % 10));
+        cookie.setPath("/");
+        cookie.setSecure(true);
+        cookie.setHttpOnly(i % 2);
+        cookie.setExpirationDate(expiration);
+        jar.append(cookie);
+
+        QVariantMap map;
+        map.insert("name", cookie.name());
+        map.insert("value", cookie.value());
+        map.insert("domain", cookie.domain());
+        map.insert("path", cookie.path());
+        map.insert("issecure", cookie.isSecure());
+        map.insert("httponly", cookie.isHttpOnly());
+        map.insert("expirationdate", expiration.toString(Qt::ISODate));
+        jsonCookies.append(map);
+    }
+
+    QString fileName;
+    if (binary) {
+        fileName = tempDir.path() + "/cookies.bin";
+        QVERIFY(writeCookieJar(fileName, jar));
+    } else {
+        fileName = tempDir.path() + "/cookies.json";
+        QJsonDocument doc(QJsonArray::fromVariantList(jsonCookies));
+        writeFile(fileName, doc.toJson());
+    }
+    qDebug() << "File size:" << QFileInfo(fileName).size();
+
+    RawCookies cookies;
+    QBENCHMARK {
+        cookies.clear();
+        if (binary) {
+            readCookieJar(fileName, cookies);
+        } else {
+            readJsonCookies(fileName, cookies);
+        }
+    }
+    QCOMPARE(cookies.count(), 300);
+}
+
 QTEST_MAIN(ServiceTest);
 
 #include "tst_signonui_service.moc"
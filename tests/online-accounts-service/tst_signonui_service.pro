@@ -24,6 +24,10 @@ ONLINE_ACCOUNTS_SERVICE_DIR = $${TOP_SRC_DIR}/online-accounts-service
 COMMON_SRC_DIR = $${TOP_SRC_DIR}/online-accounts-ui
 
 SOURCES += \
+    $${COMMON_SRC_DIR}/cookie-jar.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/cache-manager.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/data-remover.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/inactivity-timer.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/signonui-service.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/utils.cpp \
@@ -31,6 +35,10 @@ SOURCES += \
     tst_signonui_service.cpp
 
 HEADERS += \
+    $${COMMON_SRC_DIR}/cookie-jar.h \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/cache-manager.h \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/data-remover.h \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/inactivity-timer.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request-manager.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/signonui-service.h \
@@ -21,6 +21,7 @@
 #include "globals.h"
 #include "ipc.h"
 #include "mock/request-mock.h"
+#include "render-stats.h"
 #include "ui-proxy.h"
 
 #include <QByteArray>
@@ -30,7 +31,9 @@
 #include <QDBusMessage>
 #include <QLocalSocket>
 #include <QProcess>
+#include <QSet>
 #include <QSignalSpy>
+#include <QStandardPaths>
 #include <QString>
 #include <QTemporaryDir>
 #include <QTest>
@@ -49,6 +52,12 @@ public:
     bool run();
     void setDelay(int delay) { m_delay = delay; }
     void setResult(const QVariantMap &result);
+    void setTimings(const QVariantMap &timings, const QString &requestType,
+                    const QString &providerId = QString()) {
+        m_timings = timings;
+        m_requestType = requestType;
+        m_timingsProvider = providerId;
+    }
     void fail(const QString &errorName, const QString &errorMessage);
     void registerHandler(const QString &matchId);
 
@@ -71,6 +80,9 @@ private:
     QVariantMap m_lastData;
     int m_requestId;
     int m_delay;
+    QVariantMap m_timings;
+    QString m_requestType;
+    QString m_timingsProvider;
     QString m_requestInterface;
     QLocalSocket m_socket;
     Ipc m_ipc;
@@ -118,6 +130,13 @@ void RemoteProcess::setResult(const QVariantMap &result)
     operation.insert(OAU_OPERATION_INTERFACE, m_requestInterface);
     operation.insert(OAU_OPERATION_DATA, result);
     operation.insert(OAU_OPERATION_DELAY, m_delay);
+    if (!m_timings.isEmpty()) {
+        operation.insert(OAU_OPERATION_TIMINGS, m_timings);
+        operation.insert(OAU_OPERATION_REQUEST_TYPE, m_requestType);
+        if (!m_timingsProvider.isEmpty()) {
+            operation.insert(OAU_OPERATION_PROVIDER, m_timingsProvider);
+        }
+    }
     sendOperation(operation);
     deleteLater();
 }
@@ -186,6 +205,15 @@ bool QProcess::waitForStarted(int msecs)
 }
 /* } mocking QProcess */
 
+/* A RenderStats which is not the singleton: it reads the statistics stored
+ * by the service */
+class StoredRenderStats: public RenderStats
+{
+public:
+    StoredRenderStats(): RenderStats() {}
+    ~StoredRenderStats() {}
+};
+
 class UiProxyTest: public QObject
 {
     Q_OBJECT
@@ -206,6 +234,8 @@ private Q_SLOTS:
     void testRequest();
     void testRequestDelay_data();
     void testRequestDelay();
+    void testRefresh();
+    void testTimings();
     void testHandler();
     void testWrapper();
     void testTrustSessionError_data();
@@ -242,6 +272,9 @@ Request *UiProxyTest::createRequest(const QString &interface,
 
 void UiProxyTest::initTestCase()
 {
+    /* Don't touch the user's render statistics */
+    QStandardPaths::setTestModeEnabled(true);
+
     qputenv("ACCOUNTS", "/tmp/");
     qputenv("AG_APPLICATIONS", TEST_DATA_DIR);
     qputenv("AG_SERVICES", TEST_DATA_DIR);
@@ -426,6 +459,133 @@ void UiProxyTest::testRequestDelay()
     delete proxy;
 }
 
+void UiProxyTest::testRefresh()
+{
+    QVariantMap parameters;
+    parameters.insert("greeting", "Hello!");
+    parameters.insert("name", "Tom");
+    Request *request = createRequest(SIGNONUI_INTERFACE, "queryDialog",
+                                     "unconfined", parameters);
+    RequestPrivate *r = RequestPrivate::mocked(request);
+    QSignalSpy requestSetResultCalled(r, SIGNAL(setResultCalled(QVariantMap)));
+
+    UiProxy *proxy = new UiProxy(0, this);
+    QVERIFY(proxy->init());
+    proxy->handleRequest(request);
+
+    QTRY_VERIFY(!remoteProcesses.isEmpty());
+    QCOMPARE(remoteProcesses.count(), 1);
+
+    RemoteProcess *process = remoteProcesses.values().first();
+    QVERIFY(process);
+    QSignalSpy dataReceived(process, SIGNAL(dataReceived(QVariantMap)));
+
+    if (process->lastReceived().isEmpty()) {
+        QVERIFY(dataReceived.wait());
+    }
+    int requestId = process->lastReceived().value(OAU_OPERATION_ID).toInt();
+    dataReceived.clear();
+
+    /* The refresh must reach the same UI process */
+    QVariantMap newParameters;
+    newParameters.insert("greeting", "Hi again!");
+    request->refresh(QDBusMessage(), newParameters);
+    QVERIFY(dataReceived.wait());
+    QCOMPARE(remoteProcesses.count(), 1);
+
+    QVariantMap data = process->lastReceived();
+    QCOMPARE(data.value(OAU_OPERATION_CODE).toString(),
+             QStringLiteral(OAU_OPERATION_CODE_REFRESH));
+    QCOMPARE(data.value(OAU_OPERATION_ID).toInt(), requestId);
+    QCOMPARE(data.value(OAU_OPERATION_DATA).toMap(), newParameters);
+
+    /* The request parameters are merged */
+    QCOMPARE(request->parameters().value("greeting").toString(),
+             QString("Hi again!"));
+    QCOMPARE(request->parameters().value("name").toString(),
+             QString("Tom"));
+
+    QVariantMap result;
+    result.insert("response", "OK");
+    process->setResult(result);
+    QVERIFY(requestSetResultCalled.wait());
+    QCOMPARE(requestSetResultCalled.at(0).at(0).toMap(), result);
+
+    delete proxy;
+}
+
+void UiProxyTest::testTimings()
+{
+    RenderStats *stats = RenderStats::instance();
+    stats->clear();
+
+    struct {
+        QString interface;
+        QString requestType;
+        QString reportedProvider;
+        qint64 firstFrame;
+    } requests[] = {
+        { OAU_INTERFACE, "OnlineAccountsUi::ProviderRequest", "", 100 },
+        { OAU_INTERFACE, "OnlineAccountsUi::ProviderRequest", "", 300 },
+        { SIGNONUI_INTERFACE, "SignOnUi::BrowserRequest", "google", 50 },
+    };
+
+    for (uint i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+        Request *request = createRequest(requests[i].interface, "hello",
+                                         "unconfined", QVariantMap());
+        RequestPrivate *r = RequestPrivate::mocked(request);
+        r->setProviderId(requests[i].interface == OAU_INTERFACE ?
+                         "cool" : "");
+        QSignalSpy requestSetResultCalled(r,
+                                          SIGNAL(setResultCalled(QVariantMap)));
+
+        UiProxy *proxy = new UiProxy(0, this);
+        QVERIFY(proxy->init());
+        proxy->handleRequest(request);
+
+        QTRY_COMPARE(remoteProcesses.count(), 1);
+        RemoteProcess *process = remoteProcesses.values().first();
+        QSignalSpy dataReceived(process, SIGNAL(dataReceived(QVariantMap)));
+        if (process->lastReceived().isEmpty()) {
+            QVERIFY(dataReceived.wait());
+        }
+
+        QVariantMap timings;
+        timings.insert(OAU_TIMING_FIRST_FRAME, requests[i].firstFrame);
+        process->setTimings(timings, requests[i].requestType,
+                            requests[i].reportedProvider);
+        process->setResult(QVariantMap());
+        QVERIFY(requestSetResultCalled.wait());
+
+        delete proxy;
+        delete request;
+        QTRY_COMPARE(remoteProcesses.count(), 0);
+    }
+
+    QVariantMap allTimings = stats->timings();
+    QCOMPARE(allTimings.keys().toSet(),
+             (QSet<QString>() << "cool" << "google"));
+
+    /* The statistics survive a restart of the service */
+    StoredRenderStats restored;
+    QCOMPARE(restored.timings(), allTimings);
+
+    QVariantMap firstFrame = allTimings.value("cool").toMap().
+        value("OnlineAccountsUi::ProviderRequest").toMap().
+        value(OAU_TIMING_FIRST_FRAME).toMap();
+    QCOMPARE(firstFrame.value("count").toInt(), 2);
+    QCOMPARE(firstFrame.value("mean").toInt(), 200);
+    QCOMPARE(firstFrame.value("max").toInt(), 300);
+
+    firstFrame = allTimings.value("google").toMap().
+        value("SignOnUi::BrowserRequest").toMap().
+        value(OAU_TIMING_FIRST_FRAME).toMap();
+    QCOMPARE(firstFrame.value("count").toInt(), 1);
+    QCOMPARE(firstFrame.value("mean").toInt(), 50);
+
+    stats->clear();
+}
+
 void UiProxyTest::testHandler()
 {
     UiProxy *proxy = new UiProxy(0, this);
@@ -27,6 +27,7 @@ COMMON_SRC_DIR = $${TOP_SRC_DIR}/online-accounts-ui
 SOURCES += \
     $${COMMON_SRC_DIR}/ipc.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/mir-helper-stub.cpp \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/render-stats.cpp \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/ui-proxy.cpp \
     mock/request-mock.cpp \
     tst_ui_proxy.cpp
@@ -34,6 +35,7 @@ SOURCES += \
 HEADERS += \
     $${COMMON_SRC_DIR}/ipc.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/mir-helper.h \
+    $${ONLINE_ACCOUNTS_SERVICE_DIR}/render-stats.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/request.h \
     $${ONLINE_ACCOUNTS_SERVICE_DIR}/ui-proxy.h \
     mock/request-mock.h
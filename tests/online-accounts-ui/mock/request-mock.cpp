@@ -108,6 +108,26 @@ int Request::delay() const
     return d->m_delay;
 }
 
+void Request::setContentLoaded()
+{
+}
+
+QVariantMap Request::timings() const
+{
+    return QVariantMap();
+}
+
+void Request::refresh(const QVariantMap &parameters)
+{
+    Q_D(Request);
+
+    QMapIterator<QString, QVariant> it(parameters);
+    while (it.hasNext()) {
+        it.next();
+        d->m_parameters.insert(it.key(), it.value());
+    }
+}
+
 void Request::start()
 {
     Q_D(Request);
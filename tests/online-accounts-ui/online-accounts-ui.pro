@@ -5,4 +5,5 @@ SUBDIRS = \
     tst_browser_request.pro \
     tst_notification.pro \
     tst_provider_request.pro \
+    tst_redirect_matcher.pro \
     tst_signonui_request.pro
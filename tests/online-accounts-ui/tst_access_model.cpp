@@ -263,6 +263,29 @@ void AccessModelTest::testEnabling()
     QCOMPARE(rowsRemoved.count(), 0);
     rowsInserted.clear();
 
+    /* Enable the remaining service on the first account: now it must be
+     * filtered out */
+    account1->selectService(coolShare);
+    account1->setEnabled(true);
+    account1->syncAndBlock();
+
+    rowsRemoved.wait();
+    QCOMPARE(model->rowCount(), 0);
+    QCOMPARE(rowsInserted.count(), 0);
+    QCOMPARE(rowsRemoved.count(), 1);
+    rowsRemoved.clear();
+
+    /* Disable it again, and verify that the account is back */
+    account1->setEnabled(false);
+    account1->syncAndBlock();
+
+    rowsInserted.wait();
+    QCOMPARE(model->rowCount(), 1);
+    QCOMPARE(rowsInserted.count(), 1);
+    QCOMPARE(rowsRemoved.count(), 0);
+    rowsInserted.clear();
+    QCOMPARE(model->get(0, "displayName").toString(), QString("CoolAccount"));
+
     delete model;
     delete accountModel;
 }
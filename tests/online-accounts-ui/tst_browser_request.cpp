@@ -20,6 +20,8 @@
 
 #include "browser-request.h"
 #include "debug.h"
+#include "dialog.h"
+#include "load-time-tracker.h"
 #include "globals.h"
 #include "mock/request-mock.h"
 #include "mock/signonui-request-mock.h"
@@ -28,7 +30,12 @@
 #include <OnlineAccountsPlugin/request-handler.h>
 
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QGuiApplication>
 #include <QNetworkCookie>
+#include <QPointer>
+#include <QQmlContext>
 #include <QSignalSpy>
 #include <QTemporaryDir>
 #include <QTest>
@@ -58,11 +65,15 @@ public:
 
 private Q_SLOTS:
     void initTestCase();
+    void cleanup();
     void testParametersWithHandler_data();
     void testParametersWithHandler();
     void testSuccessWithHandler();
     void testFailureWithHandler();
+    void testRetryWithHandler();
     void testCancelWithHandler();
+    void testRefreshWithHandler();
+    void testPreWarmedDialog();
 
 private:
     QTemporaryDir m_dataDir;
@@ -80,6 +91,14 @@ void BrowserRequestTest::initTestCase()
     QVERIFY(m_dataDir.isValid());
 
     qputenv("XDG_CACHE_HOME", m_dataDir.path().toUtf8());
+    /* Where the page load times are stored */
+    qputenv("XDG_DATA_HOME", m_dataDir.path().toUtf8());
+}
+
+void BrowserRequestTest::cleanup()
+{
+    /* Don't let the load times recorded by a test affect the next ones */
+    QFile::remove(SignOnUi::LoadTimeTracker::storePath());
 }
 
 void BrowserRequestTest::testParametersWithHandler_data()
@@ -265,6 +284,59 @@ void BrowserRequestTest::testFailureWithHandler()
     QVERIFY(results.contains(SSOUI_KEY_ERROR));
 }
 
+void BrowserRequestTest::testRetryWithHandler()
+{
+    /* Pretend that some pages have already been loaded from this host */
+    SignOnUi::LoadTimeTracker tracker("localhost");
+    tracker.addSample(40);
+    tracker.addSample(40);
+
+    SignOnUi::RequestHandler handler;
+
+    QVariantMap parameters;
+    parameters.insert(SSOUI_KEY_OPENURL, "http://localhost/start.html");
+    parameters.insert(SSOUI_KEY_FINALURL, "http://localhost/end.html");
+    parameters.insert(SSOUI_KEY_IDENTITY, uint(4));
+    TestRequest request(parameters);
+    QSignalSpy completed(&request, SIGNAL(completed()));
+
+    request.setHandler(&handler);
+    request.start();
+
+    QObject *req = handler.request();
+    QSignalSpy reloadRequested(req, SIGNAL(reloadRequested()));
+    QSignalSpy loadTimesChanged(req, SIGNAL(loadTimesChanged()));
+
+    /* The timeout is derived from the recorded load times */
+    QCOMPARE(req->property("averageLoadTime").toInt(), 40);
+    int failTimeout = req->property("failTimeout").toInt();
+    QCOMPARE(failTimeout, 120);
+
+    /* Fail to load a page: the request should ask for a reload */
+    QMetaObject::invokeMethod(req, "onLoadStarted");
+    QMetaObject::invokeMethod(req, "onLoadFinished", Q_ARG(bool, false));
+    QVERIFY(reloadRequested.wait());
+    QCOMPARE(reloadRequested.count(), 1);
+    QCOMPARE(completed.count(), 0);
+
+    /* This time the page loads */
+    QMetaObject::invokeMethod(req, "onLoadStarted");
+    QMetaObject::invokeMethod(req, "onLoadFinished", Q_ARG(bool, true));
+    QTest::qWait(failTimeout * 2);
+    QCOMPARE(reloadRequested.count(), 1);
+    QCOMPARE(completed.count(), 0);
+
+    /* The new sample is notified */
+    QCOMPARE(loadTimesChanged.count(), 1);
+    QVERIFY(req->property("averageLoadTime").toInt() < 40);
+
+    /* The retries are counted again after a successful load */
+    QMetaObject::invokeMethod(req, "onLoadStarted");
+    QMetaObject::invokeMethod(req, "onLoadFinished", Q_ARG(bool, false));
+    QVERIFY(completed.wait());
+    QCOMPARE(reloadRequested.count(), 3);
+}
+
 void BrowserRequestTest::testCancelWithHandler()
 {
     SignOnUi::RequestHandler handler;
@@ -307,6 +379,114 @@ void BrowserRequestTest::testCancelWithHandler()
              int(SignOn::QUERY_ERROR_CANCELED));
 }
 
+void BrowserRequestTest::testRefreshWithHandler()
+{
+    SignOnUi::RequestHandler handler;
+    QSignalSpy requestChanged(&handler, SIGNAL(requestChanged()));
+
+    QVariantMap parameters;
+    parameters.insert(SSOUI_KEY_OPENURL, "http://localhost/start.html");
+    parameters.insert(SSOUI_KEY_FINALURL, "http://localhost/end.html");
+    parameters.insert(SSOUI_KEY_IDENTITY, uint(4));
+    TestRequest request(parameters);
+    QSignalSpy completed(&request, SIGNAL(completed()));
+
+    OnlineAccountsUi::RequestPrivate *mockedRequest =
+        OnlineAccountsUi::RequestPrivate::mocked(&request);
+    QSignalSpy setResultCalled(mockedRequest,
+                               SIGNAL(setResultCalled(const QVariantMap &)));
+
+    request.setHandler(&handler);
+    request.start();
+
+    QCOMPARE(requestChanged.count(), 1);
+    QObject *req = handler.request();
+    QSignalSpy startUrlChanged(req, SIGNAL(startUrlChanged()));
+    QSignalSpy finalUrlChanged(req, SIGNAL(finalUrlChanged()));
+
+    QVariantMap newParameters;
+    newParameters.insert(SSOUI_KEY_OPENURL, "http://localhost/retry.html");
+    newParameters.insert(SSOUI_KEY_FINALURL, "http://localhost/done.html");
+    request.refresh(newParameters);
+
+    /* The same request object is updated in place */
+    QCOMPARE(requestChanged.count(), 1);
+    QCOMPARE(handler.request(), req);
+    QCOMPARE(startUrlChanged.count(), 1);
+    QCOMPARE(finalUrlChanged.count(), 1);
+    QCOMPARE(req->property("startUrl").toUrl().toString(),
+             QString("http://localhost/retry.html"));
+    QCOMPARE(req->property("finalUrl").toUrl().toString(),
+             QString("http://localhost/done.html"));
+    QCOMPARE(request.parameters().value(SSOUI_KEY_IDENTITY).toUInt(), 4U);
+
+    /* The old final URL doesn't complete the request anymore */
+    QSignalSpy authenticated(req, SIGNAL(authenticated()));
+    req->setProperty("currentUrl", QUrl("http://localhost/end.html"));
+    QCOMPARE(authenticated.count(), 0);
+
+    req->setProperty("currentUrl", QUrl("http://localhost/done.html?a=b"));
+    QCOMPARE(authenticated.count(), 1);
+    QCOMPARE(completed.count(), 0);
+}
+
+static QList<SignOnUi::Dialog*> findDialogs()
+{
+    QList<SignOnUi::Dialog*> dialogs;
+    Q_FOREACH(QWindow *window, QGuiApplication::allWindows()) {
+        SignOnUi::Dialog *dialog = qobject_cast<SignOnUi::Dialog*>(window);
+        if (dialog) dialogs.append(dialog);
+    }
+    return dialogs;
+}
+
+void BrowserRequestTest::testPreWarmedDialog()
+{
+    QList<SignOnUi::Dialog*> oldDialogs = findDialogs();
+
+    SignOnUi::BrowserRequest::preWarm();
+
+    QList<SignOnUi::Dialog*> dialogs = findDialogs();
+    Q_FOREACH(SignOnUi::Dialog *dialog, oldDialogs) {
+        dialogs.removeAll(dialog);
+    }
+    QCOMPARE(dialogs.count(), 1);
+    QPointer<SignOnUi::Dialog> preWarmedDialog = dialogs.first();
+    QVERIFY(!preWarmedDialog->viewContext()->
+            contextProperty("request").value<QObject*>());
+
+    QVariantMap parameters;
+    parameters.insert(SSOUI_KEY_OPENURL, "http://localhost/start.html");
+    parameters.insert(SSOUI_KEY_FINALURL, "http://localhost/end.html");
+    parameters.insert(SSOUI_KEY_IDENTITY, uint(7));
+    TestRequest *request = new TestRequest(parameters);
+    SignOnUi::RequestPrivate::mocked(request)->setProviderId("google");
+    request->start();
+
+    /* No new dialog has been created: the pre-warmed one is used */
+    dialogs = findDialogs();
+    Q_FOREACH(SignOnUi::Dialog *dialog, oldDialogs) {
+        dialogs.removeAll(dialog);
+    }
+    QCOMPARE(dialogs.count(), 1);
+    QCOMPARE(dialogs.first(), preWarmedDialog.data());
+
+    QObject *req = preWarmedDialog->viewContext()->
+        contextProperty("request").value<QObject*>();
+    QVERIFY(req);
+
+    QString expectedRootDir =
+        QString("%1/tst_browser_request/id-7-google").arg(m_dataDir.path());
+    QCOMPARE(req->property("rootDir").toString(), expectedRootDir);
+    QVERIFY(QDir(expectedRootDir).exists());
+    QCOMPARE(req->property("startUrl").toUrl().toString(),
+             QString("http://localhost/start.html"));
+
+    /* The dialog is owned by the request now */
+    delete request;
+    QVERIFY(preWarmedDialog.isNull());
+}
+
 QTEST_MAIN(BrowserRequestTest);
 
 #include "tst_browser_request.moc"
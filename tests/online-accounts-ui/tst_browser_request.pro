@@ -24,15 +24,21 @@ DEFINES += \
     NO_REQUEST_FACTORY \
     PLUGIN_PRIVATE_MODULE_DIR=\\\"/tmp\\\" \
     SIGNONUI_FAIL_TIMEOUT=100 \
+    SIGNONUI_FAIL_TIMEOUT_MAX=200 \
+    SIGNONUI_FAIL_TIMEOUT_MIN=50 \
     SIGNONUI_I18N_DOMAIN=\\\"translations\\\" \
     TEST_DATA_DIR=\\\"$${PWD}/data\\\"
 
 
 SOURCES += \
     $${ONLINE_ACCOUNTS_UI_DIR}/browser-request.cpp \
+    $${ONLINE_ACCOUNTS_UI_DIR}/component-cache.cpp \
+    $${ONLINE_ACCOUNTS_UI_DIR}/cookie-jar.cpp \
     $${ONLINE_ACCOUNTS_UI_DIR}/debug.cpp \
     $${ONLINE_ACCOUNTS_UI_DIR}/dialog.cpp \
     $${ONLINE_ACCOUNTS_UI_DIR}/i18n.cpp \
+    $${ONLINE_ACCOUNTS_UI_DIR}/load-time-tracker.cpp \
+    $${ONLINE_ACCOUNTS_UI_DIR}/redirect-matcher.cpp \
     mock/request-mock.cpp \
     mock/signonui-request-mock.cpp \
     mock/ui-server-mock.cpp \
@@ -40,8 +46,12 @@ SOURCES += \
 
 HEADERS += \
     $${ONLINE_ACCOUNTS_UI_DIR}/browser-request.h \
+    $${ONLINE_ACCOUNTS_UI_DIR}/component-cache.h \
+    $${ONLINE_ACCOUNTS_UI_DIR}/cookie-jar.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/dialog.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/i18n.h \
+    $${ONLINE_ACCOUNTS_UI_DIR}/load-time-tracker.h \
+    $${ONLINE_ACCOUNTS_UI_DIR}/redirect-matcher.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/request.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/signonui-request.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/ui-server.h \
@@ -18,6 +18,7 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "component-cache.h"
 #include "debug.h"
 #include "globals.h"
 #include "mock/application-manager-mock.h"
@@ -26,8 +27,10 @@
 #include "provider-request.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QQmlComponent>
 #include <QQmlContext>
 #include <QQmlEngine>
 #include <QQuickView>
@@ -69,6 +72,13 @@ private Q_SLOTS:
     void initTestCase();
     void testParameters_data();
     void testParameters();
+    void testSharedEngine();
+    void benchmarkRequestLoading();
+    void benchmarkFirstFrame_data();
+    void benchmarkFirstFrame();
+
+private:
+    QQuickView *startRequest(TestRequest *request);
 
 private:
     UiServer m_uiServer;
@@ -80,6 +90,17 @@ ProviderRequestTest::ProviderRequestTest():
 {
 }
 
+QQuickView *ProviderRequestTest::startRequest(TestRequest *request)
+{
+    RequestPrivate *mockedRequest = RequestPrivate::mocked(request);
+    QSignalSpy setWindowCalled(mockedRequest,
+                               SIGNAL(setWindowCalled(QWindow*)));
+
+    request->start();
+    if (setWindowCalled.count() != 1) return 0;
+    return static_cast<QQuickView*>(setWindowCalled.at(0).at(0).value<QWindow*>());
+}
+
 void ProviderRequestTest::initTestCase()
 {
     qputenv("ACCOUNTS", "/tmp/");
@@ -172,7 +193,7 @@ void ProviderRequestTest::testParameters()
     if (errorName.isEmpty()) {
         QTRY_COMPARE(setWindowCalled.count(), 1);
         QQuickView *view = static_cast<QQuickView*>(setWindowCalled.at(0).at(0).value<QWindow*>());
-        QQmlContext *context = view->engine()->rootContext();
+        QQmlContext *context = QQmlEngine::contextForObject(view->rootObject());
         QObject *request = context->contextProperty("request").value<QObject*>();
 
         QCOMPARE(applicationInfoCalled.count(), 1);
@@ -186,6 +207,126 @@ void ProviderRequestTest::testParameters()
     }
 }
 
+void ProviderRequestTest::testSharedEngine()
+{
+    QVariantMap parameters;
+    parameters.insert(OAU_KEY_APPLICATION, "Gallery");
+    parameters.insert(OAU_KEY_PROVIDER, "my provider");
+    QVariantMap applicationInfo;
+    applicationInfo.insert("one", "two");
+
+    ApplicationManagerPrivate *mockedAppManager =
+        ApplicationManagerPrivate::mocked(ApplicationManager::instance());
+    mockedAppManager->setApplicationInfo("Gallery", applicationInfo);
+    mockedAppManager->setProviderInfo("my provider", QVariantMap());
+
+    QElapsedTimer timer;
+    timer.start();
+    TestRequest request1(parameters, "my-app");
+    QQuickView *view1 = startRequest(&request1);
+    qint64 firstLoadTime = timer.nsecsElapsed();
+    QVERIFY(view1 != 0);
+    QVERIFY(view1->rootObject() != 0);
+
+    timer.restart();
+    TestRequest request2(parameters, "my-app");
+    QQuickView *view2 = startRequest(&request2);
+    qint64 secondLoadTime = timer.nsecsElapsed();
+    QVERIFY(view2 != 0);
+    QVERIFY(view2->rootObject() != 0);
+    qDebug() << "First request loaded in" << firstLoadTime / 1000 << "us," <<
+        "second request in" << secondLoadTime / 1000 << "us";
+
+    /* The two views share the engine and the component... */
+    ComponentCache *cache = ComponentCache::instance();
+    QCOMPARE(view1->engine(), cache->engine());
+    QCOMPARE(view2->engine(), cache->engine());
+    QUrl url(QStringLiteral("qrc:/qml/ProviderRequest.qml"));
+    QCOMPARE(cache->component(url), cache->component(url));
+
+    /* ...but each of them sees its own request */
+    QQmlContext *context1 = QQmlEngine::contextForObject(view1->rootObject());
+    QQmlContext *context2 = QQmlEngine::contextForObject(view2->rootObject());
+    QVERIFY(context1 != context2);
+    QObject *requestObject1 = context1->contextProperty("request").value<QObject*>();
+    QObject *requestObject2 = context2->contextProperty("request").value<QObject*>();
+    QVERIFY(requestObject1 != 0);
+    QVERIFY(requestObject2 != 0);
+    QVERIFY(requestObject1 != requestObject2);
+    QCOMPARE(context1->contextProperty("mainWindow").value<QObject*>(),
+             static_cast<QObject*>(view1));
+    QCOMPARE(context2->contextProperty("mainWindow").value<QObject*>(),
+             static_cast<QObject*>(view2));
+}
+
+void ProviderRequestTest::benchmarkRequestLoading()
+{
+    QVariantMap parameters;
+    parameters.insert(OAU_KEY_APPLICATION, "Gallery");
+    parameters.insert(OAU_KEY_PROVIDER, "my provider");
+    QVariantMap applicationInfo;
+    applicationInfo.insert("one", "two");
+
+    ApplicationManagerPrivate *mockedAppManager =
+        ApplicationManagerPrivate::mocked(ApplicationManager::instance());
+    mockedAppManager->setApplicationInfo("Gallery", applicationInfo);
+    mockedAppManager->setProviderInfo("my provider", QVariantMap());
+
+    /* Measures the requests served after the first one */
+    QBENCHMARK {
+        TestRequest request(parameters, "my-app");
+        QQuickView *view = startRequest(&request);
+        QVERIFY(view != 0);
+    }
+}
+
+void ProviderRequestTest::benchmarkFirstFrame_data()
+{
+    QTest::addColumn<bool>("compiledQml");
+
+    QTest::newRow("QML source") << false;
+    QTest::newRow("compiled QML") << true;
+}
+
+void ProviderRequestTest::benchmarkFirstFrame()
+{
+    QFETCH(bool, compiledQml);
+
+    QUrl url(QStringLiteral("qrc:/qml/ProviderRequest.qml"));
+    if (compiledQml) {
+        /* Make sure that the compilation unit is in the disk cache */
+        qunsetenv("QML_DISABLE_DISK_CACHE");
+        QQmlEngine engine;
+        QQmlComponent component(&engine, url);
+        QVERIFY(component.isReady());
+    } else {
+        qputenv("QML_DISABLE_DISK_CACHE", "1");
+    }
+
+    /* Each view has its own engine, so that nothing compiled by the
+     * previous iterations is kept in memory */
+    qint64 totalTime = 0;
+    int iterations = 0;
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+        QQuickView view;
+        QSignalSpy frameSwapped(&view, SIGNAL(frameSwapped()));
+        view.setSource(url);
+        QVERIFY(view.rootObject() != 0);
+        view.resize(100, 100);
+        view.show();
+        QVERIFY(frameSwapped.wait());
+        totalTime += timer.nsecsElapsed();
+        iterations++;
+    }
+    qunsetenv("QML_DISABLE_DISK_CACHE");
+
+    qDebug() << "Time to first frame" <<
+        (compiledQml ? "(compiled):" : "(source):") <<
+        totalTime / iterations / 1000 << "us";
+}
+
 QTEST_MAIN(ProviderRequestTest);
 
 #include "tst_provider_request.moc"
@@ -26,6 +26,7 @@ DEFINES += \
 
 SOURCES += \
     $${ONLINE_ACCOUNTS_UI_DIR}/access-model.cpp \
+    $${ONLINE_ACCOUNTS_UI_DIR}/component-cache.cpp \
     $${ONLINE_ACCOUNTS_UI_DIR}/debug.cpp \
     $${ONLINE_ACCOUNTS_UI_DIR}/i18n.cpp \
     $${ONLINE_ACCOUNTS_UI_DIR}/provider-request.cpp \
@@ -36,6 +37,7 @@ SOURCES += \
 
 HEADERS += \
     $${ONLINE_ACCOUNTS_UI_DIR}/access-model.h \
+    $${ONLINE_ACCOUNTS_UI_DIR}/component-cache.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/i18n.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/provider-request.h \
     $${ONLINE_ACCOUNTS_UI_DIR}/request.h \
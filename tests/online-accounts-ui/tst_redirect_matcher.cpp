@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "redirect-matcher.h"
+
+#include <QDebug>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTest>
+#include <QUrl>
+
+using namespace SignOnUi;
+
+class RedirectMatcherTest: public QObject
+{
+    Q_OBJECT
+
+public:
+    RedirectMatcherTest();
+
+private Q_SLOTS:
+    void testMatching_data();
+    void testMatching();
+    void testEmpty();
+    void testFirstFinalUrl();
+    void benchmarkMatching_data();
+    void benchmarkMatching();
+};
+
+RedirectMatcherTest::RedirectMatcherTest():
+    QObject(0)
+{
+}
+
+void RedirectMatcherTest::testMatching_data()
+{
+    QTest::addColumn<QVariant>("finalUrls");
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<bool>("expectedMatch");
+
+    QVariant finalUrl = QString("https://localhost/end.html");
+    QTest::newRow("same URL") <<
+        finalUrl << "https://localhost/end.html" << true;
+    QTest::newRow("with query") <<
+        finalUrl << "https://localhost/end.html?code=12&state=a" << true;
+    QTest::newRow("http scheme") <<
+        finalUrl << "http://localhost/end.html" << true;
+    QTest::newRow("trailing slash") <<
+        finalUrl << "https://localhost/end.html/" << true;
+    QTest::newRow("other path") <<
+        finalUrl << "https://localhost/start.html" << false;
+    QTest::newRow("other host") <<
+        finalUrl << "https://example.com/end.html" << false;
+    QTest::newRow("custom scheme") <<
+        finalUrl << "myapp://localhost/end.html" << false;
+
+    finalUrl = QString("http://localhost");
+    QTest::newRow("root, no slash") <<
+        finalUrl << "http://localhost/?code=12" << true;
+    QTest::newRow("root, subpath") <<
+        finalUrl << "http://localhost/favicon.ico" << false;
+
+    finalUrl = QString("com.example.app:");
+    QTest::newRow("scheme only") <<
+        finalUrl << "com.example.app:/oauth?code=12" << true;
+    QTest::newRow("scheme only, with host") <<
+        finalUrl << "com.example.app://host/path" << true;
+    QTest::newRow("scheme only, other scheme") <<
+        finalUrl << "com.example.other:/oauth" << false;
+    QTest::newRow("scheme only, http") <<
+        finalUrl << "http://com.example.app/" << false;
+
+    finalUrl = QString("com.example.app:/oauth2redirect");
+    QTest::newRow("custom scheme callback") <<
+        finalUrl << "com.example.app:/oauth2redirect?code=12" << true;
+    QTest::newRow("custom scheme, other path") <<
+        finalUrl << "com.example.app:/other" << false;
+    QTest::newRow("custom scheme, http") <<
+        finalUrl << "http:/oauth2redirect" << false;
+
+    finalUrl = QStringList() <<
+        "https://accounts.example.com/done" <<
+        "com.example.app:/callback" <<
+        "" <<
+        "https://localhost/";
+    QTest::newRow("list, first") <<
+        finalUrl << "https://accounts.example.com/done#token=x" << true;
+    QTest::newRow("list, second") <<
+        finalUrl << "com.example.app:/callback" << true;
+    QTest::newRow("list, last") <<
+        finalUrl << "http://localhost" << true;
+    QTest::newRow("list, none") <<
+        finalUrl << "https://accounts.example.com/login" << false;
+}
+
+void RedirectMatcherTest::testMatching()
+{
+    QFETCH(QVariant, finalUrls);
+    QFETCH(QString, url);
+    QFETCH(bool, expectedMatch);
+
+    RedirectMatcher matcher;
+    matcher.setFinalUrls(finalUrls);
+    QVERIFY(!matcher.isEmpty());
+    QCOMPARE(matcher.matches(QUrl(url)), expectedMatch);
+}
+
+void RedirectMatcherTest::testEmpty()
+{
+    RedirectMatcher matcher;
+    QVERIFY(matcher.isEmpty());
+    QVERIFY(!matcher.matches(QUrl("http://localhost/")));
+    QVERIFY(!matcher.matches(QUrl()));
+
+    matcher.setFinalUrls(QVariant());
+    QVERIFY(matcher.isEmpty());
+
+    matcher.setFinalUrls(QString("no scheme"));
+    QVERIFY(matcher.isEmpty());
+    QVERIFY(!matcher.matches(QUrl("no scheme")));
+
+    /* Setting new URLs replaces the old ones */
+    matcher.setFinalUrls(QString("http://localhost/end"));
+    QVERIFY(matcher.matches(QUrl("http://localhost/end")));
+    matcher.setFinalUrls(QString("http://localhost/done"));
+    QVERIFY(!matcher.matches(QUrl("http://localhost/end")));
+}
+
+void RedirectMatcherTest::testFirstFinalUrl()
+{
+    RedirectMatcher matcher;
+    QCOMPARE(matcher.firstFinalUrl(), QUrl());
+
+    matcher.setFinalUrls(QStringList() << "invalid" <<
+                         "http://localhost/end" << "myapp:");
+    QCOMPARE(matcher.firstFinalUrl(), QUrl("http://localhost/end"));
+}
+
+void RedirectMatcherTest::benchmarkMatching_data()
+{
+    QTest::addColumn<bool>("useMatcher");
+
+    QTest::newRow("regexp per navigation") << false;
+    QTest::newRow("redirect matcher") << true;
+}
+
+void RedirectMatcherTest::benchmarkMatching()
+{
+    QFETCH(bool, useMatcher);
+
+    /* A typical login flow: several pages on the provider's site, and the
+     * final redirect */
+    QList<QUrl> navigation;
+    for (int i = 0; i < 20; i++) {
+        navigation.append(QUrl(QString("https://accounts.example.com/"
+                                       "signin/v2/step%1?flow=x").arg(i)));
+        navigation.append(QUrl(QString("https://www.example.com/"
+                                       "oauth/end.html?page=%1").arg(i)));
+    }
+    navigation.append(QUrl("https://www.example.com/oauth/end.html?code=1"));
+
+    QUrl finalUrl("https://www.example.com/oauth/end.html");
+    RedirectMatcher matcher;
+    matcher.setFinalUrls(finalUrl.toString());
+
+    int matches = 0;
+    if (useMatcher) {
+        QBENCHMARK {
+            matches = 0;
+            Q_FOREACH(const QUrl &url, navigation) {
+                if (matcher.matches(url)) matches++;
+            }
+        }
+    } else {
+        /* What BrowserRequest used to do */
+        QRegularExpression pathRegExp("/*^");
+        QBENCHMARK {
+            matches = 0;
+            Q_FOREACH(const QUrl &url, navigation) {
+                QString p1 = url.path();
+                QString p2 = finalUrl.path();
+                if (url.host() == finalUrl.host() &&
+                    p1.remove(pathRegExp) == p2.remove(pathRegExp)) {
+                    matches++;
+                }
+            }
+        }
+    }
+    QCOMPARE(matches, 21);
+}
+
+QTEST_MAIN(RedirectMatcherTest);
+
+#include "tst_redirect_matcher.moc"
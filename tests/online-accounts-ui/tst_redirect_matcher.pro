@@ -0,0 +1,16 @@
+include(online-accounts-ui.pri)
+
+TARGET = tst_redirect_matcher
+
+SOURCES += \
+    $${ONLINE_ACCOUNTS_UI_DIR}/debug.cpp \
+    $${ONLINE_ACCOUNTS_UI_DIR}/redirect-matcher.cpp \
+    tst_redirect_matcher.cpp
+
+HEADERS += \
+    $${ONLINE_ACCOUNTS_UI_DIR}/debug.h \
+    $${ONLINE_ACCOUNTS_UI_DIR}/redirect-matcher.h
+
+check.commands += "./$${TARGET}"
+check.depends = $${TARGET}
+QMAKE_EXTRA_TARGETS += check
@@ -1,3 +1,5 @@
 TEMPLATE = subdirs
 SUBDIRS = \
-    tst_application_manager.pro
+    tst_account_manager.pro \
+    tst_application_manager.pro \
+    tst_loopback_server.pro
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "account-manager.h"
+
+#include <Accounts/Account>
+#include <Accounts/Manager>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTest>
+
+#define TEST_DIR "/tmp/tst_account_manager"
+
+using namespace OnlineAccountsUi;
+
+class TestAccountManager: public AccountManager
+{
+public:
+    TestAccountManager(): AccountManager() {}
+};
+
+class AccountManagerTest: public QObject
+{
+    Q_OBJECT
+
+public:
+    AccountManagerTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void testCredentialsIndex();
+    void testServiceIndexes();
+    void benchmarkAccountsForCredentials_data();
+    void benchmarkAccountsForCredentials();
+
+private:
+    void writeFile(const QString &subDir, const QString &name,
+                   const QString &contents);
+    void writeProviderFile(const QString &providerId);
+    Accounts::Account *createAccount(const QString &providerId,
+                                     uint credentialsId);
+    bool waitForSignals(QSignalSpy &spy, int count);
+
+private:
+    QDir m_testDir;
+    Accounts::Manager *m_manager;
+};
+
+AccountManagerTest::AccountManagerTest():
+    QObject(0),
+    m_testDir(TEST_DIR),
+    m_manager(0)
+{
+}
+
+void AccountManagerTest::writeFile(const QString &subDir, const QString &name,
+                                   const QString &contents)
+{
+    QDir dir = m_testDir;
+    dir.mkpath(subDir);
+    dir.cd(subDir);
+
+    QFile file(dir.filePath(name));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Could not write file" << file.fileName();
+        return;
+    }
+
+    file.write(contents.toUtf8());
+}
+
+void AccountManagerTest::writeProviderFile(const QString &providerId)
+{
+    writeFile("providers", providerId + ".provider",
+              QString("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+                      "<provider id=\"%1\">\n"
+                      "  <name>%1 provider</name>\n"
+                      "</provider>").arg(providerId));
+}
+
+Accounts::Account *AccountManagerTest::createAccount(const QString &providerId,
+                                                     uint credentialsId)
+{
+    Accounts::Account *account = m_manager->createAccount(providerId);
+    account->setEnabled(true);
+    account->setCredentialsId(credentialsId);
+    account->syncAndBlock();
+    return account;
+}
+
+bool AccountManagerTest::waitForSignals(QSignalSpy &spy, int count)
+{
+    while (spy.count() < count) {
+        if (!spy.wait()) return false;
+    }
+    return true;
+}
+
+void AccountManagerTest::initTestCase()
+{
+    qputenv("ACCOUNTS", TEST_DIR);
+    qputenv("AG_APPLICATIONS", TEST_DIR "/applications");
+    qputenv("AG_PROVIDERS", TEST_DIR "/providers");
+    qputenv("AG_SERVICES", TEST_DIR "/services");
+
+    m_testDir.removeRecursively();
+    m_testDir.mkpath(".");
+
+    writeProviderFile("cool");
+    writeProviderFile("bad");
+    writeFile("services", "cool-mail.service",
+              "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+              "<service id=\"cool-mail\">\n"
+              "  <type>tstemail</type>\n"
+              "  <name>Cool Mail</name>\n"
+              "  <provider>cool</provider>\n"
+              "</service>");
+    writeFile("services", "cool-sharing.service",
+              "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+              "<service id=\"cool-sharing\">\n"
+              "  <type>tstsharing</type>\n"
+              "  <name>Cool Sharing</name>\n"
+              "  <provider>cool</provider>\n"
+              "</service>");
+    writeFile("services", "bad-mail.service",
+              "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+              "<service id=\"bad-mail\">\n"
+              "  <type>tstemail</type>\n"
+              "  <name>Bad Mail</name>\n"
+              "  <provider>bad</provider>\n"
+              "</service>");
+
+    m_manager = new Accounts::Manager(this);
+}
+
+void AccountManagerTest::testCredentialsIndex()
+{
+    TestAccountManager manager;
+
+    /* An account created before the index is built */
+    Accounts::Account *account1 = createAccount("cool", 5);
+    QVERIFY(account1 != 0);
+    QCOMPARE(manager.accountsForCredentials(5),
+             QList<Accounts::AccountId>() << account1->id());
+    QVERIFY(manager.accountsForCredentials(7).isEmpty());
+
+    /* The index must be updated as accounts are created... */
+    QSignalSpy accountCreated(&manager,
+                              SIGNAL(accountCreated(Accounts::AccountId)));
+    Accounts::Account *account2 = createAccount("bad", 5);
+    QVERIFY(account2 != 0);
+    QVERIFY(waitForSignals(accountCreated, 1));
+    QCOMPARE(manager.accountsForCredentials(5),
+             QList<Accounts::AccountId>() << account1->id() << account2->id());
+
+    /* ...changed... */
+    QSignalSpy accountUpdated(&manager,
+                              SIGNAL(accountUpdated(Accounts::AccountId)));
+    account2->setCredentialsId(7);
+    account2->syncAndBlock();
+    QVERIFY(waitForSignals(accountUpdated, 1));
+    QCOMPARE(manager.accountsForCredentials(5),
+             QList<Accounts::AccountId>() << account1->id());
+    QCOMPARE(manager.accountsForCredentials(7),
+             QList<Accounts::AccountId>() << account2->id());
+
+    /* ...and removed */
+    QSignalSpy accountRemoved(&manager,
+                              SIGNAL(accountRemoved(Accounts::AccountId)));
+    account1->remove();
+    account1->syncAndBlock();
+    account2->remove();
+    account2->syncAndBlock();
+    QVERIFY(waitForSignals(accountRemoved, 2));
+    QVERIFY(manager.accountsForCredentials(5).isEmpty());
+    QVERIFY(manager.accountsForCredentials(7).isEmpty());
+}
+
+static QStringList serviceNames(const Accounts::ServiceList &services)
+{
+    QStringList names;
+    Q_FOREACH(const Accounts::Service &service, services) {
+        names.append(service.name());
+    }
+    names.sort();
+    return names;
+}
+
+void AccountManagerTest::testServiceIndexes()
+{
+    TestAccountManager manager;
+
+    QStringList providers = manager.serviceProviders();
+    providers.sort();
+    QCOMPARE(providers, QStringList() << "bad" << "cool");
+    QCOMPARE(serviceNames(manager.servicesForProvider("cool")),
+             QStringList() << "cool-mail" << "cool-sharing");
+    QCOMPARE(serviceNames(manager.servicesForProvider("bad")),
+             QStringList() << "bad-mail");
+    QVERIFY(manager.servicesForProvider("missing").isEmpty());
+    QVERIFY(manager.servicesForApplication("mailer").isEmpty());
+    QVERIFY(manager.applicationsForService("cool-mail").isEmpty());
+
+    /* Install an application: the indexes must be rebuilt */
+    writeFile("applications", "mailer.application",
+              "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+              "<application id=\"mailer\">\n"
+              "  <description>Mailer</description>\n"
+              "  <service-types>\n"
+              "    <service-type id=\"tstemail\">\n"
+              "      <description>Send email</description>\n"
+              "    </service-type>\n"
+              "  </service-types>\n"
+              "</application>");
+    QCOMPARE(serviceNames(manager.servicesForApplication("mailer")),
+             QStringList() << "bad-mail" << "cool-mail");
+    QCOMPARE(manager.applicationsForService("cool-mail"),
+             QStringList() << "mailer");
+    QCOMPARE(manager.applicationsForService("bad-mail"),
+             QStringList() << "mailer");
+    QVERIFY(manager.applicationsForService("cool-sharing").isEmpty());
+
+    /* And uninstall it */
+    QVERIFY(QFile::remove(TEST_DIR "/applications/mailer.application"));
+    QVERIFY(manager.servicesForApplication("mailer").isEmpty());
+    QVERIFY(manager.applicationsForService("cool-mail").isEmpty());
+}
+
+void AccountManagerTest::benchmarkAccountsForCredentials_data()
+{
+    QTest::addColumn<bool>("useIndex");
+
+    QTest::newRow("account scan") << false;
+    QTest::newRow("index") << true;
+}
+
+void AccountManagerTest::benchmarkAccountsForCredentials()
+{
+    QFETCH(bool, useIndex);
+
+    const int numAccounts = 300;
+    const uint firstCredentialsId = 1000;
+
+    TestAccountManager manager;
+    if (manager.accountList().count() < numAccounts) {
+        for (int i = 0; i < numAccounts; i++) {
+            createAccount(i % 2 ? "cool" : "bad", firstCredentialsId + i);
+        }
+    }
+    QCOMPARE(manager.accountList().count(), numAccounts);
+
+    /* Look up the identities of a few requests */
+    QList<uint> identities;
+    identities << firstCredentialsId << firstCredentialsId + numAccounts / 2 <<
+        firstCredentialsId + numAccounts - 1 << 1;
+
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        Q_FOREACH(uint identity, identities) {
+            if (useIndex) {
+                found += manager.accountsForCredentials(identity).count();
+            } else {
+                /* What SignOnUi::Request used to do */
+                Q_FOREACH(Accounts::AccountId accountId,
+                          manager.accountList()) {
+                    Accounts::Account *account = manager.account(accountId);
+                    if (account->credentialsId() == identity) {
+                        found++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    QCOMPARE(found, 3);
+}
+
+QTEST_GUILESS_MAIN(AccountManagerTest);
+
+#include "tst_account_manager.moc"
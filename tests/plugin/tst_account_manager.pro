@@ -0,0 +1,24 @@
+include(plugin.pri)
+
+TARGET = tst_account_manager
+
+CONFIG += \
+    link_pkgconfig
+
+QT += \
+    dbus
+QT -= gui
+
+PKGCONFIG += \
+    accounts-qt5
+
+SOURCES += \
+    $${ONLINE_ACCOUNTS_PLUGIN_DIR}/account-manager.cpp \
+    tst_account_manager.cpp
+
+HEADERS += \
+    $${ONLINE_ACCOUNTS_PLUGIN_DIR}/account-manager.h
+
+check.commands = "xvfb-run -a dbus-test-runner -t ./$${TARGET}"
+check.depends = $${TARGET}
+QMAKE_EXTRA_TARGETS += check
@@ -62,6 +62,7 @@ private Q_SLOTS:
     void testAclAdd();
     void testAclRemove_data();
     void testAclRemove();
+    void testProfileChanges();
     void testApplicationFromProfile_data();
     void testApplicationFromProfile();
     void testProviderInfo_data();
@@ -431,6 +432,44 @@ void ApplicationManagerTest::testAclRemove()
     QCOMPARE(acl.toSet(), newAcl.toSet());
 }
 
+void ApplicationManagerTest::testProfileChanges()
+{
+    clearApplicationsDir();
+
+    QString applicationFile =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+        "<application id=\"com.ubuntu.test_Changing\">\n"
+        "  <description>My application</description>\n"
+        "  <services>\n"
+        "    <service id=\"cool-mail\">\n"
+        "      <profile>not-this-one</profile>\n"
+        "    </service>\n"
+        "  </services>\n"
+        "  <profile>%1</profile>\n"
+        "</application>";
+    writeAccountsFile("com.ubuntu.test_Changing.application",
+                      applicationFile.arg("com.ubuntu.test_Changing_0.1"));
+
+    ApplicationManager manager;
+    QStringList acl;
+    QCOMPARE(manager.addApplicationToAcl(acl, "com.ubuntu.test_Changing"),
+             QStringList() << "com.ubuntu.test_Changing_0.1");
+    /* Again, to hit the cache */
+    QCOMPARE(manager.addApplicationToAcl(acl, "com.ubuntu.test_Changing"),
+             QStringList() << "com.ubuntu.test_Changing_0.1");
+
+    /* Upgrade the application */
+    writeAccountsFile("com.ubuntu.test_Changing.application",
+                      applicationFile.arg("com.ubuntu.test_Changing_0.10"));
+    QCOMPARE(manager.addApplicationToAcl(acl, "com.ubuntu.test_Changing"),
+             QStringList() << "com.ubuntu.test_Changing_0.10");
+
+    /* And remove it */
+    clearApplicationsDir();
+    QCOMPARE(manager.addApplicationToAcl(acl, "com.ubuntu.test_Changing"),
+             acl);
+}
+
 void ApplicationManagerTest::testApplicationFromProfile_data()
 {
     QTest::addColumn<QString>("applicationId");
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This file is part of online-accounts-ui
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loopback-server.h"
+
+#include <QDebug>
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QTest>
+
+using namespace OnlineAccountsPlugin;
+
+class LoopbackServerTest: public QObject
+{
+    Q_OBJECT
+
+public:
+    LoopbackServerTest();
+
+private Q_SLOTS:
+    void testVisited();
+    void testSeveralConnections();
+
+private:
+    void sendRequest(QTcpSocket *socket, const QList<QByteArray> &chunks);
+};
+
+LoopbackServerTest::LoopbackServerTest():
+    QObject(0)
+{
+}
+
+void LoopbackServerTest::sendRequest(QTcpSocket *socket,
+                                     const QList<QByteArray> &chunks)
+{
+    Q_FOREACH(const QByteArray &chunk, chunks) {
+        socket->write(chunk);
+        socket->flush();
+        QTest::qWait(10);
+    }
+}
+
+void LoopbackServerTest::testVisited()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen());
+    QSignalSpy visited(&server, SIGNAL(visited(const QUrl&)));
+
+    /* The request line might arrive in several chunks */
+    QTcpSocket socket;
+    socket.connectToHost("127.0.0.1", server.port());
+    QVERIFY(socket.waitForConnected());
+    sendRequest(&socket, QList<QByteArray>() <<
+                "GET /callback?co" <<
+                "de=1 HTTP/1.1\r\nHost: localhost\r\n" <<
+                "Accept: */*\r\n\r\n");
+
+    QTRY_COMPARE(visited.count(), 1);
+    QUrl url = visited.at(0).at(0).toUrl();
+    QCOMPARE(url.path(), QString("/callback"));
+    QCOMPARE(url.query(), QString("code=1"));
+    QCOMPARE(url.port(), int(server.port()));
+
+    /* The rest of the request is ignored */
+    QTest::qWait(50);
+    QCOMPARE(visited.count(), 1);
+}
+
+void LoopbackServerTest::testSeveralConnections()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen());
+    QSignalSpy visited(&server, SIGNAL(visited(const QUrl&)));
+
+    /* A browser might request other resources before the callback, and keep
+     * a connection open while it opens new ones */
+    QTcpSocket pending;
+    pending.connectToHost("127.0.0.1", server.port());
+    QVERIFY(pending.waitForConnected());
+    sendRequest(&pending, QList<QByteArray>() << "GET /unfinished");
+
+    QTcpSocket favicon;
+    favicon.connectToHost("127.0.0.1", server.port());
+    QVERIFY(favicon.waitForConnected());
+    sendRequest(&favicon, QList<QByteArray>() <<
+                "GET /favicon.ico HTTP/1.1\r\n\r\n");
+    QTRY_COMPARE(visited.count(), 1);
+    QCOMPARE(visited.at(0).at(0).toUrl().path(), QString("/favicon.ico"));
+
+    QTcpSocket callback;
+    callback.connectToHost("127.0.0.1", server.port());
+    QVERIFY(callback.waitForConnected());
+    sendRequest(&callback, QList<QByteArray>() <<
+                "GET /callback?code=2 HTTP/1.1\r\n\r\n");
+    QTRY_COMPARE(visited.count(), 2);
+    QUrl url = visited.at(1).at(0).toUrl();
+    QCOMPARE(url.path(), QString("/callback"));
+    QCOMPARE(url.query(), QString("code=2"));
+
+    /* The response is served */
+    QTRY_VERIFY(callback.bytesAvailable() > 0);
+    QVERIFY(callback.readAll().startsWith("HTTP/1.0 200 OK"));
+
+    /* Completing the first request doesn't mix it with the others */
+    sendRequest(&pending, QList<QByteArray>() << " HTTP/1.1\r\n\r\n");
+    QTRY_COMPARE(visited.count(), 3);
+    QCOMPARE(visited.at(2).at(0).toUrl().path(), QString("/unfinished"));
+}
+
+QTEST_MAIN(LoopbackServerTest);
+
+#include "tst_loopback_server.moc"
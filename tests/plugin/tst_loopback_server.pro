@@ -0,0 +1,18 @@
+include(plugin.pri)
+
+TARGET = tst_loopback_server
+
+QT += \
+    network
+QT -= gui
+
+SOURCES += \
+    $${ONLINE_ACCOUNTS_PLUGIN_DIR}/loopback-server.cpp \
+    tst_loopback_server.cpp
+
+HEADERS += \
+    $${ONLINE_ACCOUNTS_PLUGIN_DIR}/loopback-server.h
+
+check.commands = "./$${TARGET}"
+check.depends = $${TARGET}
+QMAKE_EXTRA_TARGETS += check